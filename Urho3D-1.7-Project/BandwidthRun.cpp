@@ -0,0 +1,111 @@
+// Include directives
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Connection.h>
+#include <cstdio>
+#include "BandwidthRun.h"
+
+
+// Measure for the seconds given, once a client has loaded the scene - and fail over the
+// bytes a second per client given (0 for no bound)
+void BandwidthRun::Initialise(float duration, bool flockChannel, float maxBytesPerClient)
+{
+	duration_ = duration;
+	flockChannel_ = flockChannel;
+	maxBytesPerClient_ = maxBytesPerClient;
+	waitTime_ = 0.0f;
+	warmup_ = BANDWIDTH_WARMUP;
+	time_ = 0.0f;
+	clientTime_ = 0.0f;
+	bytes_ = 0.0f;
+	maxClients_ = 0;
+	passed_ = false;
+	report_.Clear();
+}
+
+
+// Is a run asked for
+bool BandwidthRun::IsEnabled()
+{
+	return duration_ > 0.0f;
+}
+
+
+// Measure the clients' connections - true once the run is over and reported
+bool BandwidthRun::Update(Network* network, float timeStep)
+{
+	// Not running
+	if (!IsEnabled())
+		return false;
+
+	// The clients that have loaded the scene
+	const Vector<SharedPtr<Connection> >& connections = network->GetClientConnections();
+	unsigned numClients = 0;
+	float bytesPerSec = 0.0f;
+	for (unsigned i = 0; i < connections.Size(); ++i)
+	{
+		if (!connections[i]->IsSceneLoaded())
+			continue;
+		numClients++;
+		bytesPerSec += connections[i]->GetBytesOutPerSec();
+	}
+
+	// Wait for a client - not for ever
+	if (!numClients && time_ == 0.0f)
+	{
+		waitTime_ += timeStep;
+		if (waitTime_ < BANDWIDTH_CONNECT_TIMEOUT)
+			return false;
+		report_ = ToString("Loopback bandwidth FAILED: no client loaded the scene in %d seconds", (int)BANDWIDTH_CONNECT_TIMEOUT);
+		URHO3D_LOGERROR(report_);
+		return true;
+	}
+
+	// Then past the scene download
+	if (warmup_ > 0.0f)
+	{
+		warmup_ -= timeStep;
+		return false;
+	}
+
+	// Bytes sent over the step
+	time_ += timeStep;
+	clientTime_ += numClients * timeStep;
+	bytes_ += bytesPerSec * timeStep;
+	maxClients_ = Max(maxClients_, numClients);
+	if (time_ < duration_)
+		return false;
+
+	// Report the run - against the bound if there is one
+	passed_ = maxBytesPerClient_ <= 0.0f || GetBytesPerClient() <= maxBytesPerClient_;
+	char text[240];
+	if (maxBytesPerClient_ > 0.0f)
+		snprintf(text, sizeof(text), "Loopback bandwidth %s, flock channel %s: %.0f bytes/s per client (bound %.0f, %u clients, %.1f seconds)",
+			passed_ ? "passed" : "FAILED", flockChannel_ ? "on" : "off", GetBytesPerClient(), maxBytesPerClient_, maxClients_, time_);
+	else
+		snprintf(text, sizeof(text), "Loopback bandwidth, flock channel %s: %.0f bytes/s per client (%u clients, %.1f seconds)",
+			flockChannel_ ? "on" : "off", GetBytesPerClient(), maxClients_, time_);
+	report_ = text;
+	URHO3D_LOGINFO(report_);
+	return true;
+}
+
+
+// Bytes sent to each client a second over the run
+float BandwidthRun::GetBytesPerClient()
+{
+	return clientTime_ > 0.0f ? bytes_ / clientTime_ : 0.0f;
+}
+
+
+// Did the run pass - a client loaded the scene and the bytes stayed within the bound
+bool BandwidthRun::IsPassed()
+{
+	return passed_;
+}
+
+
+// Report of the run
+const String& BandwidthRun::GetReport()
+{
+	return report_;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Network/Network.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Seconds after the first client has loaded the scene before measuring - leaves out the scene download
+const float BANDWIDTH_WARMUP = 3.0f;
+
+// Seconds to wait for a client to load the scene before the run fails
+const float BANDWIDTH_CONNECT_TIMEOUT = 30.0f;
+
+// Bytes scene replication sends for a moving boid each network update - its position and
+// rotation attributes alone, leaving out the message and node headers
+const float BANDWIDTH_SCENE_BYTES_PER_BOID = 28.0f;
+
+// Least saving of the flock channel over that - it fails the run below it
+const float BANDWIDTH_MIN_SAVING = 4.0f;
+
+// Bandwidth run class
+// - A dedicated server run against loopback bots that measures the bytes sent to each client
+//   a second, with the flock channel on or off, then reports it and asks to exit
+// - Fails if no client loads the scene in time, or if the flock channel sends more than the
+//   bound given - a fraction of what scene replication would send for the same flock
+// - Run it as: -server -bots 1 -flockchannel 1 -bandwidth 30, and again with -flockchannel 0
+class BandwidthRun
+{
+public:
+	// Constructor
+	BandwidthRun() :
+		duration_(0.0f),
+		flockChannel_(false),
+		maxBytesPerClient_(0.0f),
+		waitTime_(0.0f),
+		warmup_(BANDWIDTH_WARMUP),
+		time_(0.0f),
+		clientTime_(0.0f),
+		bytes_(0.0f),
+		maxClients_(0),
+		passed_(false)
+	{}
+
+	// Measure for the seconds given, once a client has loaded the scene - and fail over the
+	// bytes a second per client given (0 for no bound)
+	void Initialise(float duration, bool flockChannel, float maxBytesPerClient);
+
+	// Is a run asked for
+	bool IsEnabled();
+
+	// Measure the clients' connections - true once the run is over and reported
+	bool Update(Network* network, float timeStep);
+
+	// Bytes sent to each client a second over the run
+	float GetBytesPerClient();
+
+	// Did the run pass, and its report
+	bool IsPassed();
+	const String& GetReport();
+
+private:
+	// Seconds to measure, whether the flock channel is used, and the bound
+	float duration_;
+	bool flockChannel_;
+	float maxBytesPerClient_;
+
+	// Seconds waited for a client, seconds left before measuring, and seconds measured
+	float waitTime_;
+	float warmup_;
+	float time_;
+
+	// Seconds of client connection measured, and the bytes sent over them
+	float clientTime_;
+	float bytes_;
+
+	// Most clients connected at once
+	unsigned maxClients_;
+
+	// Result
+	bool passed_;
+	String report_;
+};
@@ -1,5 +1,6 @@
 // Include directives
 #include "Boid.h"
+#include "BoidPrefab.h"
 
 
 // Defines the ranges and scaling factors for each force on the boid
@@ -21,56 +22,39 @@ float Boid::Copy_Range = 100.0f;
 
 
 // Initialisation function
-void Boid::Initialise(ResourceCache* cache, Scene* scene, Vector3 starPos, bool copy, bool limit)
+void Boid::Initialise(BoidPrefab& prefab, Vector3 starPos, FlockRandom& random, bool copy, bool limit, bool retired)
 {
 	// ----------------------------------- INITIALISATION -------------------------------------------
-	// Create the node for the boid
-	pNode = scene->CreateChild("Boid");
-
-	// Set boid rotation and scale
-	pNode->SetRotation(Quaternion::IDENTITY);
-	pNode->SetScale(1.0f);
-
-	// Create boid object
-	pObject = pNode->CreateComponent<StaticModel>();
-
-	// Set the boid model, material and shadows
-	if (Random(1.0f) < 0.5f)
-	{
-		pObject->SetModel(cache->GetResource<Model>("Models/Tie-Fighter.mdl"));
-		pObject->ApplyMaterialList("Models/Tie-Fighter.txt");
-		pObject->SetCastShadows(true);
-	}
+	// Pick the boid model type
+	if (random.Next() < 0.5f)
+		modelType_ = BOID_TIE_FIGHTER;
 	else
-	{
-		pObject->SetModel(cache->GetResource<Model>("Models/Tie-Interceptor.mdl"));
-		pObject->ApplyMaterialList("Models/Tie-Interceptor.txt");
-		pObject->SetCastShadows(true);
-	}
+		modelType_ = BOID_TIE_INTERCEPTOR;
 
-	// Give the boid a rigidbody
-	pRigidBody = pNode->CreateComponent<RigidBody>();
+	// Copy the model type's template - model, material, shadows, rigid body and collision shape
+	pNode = prefab.Instantiate(modelType_);
+	pObject = pNode->GetComponent<StaticModel>();
+	pRigidBody = pNode->GetComponent<RigidBody>();
+	pCollisionShape = pNode->GetComponent<CollisionShape>();
 
-	// Set the boid collision layer and shape
-	pRigidBody->SetCollisionLayer(1);
-	//pRigidBody->SetCollisionMask(2);
-	pCollisionShape = pNode->CreateComponent<CollisionShape>();
-	pCollisionShape->SetBox(Vector3::ONE);
-
-	// Turn off gravity and randomise the start position of rigidbody
-	pRigidBody->SetMass(1.0f);
-	pRigidBody->SetUseGravity(false);
-	pRigidBody->SetPosition(starPos);
+	// Place the boid - the rigid body takes the node's position when it joins the physics world
+	pNode->SetPosition(starPos);
 
 	// Set the optimisations
 	copyRange_ = copy;
 	limitNeighbours_ = limit;
+
+	// Put it in play, unless it is kept retired for the wave director
+	if (!retired)
+		pNode->SetEnabled(true);
 }
 
 
 // Called each frame to calculate the force acting on the boid from its neighbours
-void Boid::ComputeForce(Boid* pBoid)
+void Boid::ComputeForce(Boid* pBoid, FlockCounters& counters)
 {
+	FLOCK_COUNT(counters, boids_);
+
 	// Centre of mass, accumulated total
 	Vector3 centreOfMass;
 
@@ -101,17 +85,23 @@ void Boid::ComputeForce(Boid* pBoid)
 		if (this == &pBoid[i])
 			continue;
 
+		// Killed, retired and pooled boids are out of play where they stopped - not neighbours
+		if (!pBoid[i].IsAlive())
+			continue;
+
 		// Calculate the seperation of this boid from current boid (in the loop)
-		Vector3 seperation = pRigidBody->GetPosition() - pBoid[i].pRigidBody->GetPosition();
+		Vector3 seperation = GetPosition() - pBoid[i].GetPosition();
 
 		// Calculate the distance of this boid from current boid (in the loop)
 		float distanceOfBoid = seperation.LengthSquared();
+		FLOCK_COUNT(counters, visited_);
 
 		// If distance is less than copy range
 		if (copyRange_ && distanceOfBoid < Copy_Range)
 		{
 			// Copy the force
 			force_ = pBoid[i].force_;
+			FLOCK_COUNT(counters, copies_);
 			break;
 		}
 
@@ -131,8 +121,9 @@ void Boid::ComputeForce(Boid* pBoid)
 				// Boid within range, so boids are neighbours
 				// - Add position of boid to centre of mass
 				// - Increase neighbour count
-				centreOfMass += pBoid[i].pRigidBody->GetPosition();
+				centreOfMass += pBoid[i].GetPosition();
 				numbCF++;
+				FLOCK_COUNT(counters, cohesion_);
 			}
 		}
 
@@ -145,8 +136,9 @@ void Boid::ComputeForce(Boid* pBoid)
 				// Boid within range, so boids are neighbours
 				// - Add boid velocity to the direction vector
 				// - Increase neighbour count
-				direction += pBoid[i].pRigidBody->GetLinearVelocity();
+				direction += pBoid[i].GetVelocity();
 				numbAF++;
+				FLOCK_COUNT(counters, alignment_);
 			}
 		}
 
@@ -161,11 +153,16 @@ void Boid::ComputeForce(Boid* pBoid)
 				// - Increase neighbour count
 				seperationForce += (seperation / seperation.Length());
 				numbSF++;
+				FLOCK_COUNT(counters, separation_);
 			}
 		}
 
 		// Break from loop - neighbou count reached
-		else break;
+		else
+		{
+			FLOCK_COUNT(counters, limitBreaks_);
+			break;
+		}
 	}
 
 	// If the boid has any neighbours
@@ -175,7 +172,7 @@ void Boid::ComputeForce(Boid* pBoid)
 		direction /= numbAF;
 
 		// Set the alignmnet force to be applied to the boid
-		alignmentForce += (direction - pRigidBody->GetLinearVelocity()) * AlignmentForce_Factor;
+		alignmentForce += (direction - GetVelocity()) * AlignmentForce_Factor;
 	}
 
 	// If the boid has neighbours
@@ -192,13 +189,13 @@ void Boid::ComputeForce(Boid* pBoid)
 		centreOfMass /= numbCF;
 
 		// Calculate the direction from this boid to the centre of mass (unit vector)
-		Vector3 dirOfCentre = (centreOfMass - pRigidBody->GetPosition()).Normalized();
+		Vector3 dirOfCentre = (centreOfMass - GetPosition()).Normalized();
 
 		// Calculate the desired velocity
 		Vector3 desiredVelocity = dirOfCentre * CohesionForce_VMax;
 
 		// Set the cohesion force to be applied to the boid
-		cohesionForce += (desiredVelocity - pRigidBody->GetLinearVelocity()) * CohesionForce_Factor;
+		cohesionForce += (desiredVelocity - GetVelocity()) * CohesionForce_Factor;
 
 		// The total force
 		force_ = seperationForce + alignmentForce + cohesionForce + TargetPosition(Vector3::ZERO, forceStrength_);
@@ -458,6 +455,13 @@ void Boid::ComputeForce(Boid* pBoid)
 void Boid::Update(float timeStep)
 {
 	// ------------------------------------ UPDATING BOID -------------------------------------------
+	// Lockstep boids move themselves rather than through the physics
+	if (lockstep_)
+	{
+		UpdateLockstep(timeStep);
+		return;
+	}
+
 	// Apply the calculated steering force to the boid
 	pRigidBody->ApplyForce(force_);
 
@@ -488,13 +492,9 @@ void Boid::Update(float timeStep)
 		pRigidBody->SetLinearVelocity(velocity.Normalized() * speed);
 	}
 
-	// Get the normalised velocity
-	Vector3 normalizedVelocity = pRigidBody->GetLinearVelocity().Normalized();
-
-	// Set the boids rotation
-	Quaternion finalRotation = Quaternion::IDENTITY;
-	finalRotation.FromLookRotation(normalizedVelocity, Vector3::UP);
-	pRigidBody->SetRotation(finalRotation);
+	// Set the boids rotation - off screen boids are turned when they come into view
+	if (onScreen_)
+		UpdateRotation();
 
 	// Get the position of the boid
 	Vector3 position = pRigidBody->GetPosition();
@@ -557,6 +557,174 @@ void Boid::SetNumberOfBoids(int numBoids)
 }
 
 
+// Update in lockstep - the boid integrates its own state, so every machine gets the same result
+void Boid::UpdateLockstep(float timeStep)
+{
+	// Apply the steering force to the velocity (unit mass)
+	velocity_ += force_ * timeStep;
+
+	// Clamp the speed
+	float speed = velocity_.Length();
+	if (speed < minSpeed_)
+		velocity_ = velocity_.Normalized() * minSpeed_;
+	else if (speed > maxSpeed_)
+		velocity_ = velocity_.Normalized() * maxSpeed_;
+
+	// Move the boid and keep it inside the world
+	position_ += velocity_ * timeStep;
+	position_.x_ = Clamp(position_.x_, -worldSize_, worldSize_);
+	position_.y_ = Clamp(position_.y_, -worldSize_, worldSize_);
+	position_.z_ = Clamp(position_.z_, -worldSize_, worldSize_);
+
+	// Move the node - the kinematic body follows it
+	pNode->SetWorldPosition(position_);
+
+	// Set the boids rotation - off screen boids are turned when they come into view
+	if (onScreen_)
+		UpdateRotation();
+}
+
+
+// Point the boid along its velocity
+void Boid::UpdateRotation()
+{
+	// Get the normalised velocity
+	Vector3 normalizedVelocity = GetVelocity().Normalized();
+
+	// Set the boids rotation
+	Quaternion finalRotation = Quaternion::IDENTITY;
+	finalRotation.FromLookRotation(normalizedVelocity, Vector3::UP);
+	if (lockstep_)
+		pNode->SetWorldRotation(finalRotation);
+	else
+		pRigidBody->SetRotation(finalRotation);
+}
+
+
+// Move the boid in lockstep instead of through the physics
+void Boid::SetLockstep(bool lockstep)
+{
+	// Take the state from the rigid body
+	lockstep_ = lockstep;
+	if (lockstep_)
+		SetState(pRigidBody->GetPosition(), pRigidBody->GetLinearVelocity());
+
+	// A kinematic body follows the node and still blocks missiles
+	pRigidBody->SetKinematic(lockstep_);
+}
+
+
+// Does the boid move in lockstep
+bool Boid::IsLockstep() const
+{
+	return lockstep_;
+}
+
+
+// Set the lockstep position and velocity
+void Boid::SetState(const Vector3& position, const Vector3& velocity)
+{
+	position_ = position;
+	velocity_ = velocity;
+	pNode->SetWorldPosition(position_);
+}
+
+
+// Bring a retired or killed boid back into play at the position
+void Boid::Spawn(const Vector3& position, const Vector3& velocity)
+{
+	// Back in the scene and the physics world
+	pNode->SetEnabled(true);
+	force_ = Vector3::ZERO;
+
+	// Move it - the body is moved rather than left to fly on from where it died
+	if (lockstep_)
+		SetState(position, velocity);
+	else
+	{
+		pRigidBody->SetPosition(position);
+		pRigidBody->SetLinearVelocity(velocity);
+		pRigidBody->SetAngularVelocity(Vector3::ZERO);
+	}
+	UpdateRotation();
+}
+
+
+// Take the boid out of play - its node and components are kept for the next spawn
+void Boid::Retire()
+{
+	pNode->SetEnabled(false);
+}
+
+
+// Is the boid in play
+bool Boid::IsAlive() const
+{
+	return pNode->IsEnabled();
+}
+
+
+// Position of the boid
+Vector3 Boid::GetPosition() const
+{
+	return lockstep_ ? position_ : pRigidBody->GetPosition();
+}
+
+
+// Velocity of the boid
+Vector3 Boid::GetVelocity() const
+{
+	return lockstep_ ? velocity_ : pRigidBody->GetLinearVelocity();
+}
+
+
+// Rotation of the boid
+Quaternion Boid::GetRotation() const
+{
+	return lockstep_ ? pNode->GetWorldRotation() : pRigidBody->GetRotation();
+}
+
+
+// Set whether the boid is on screen
+void Boid::SetOnScreen(bool onScreen)
+{
+	// No change
+	if (onScreen == onScreen_)
+		return;
+
+	// Turn the boid to its current heading as it comes into view
+	onScreen_ = onScreen;
+	if (onScreen_)
+		UpdateRotation();
+	RefreshDrawable();
+}
+
+
+// Is the boid on screen
+bool Boid::IsOnScreen()
+{
+	return onScreen_;
+}
+
+
+// Set whether the level of detail draws the model
+void Boid::SetDrawModel(bool drawModel)
+{
+	drawModel_ = drawModel;
+	RefreshDrawable();
+}
+
+
+// Enable the model if it is on screen and drawn by the level of detail
+// - A disabled model is taken out of the octree, so moving it costs no reinsertion
+void Boid::RefreshDrawable()
+{
+	bool enabled = onScreen_ && drawModel_;
+	if (pObject->IsEnabled() != enabled)
+		pObject->SetEnabled(enabled);
+}
+
+
 // Calculate the "target position" force applied to the boid
 Vector3 Boid::TargetPosition(Vector3 targetPosition, float forceStrength)
 {
@@ -566,7 +734,7 @@ Vector3 Boid::TargetPosition(Vector3 targetPosition, float forceStrength)
 	//	return (targetPosition - pRigidBody->GetPosition()) / forceStrength;
 	//else 
 	//	return ((targetPosition - pRigidBody->GetPosition()) / forceStrength) * -1;
-	return (targetPosition - pRigidBody->GetPosition()) / forceStrength;
+	return (targetPosition - GetPosition()) / forceStrength;
 }
 
 
@@ -17,6 +17,7 @@
 #include <Urho3D/Input/Input.h>
 #include <Urho3D/IO/FileSystem.h>
 #include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/NetworkPriority.h>
 #include <Urho3D/Physics/CollisionShape.h>
 #include <Urho3D/Physics/PhysicsWorld.h>
 #include <Urho3D/Physics/RigidBody.h>
@@ -24,6 +25,11 @@
 #include <Urho3D/Scene/Scene.h>
 #include <string>
 #include <vector>
+#include "FlockCounters.h"
+#include "FlockRandom.h"
+
+// Forward declarations
+class BoidPrefab;
 
 // Using the Urho3D namespace
 namespace Urho3D
@@ -38,10 +44,23 @@ namespace Urho3D
 // All Urho3D classes reside in namespace Urho3D
 using namespace Urho3D;
 
+// Boid model types
+enum BoidModelType
+{
+	BOID_TIE_FIGHTER = 0,
+	BOID_TIE_INTERCEPTOR,
+	NUM_BOID_MODELS
+};
+
+// Model and material list of each boid model type
+static const char* const BOID_MODELS[NUM_BOID_MODELS] = { "Models/Tie-Fighter.mdl", "Models/Tie-Interceptor.mdl" };
+static const char* const BOID_MATERIALS[NUM_BOID_MODELS] = { "Models/Tie-Fighter.txt", "Models/Tie-Interceptor.txt" };
+
 // Boid class
 class Boid
 {
 	friend class Grid;
+	friend class FlockCheck;
 
 	// Defines the ranges and scaling factors for each force on the boid
 	// - The range at which the Cohension, Seperation and Alignment forces will take effect on the boid
@@ -66,20 +85,23 @@ public:
 		pRigidBody(nullptr),
 		pCollisionShape(nullptr), 
 		pObject(nullptr), 
+		modelType_(BOID_TIE_FIGHTER),
 		numberToCompute_(10) 
 	{}
 
 	// Destructor
 	~Boid() {}
 
-	// Initialisation function
-	void Initialise(ResourceCache* cache, Scene* scene, Vector3 starPos, bool copy, bool limit);
+	// Initialisation function - the boid is a copy of the prefab's template of its model type
+	// - The model type is drawn from the boid's own random stream
+	// - A retired boid is left out of play until it is spawned
+	void Initialise(BoidPrefab& prefab, Vector3 starPos, FlockRandom& random, bool copy, bool limit, bool retired = false);
 
 	// Update - called each frame by the game engine
 	void Update(float timeStep);
 
 	// Called each frame to calculate the force acting on the boid from its neighbours
-	void ComputeForce(Boid *pBoid);
+	void ComputeForce(Boid *pBoid, FlockCounters& counters);
 
 	// MOVED CALCULATIONS TO COMPUTE FORE TO REDUCE LOOPS
 
@@ -110,9 +132,47 @@ public:
 	// StaticModel pointer
 	StaticModel* pObject;
 
+	// Model type of the boid
+	int modelType_;
+
 	// Set the total number of boids in the set
 	void SetNumberOfBoids(int numBoids);
 
+	// Point the boid along its velocity
+	void UpdateRotation();
+
+	// Set whether the boid is on screen - off screen boids are not drawn or turned
+	void SetOnScreen(bool onScreen);
+
+	// Is the boid on screen
+	bool IsOnScreen();
+
+	// Set whether the level of detail draws the model
+	void SetDrawModel(bool drawModel);
+
+	// Move the boid in lockstep instead of through the physics
+	void SetLockstep(bool lockstep);
+
+	// Does the boid move in lockstep
+	bool IsLockstep() const;
+
+	// Set the lockstep position and velocity
+	void SetState(const Vector3& position, const Vector3& velocity);
+
+	// Bring a retired or killed boid back into play at the position
+	void Spawn(const Vector3& position, const Vector3& velocity);
+
+	// Take the boid out of play - its node and components are kept for the next spawn
+	void Retire();
+
+	// Is the boid in play
+	bool IsAlive() const;
+
+	// Position, velocity and rotation - from the rigid body, or the lockstep state
+	Vector3 GetPosition() const;
+	Vector3 GetVelocity() const;
+	Quaternion GetRotation() const;
+
 private:
 	// Number of boids in the set
 	int numBoids_;
@@ -127,6 +187,21 @@ private:
 	float maxSpeed_ = 10.0f;
 	float worldSize_ = 250.0f;
 
+	// Enable the model if it is on screen and drawn by the level of detail
+	void RefreshDrawable();
+
+	// Update in lockstep - the boid integrates its own state
+	void UpdateLockstep(float timeStep);
+
+	// Lockstep state
+	bool lockstep_ = false;
+	Vector3 position_;
+	Vector3 velocity_;
+
+	// Drawing flags
+	bool onScreen_ = true;
+	bool drawModel_ = true;
+
 	// Flags
 	bool copyRange_ = false;
 	bool forceCopied_ = false;
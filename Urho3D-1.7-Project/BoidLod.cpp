@@ -0,0 +1,328 @@
+// Include directives
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/Technique.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/Graphics/Viewport.h>
+#include "BoidLod.h"
+
+
+// Initialisation function - loads the simplified models and bakes the impostors
+void BoidLod::Initialise(Context* context, ResourceCache* cache, Scene* scene)
+{
+	// Start with no boid sets
+	Clear();
+	scene_ = scene;
+	cache_ = cache;
+
+	// Load the models of each type
+	for (int type = 0; type < NUM_BOID_MODELS; type++)
+	{
+		// Full detail model
+		fullModels_[type] = cache->GetResource<Model>(BOID_MODELS[type]);
+
+		// Simplified model exported next to the full one, if present - else the mid range draws the impostor
+		String simpleName = ReplaceExtension(String(BOID_MODELS[type]), "_LOD1.mdl");
+		if (cache->Exists(simpleName))
+			simpleModels_[type] = cache->GetResource<Model>(simpleName);
+		else
+		{
+			simpleModels_[type] = nullptr;
+			URHO3D_LOGINFOF("No %s - boids past %d units are drawn as impostors", simpleName.CString(), (int)simpleDistance_);
+		}
+
+		// Impostor sprite - needs a renderer
+		if (!impostorMaterials_[type] && context->GetSubsystem<Graphics>())
+			impostorMaterials_[type] = BakeImpostor(context, cache, type);
+	}
+}
+
+
+// Add a set of boids to be managed
+void BoidLod::AddBoidSet(BoidSet* boidSet)
+{
+	// All boids start at full detail
+	ManagedSet managed;
+	managed.boidSet_ = boidSet;
+	managed.levels_.resize(boidSet->numberOfBoids_, BOID_LOD_FULL);
+
+	// One impostor billboard per boid for each model type
+	Node* node = scene_->CreateChild("Impostors", LOCAL);
+	for (int type = 0; type < NUM_BOID_MODELS; type++)
+	{
+		// Impostor billboards
+		BillboardSet* impostors = node->CreateComponent<BillboardSet>(LOCAL);
+		impostors->SetNumBillboards(boidSet->numberOfBoids_);
+		impostors->SetMaterial(impostorMaterials_[type]);
+		impostors->SetRelative(false);
+		impostors->SetSorted(false);
+		impostors->SetCastShadows(false);
+
+		// Size the sprites to the model
+		float size = fullModels_[type]->GetBoundingBox().Size().Length();
+		for (int i = 0; i < boidSet->numberOfBoids_; i++)
+		{
+			Billboard* billboard = impostors->GetBillboard(i);
+			billboard->size_ = Vector2(size, size) * 0.5f;
+			billboard->uv_ = SelectView(Quaternion::IDENTITY, Vector3::FORWARD);
+			billboard->enabled_ = false;
+		}
+		impostors->Commit();
+		managed.impostors_[type] = impostors;
+	}
+
+	// Manage the set
+	sets_.push_back(managed);
+}
+
+
+// Forget the boid sets (the scene has been cleared)
+void BoidLod::Clear()
+{
+	sets_.clear();
+	for (int level = 0; level < 3; level++)
+		levelCounts_[level] = 0;
+}
+
+
+// Update - called each frame after the physics step
+void BoidLod::Update(Node* cameraNode)
+{
+	// Reset the counts
+	for (int level = 0; level < 3; level++)
+		levelCounts_[level] = 0;
+
+	// No camera to measure from
+	if (!cameraNode)
+		return;
+	Vector3 cameraPosition = cameraNode->GetWorldPosition();
+
+	// Loop through the boid sets
+	for (auto& managed : sets_)
+	{
+		// The flock state has been refreshed after the physics step
+		BoidSet* boidSet = managed.boidSet_;
+
+		// Any impostors to redraw
+		bool impostorsChanged = false;
+
+		// Loop through the boids
+		for (int i = 0; i < boidSet->numberOfBoids_; i++)
+		{
+			// Impostor of this boid
+			int type = boidSet->modelTypes_[i];
+			Billboard* billboard = managed.impostors_[type]->GetBillboard(i);
+
+			// Dead boids show nothing
+			if (!boidSet->alive_[i])
+			{
+				if (billboard->enabled_)
+				{
+					billboard->enabled_ = false;
+					impostorsChanged = true;
+				}
+				continue;
+			}
+
+			// Select the level for the distance
+			float distance = (boidSet->positions_[i] - cameraPosition).Length();
+			int level = SelectLevel(managed.levels_[i], distance);
+
+			// No simplified model - the impostor stands in for it, or the full model without one
+			if (level == BOID_LOD_SIMPLE && !simpleModels_[type])
+				level = impostorMaterials_[type] ? BOID_LOD_IMPOSTOR : BOID_LOD_FULL;
+
+			// Impostors need a baked sprite - the simplified model stands in, or the full model without one
+			if (level == BOID_LOD_IMPOSTOR && !impostorMaterials_[type])
+				level = simpleModels_[type] ? BOID_LOD_SIMPLE : BOID_LOD_FULL;
+
+			// Apply a change of level
+			if (level != managed.levels_[i])
+			{
+				ApplyLevel(boidSet->boidList[i], level);
+				managed.levels_[i] = (unsigned char)level;
+			}
+			levelCounts_[level]++;
+
+			// Move the impostor with the boid, showing the side the camera sees
+			bool impostor = level == BOID_LOD_IMPOSTOR;
+			if (impostor || billboard->enabled_)
+			{
+				billboard->enabled_ = impostor;
+				billboard->position_ = boidSet->positions_[i];
+				if (impostor)
+					billboard->uv_ = SelectView(boidSet->rotations_[i], cameraPosition - boidSet->positions_[i]);
+				impostorsChanged = true;
+			}
+		}
+
+		// Upload the impostors
+		if (impostorsChanged)
+		{
+			for (int type = 0; type < NUM_BOID_MODELS; type++)
+				managed.impostors_[type]->Commit();
+		}
+	}
+}
+
+
+// Work out the new level of a boid from its distance
+int BoidLod::SelectLevel(int currentLevel, float distance)
+{
+	// Switch distances out from each level
+	float switchDistance[2] = { simpleDistance_, impostorDistance_ };
+	int level = currentLevel;
+
+	// Move to a lower detail level once past the switch distance plus the hysteresis
+	while (level < BOID_LOD_IMPOSTOR && distance > switchDistance[level] + hysteresis_)
+		level++;
+
+	// Move to a higher detail level once inside the switch distance minus the hysteresis
+	while (level > BOID_LOD_FULL && distance < switchDistance[level - 1] - hysteresis_)
+		level--;
+
+	// Return the level
+	return level;
+}
+
+
+// Apply a level to a boid
+void BoidLod::ApplyLevel(Boid& boid, int level)
+{
+	// Impostor - the model is not drawn
+	if (level == BOID_LOD_IMPOSTOR)
+	{
+		boid.SetDrawModel(false);
+		return;
+	}
+
+	// Swap the model, keeping the materials
+	Model* model = level == BOID_LOD_FULL ? fullModels_[boid.modelType_] : simpleModels_[boid.modelType_];
+	if (boid.pObject->GetModel() != model)
+	{
+		// Keep the materials of the current model
+		Vector<SharedPtr<Material> > materials;
+		for (unsigned i = 0; i < boid.pObject->GetNumGeometries(); i++)
+			materials.Push(SharedPtr<Material>(boid.pObject->GetMaterial(i)));
+
+		// Set the model and restore the materials
+		boid.pObject->SetModel(model);
+		for (unsigned i = 0; i < boid.pObject->GetNumGeometries() && i < materials.Size(); i++)
+			boid.pObject->SetMaterial(i, materials[i]);
+	}
+
+	// Shadows are left to the shadow budget
+	boid.SetDrawModel(true);
+}
+
+
+// Bake an impostor texture of a model, returns its material
+Material* BoidLod::BakeImpostor(Context* context, ResourceCache* cache, int modelType)
+{
+	// Scene holding just the model, with a transparent background
+	SharedPtr<Scene> bakeScene(new Scene(context));
+	bakeScene->CreateComponent<Octree>();
+	Zone* zone = bakeScene->CreateChild("Zone")->CreateComponent<Zone>();
+	zone->SetBoundingBox(BoundingBox(-1000.0f, 1000.0f));
+	zone->SetAmbientColor(Color(0.5f, 0.5f, 0.5f));
+	zone->SetFogColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
+
+	// Light from the same direction as the main scene
+	Node* lightNode = bakeScene->CreateChild("Light");
+	lightNode->SetDirection(Vector3(0.3f, -0.5f, 0.425f));
+	lightNode->CreateComponent<Light>()->SetLightType(LIGHT_DIRECTIONAL);
+
+	// The model
+	StaticModel* model = bakeScene->CreateChild("Model")->CreateComponent<StaticModel>();
+	model->SetModel(fullModels_[modelType]);
+	model->ApplyMaterialList(BOID_MATERIALS[modelType]);
+
+	// Render target texture holding every view, drawn once on the next frame
+	SharedPtr<Texture2D> texture(new Texture2D(context));
+	texture->SetSize(BOID_IMPOSTOR_SIZE * BOID_IMPOSTOR_YAWS, BOID_IMPOSTOR_SIZE * BOID_IMPOSTOR_PITCHES, Graphics::GetRGBAFormat(), TEXTURE_RENDERTARGET);
+	texture->SetFilterMode(FILTER_BILINEAR);
+	RenderSurface* surface = texture->GetRenderSurface();
+	surface->SetNumViewports(BOID_IMPOSTOR_YAWS * BOID_IMPOSTOR_PITCHES);
+
+	// An orthographic camera for each view, looking at the model from its yaw and pitch - rows
+	// from below to above, columns around from the front
+	float size = fullModels_[modelType]->GetBoundingBox().Size().Length();
+	Vector3 centre = fullModels_[modelType]->GetBoundingBox().Center();
+	for (int row = 0; row < BOID_IMPOSTOR_PITCHES; row++)
+	{
+		for (int column = 0; column < BOID_IMPOSTOR_YAWS; column++)
+		{
+			float yaw = column * 360.0f / BOID_IMPOSTOR_YAWS;
+			float pitch = (row - (BOID_IMPOSTOR_PITCHES - 1) * 0.5f) * BOID_IMPOSTOR_PITCH_STEP;
+			Vector3 direction(Sin(yaw) * Cos(pitch), Sin(pitch), Cos(yaw) * Cos(pitch));
+			Node* cameraNode = bakeScene->CreateChild("Camera");
+			cameraNode->SetPosition(centre + direction * size * 1.5f);
+			cameraNode->LookAt(centre);
+			Camera* camera = cameraNode->CreateComponent<Camera>();
+			camera->SetOrthographic(true);
+			camera->SetOrthoSize(size);
+			camera->SetFarClip(size * 4.0f);
+
+			// Its cell of the texture
+			IntRect rect(column * BOID_IMPOSTOR_SIZE, row * BOID_IMPOSTOR_SIZE, (column + 1) * BOID_IMPOSTOR_SIZE, (row + 1) * BOID_IMPOSTOR_SIZE);
+			surface->SetViewport(row * BOID_IMPOSTOR_YAWS + column, new Viewport(context, bakeScene, camera, rect));
+		}
+	}
+	surface->SetUpdateMode(SURFACE_MANUALUPDATE);
+	surface->QueueUpdate();
+	bakeScenes_.Push(bakeScene);
+
+	// Unlit alpha blended sprite material
+	Material* material = new Material(context);
+	material->SetTechnique(0, cache->GetResource<Technique>("Techniques/DiffUnlitAlpha.xml"));
+	material->SetTexture(TU_DIFFUSE, texture);
+	return material;
+}
+
+
+// Texture rectangle of the baked view nearest to the direction a boid is seen from
+Rect BoidLod::SelectView(const Quaternion& rotation, const Vector3& toCamera)
+{
+	// The camera's direction in the model's frame, as a yaw and pitch
+	Vector3 direction = (rotation.Inverse() * toCamera).Normalized();
+	float yaw = Atan2(direction.x_, direction.z_);
+	float pitch = Asin(Clamp(direction.y_, -1.0f, 1.0f));
+
+	// The nearest view baked
+	int column = RoundToInt(yaw / 360.0f * BOID_IMPOSTOR_YAWS);
+	column = ((column % BOID_IMPOSTOR_YAWS) + BOID_IMPOSTOR_YAWS) % BOID_IMPOSTOR_YAWS;
+	int row = Clamp(RoundToInt(pitch / BOID_IMPOSTOR_PITCH_STEP + (BOID_IMPOSTOR_PITCHES - 1) * 0.5f), 0, BOID_IMPOSTOR_PITCHES - 1);
+
+	// Its cell of the texture
+	float width = 1.0f / BOID_IMPOSTOR_YAWS;
+	float height = 1.0f / BOID_IMPOSTOR_PITCHES;
+	return Rect(column * width, row * height, (column + 1) * width, (row + 1) * height);
+}
+
+
+// Set the switch distances
+void BoidLod::SetDistances(float simpleDistance, float impostorDistance)
+{
+	simpleDistance_ = simpleDistance;
+	impostorDistance_ = Max(impostorDistance, simpleDistance + 2.0f * hysteresis_);
+}
+
+
+// Get the simplified model switch distance
+float BoidLod::GetSimpleDistance()
+{
+	return simpleDistance_;
+}
+
+
+// Get the impostor switch distance
+float BoidLod::GetImpostorDistance()
+{
+	return impostorDistance_;
+}
+
+
+// Number of boids at each level on the last update
+int BoidLod::GetNumAtLevel(int level)
+{
+	return levelCounts_[level];
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Graphics/BillboardSet.h>
+#include "BoidSet.h"
+
+// Boid detail levels
+enum BoidLodLevel
+{
+	BOID_LOD_FULL = 0,
+	BOID_LOD_SIMPLE,
+	BOID_LOD_IMPOSTOR
+};
+
+// Default distances at which the boids switch to the simplified mesh and the impostor
+const float BOID_LOD_SIMPLE_DISTANCE = 60.0f;
+const float BOID_LOD_IMPOSTOR_DISTANCE = 140.0f;
+
+// Default distance either side of a switch distance before a boid changes level
+const float BOID_LOD_HYSTERESIS = 8.0f;
+
+// Size (pixels) of each view of the baked impostor textures
+const int BOID_IMPOSTOR_SIZE = 128;
+
+// Views baked into each impostor texture - around the model, and from below, level and above
+// it, BOID_IMPOSTOR_PITCH_STEP degrees apart
+const int BOID_IMPOSTOR_YAWS = 8;
+const int BOID_IMPOSTOR_PITCHES = 3;
+const float BOID_IMPOSTOR_PITCH_STEP = 40.0f;
+
+// Boid level of detail class
+// - Full model close to the camera
+// - Simplified model (Models/<name>_LOD1.mdl, exported by the asset pipeline) at mid range,
+//   falling back to the impostor when the asset is missing (the full model if none is baked)
+// - A camera-facing impostor sprite at far range, baked from the model when the game starts
+//   from BOID_IMPOSTOR_YAWS x BOID_IMPOSTOR_PITCHES angles into one texture; each impostor
+//   shows the view nearest to the direction the camera sees its boid from
+// - Each boid only changes level once it is past the switch distance plus the hysteresis
+class BoidLod
+{
+public:
+	// Constructor
+	BoidLod() :
+		simpleDistance_(BOID_LOD_SIMPLE_DISTANCE),
+		impostorDistance_(BOID_LOD_IMPOSTOR_DISTANCE),
+		hysteresis_(BOID_LOD_HYSTERESIS)
+	{}
+
+	// Initialisation function - loads the simplified models and bakes the impostors
+	void Initialise(Context* context, ResourceCache* cache, Scene* scene);
+
+	// Add a set of boids to be managed
+	void AddBoidSet(BoidSet* boidSet);
+
+	// Forget the boid sets (the scene has been cleared)
+	void Clear();
+
+	// Update - called each frame after the physics step
+	void Update(Node* cameraNode);
+
+	// Set the switch distances
+	void SetDistances(float simpleDistance, float impostorDistance);
+
+	// Get the switch distances
+	float GetSimpleDistance();
+	float GetImpostorDistance();
+
+	// Number of boids at each level on the last update
+	int GetNumAtLevel(int level);
+
+private:
+	// Per boid set state
+	struct ManagedSet
+	{
+		BoidSet* boidSet_;
+		std::vector<unsigned char> levels_;
+		BillboardSet* impostors_[NUM_BOID_MODELS];
+	};
+
+	// Bake an impostor texture of a model, returns its material
+	Material* BakeImpostor(Context* context, ResourceCache* cache, int modelType);
+
+	// Texture rectangle of the baked view nearest to the direction a boid is seen from
+	static Rect SelectView(const Quaternion& rotation, const Vector3& toCamera);
+
+	// Work out the new level of a boid from its distance
+	int SelectLevel(int currentLevel, float distance);
+
+	// Apply a level to a boid
+	void ApplyLevel(Boid& boid, int level);
+
+	// The managed boid sets
+	std::vector<ManagedSet> sets_;
+
+	// Scene and cache used for new boid sets
+	Scene* scene_ = nullptr;
+	ResourceCache* cache_ = nullptr;
+
+	// Models and impostor materials of each model type
+	SharedPtr<Model> fullModels_[NUM_BOID_MODELS];
+	SharedPtr<Model> simpleModels_[NUM_BOID_MODELS];
+	SharedPtr<Material> impostorMaterials_[NUM_BOID_MODELS];
+
+	// Scenes used to bake the impostors
+	Vector<SharedPtr<Scene> > bakeScenes_;
+
+	// Switch distances
+	float simpleDistance_;
+	float impostorDistance_;
+	float hysteresis_;
+
+	// Count of boids at each level
+	int levelCounts_[3] = {};
+};
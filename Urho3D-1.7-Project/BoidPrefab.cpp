@@ -0,0 +1,72 @@
+// Include directives
+#include <Urho3D/Core/Profiler.h>
+#include "BoidPrefab.h"
+
+
+// Build the templates in the scene - boids sent through the flock channel are created local
+void BoidPrefab::Initialise(ResourceCache* cache, Scene* scene, CreateMode mode)
+{
+	scene_ = scene;
+	mode_ = mode;
+
+	// One template per model type
+	for (int type = 0; type < NUM_BOID_MODELS; type++)
+	{
+		// A template built before goes
+		if (templates_[type])
+			templates_[type]->Remove();
+
+		// The node - the clones are renamed, so nothing mistakes the template for a boid
+		Node* node = scene->CreateChild("BoidPrefab", mode);
+		node->SetRotation(Quaternion::IDENTITY);
+		node->SetScale(1.0f);
+
+		// Model, material and shadows
+		StaticModel* object = node->CreateComponent<StaticModel>();
+		object->SetModel(cache->GetResource<Model>(BOID_MODELS[type]));
+		object->ApplyMaterialList(BOID_MATERIALS[type]);
+		object->SetCastShadows(true);
+
+		// Rigid body without gravity on the boid collision layer
+		RigidBody* rigidBody = node->CreateComponent<RigidBody>();
+		rigidBody->SetCollisionLayer(1);
+		rigidBody->SetMass(1.0f);
+		rigidBody->SetUseGravity(false);
+
+		// Collision shape
+		CollisionShape* collisionShape = node->CreateComponent<CollisionShape>();
+		collisionShape->SetBox(Vector3::ONE);
+
+		// Replicated boids far from a client are sent to it less often
+		if (mode == REPLICATED)
+		{
+			NetworkPriority* priority = node->CreateComponent<NetworkPriority>();
+			priority->SetBasePriority(100.0f);
+			priority->SetDistanceFactor(0.5f);
+			priority->SetMinPriority(10.0f);
+		}
+
+		// Disabled - neither drawn nor in the physics world, and neither are its clones
+		node->SetEnabled(false);
+		templates_[type] = node;
+	}
+}
+
+
+// Are the templates built
+bool BoidPrefab::IsInitialised() const
+{
+	return templates_[0].NotNull();
+}
+
+
+// A disabled copy of the model type's template
+Node* BoidPrefab::Instantiate(int modelType)
+{
+	URHO3D_PROFILE(InstantiateBoid);
+
+	// Cloned next to the template, with its components and resources
+	Node* node = templates_[modelType]->Clone(mode_);
+	node->SetName("Boid");
+	return node;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Scene/Node.h>
+#include "Boid.h"
+
+// Boids built a frame when a set is built over several frames
+const int BOID_BUILD_PER_FRAME = 256;
+
+// Boid prefab class
+// - Builds a disabled template node per model type once - model, material list, rigid
+//   body, collision shape and network priority - and makes each boid as a clone of it
+// - The resources are looked up and the material list files read for the templates only,
+//   instead of for every boid
+// - Clones start disabled, out of the physics world, until the boid is put in play
+class BoidPrefab
+{
+public:
+	// Constructor
+	BoidPrefab() :
+		scene_(nullptr),
+		mode_(REPLICATED)
+	{}
+
+	// Build the templates in the scene - boids sent through the flock channel are created local
+	void Initialise(ResourceCache* cache, Scene* scene, CreateMode mode = REPLICATED);
+
+	// Are the templates built
+	bool IsInitialised() const;
+
+	// A disabled copy of the model type's template
+	Node* Instantiate(int modelType);
+
+private:
+	// Scene the templates are in, and how their copies are created
+	Scene* scene_;
+	CreateMode mode_;
+
+	// Template of each model type
+	WeakPtr<Node> templates_[NUM_BOID_MODELS];
+};
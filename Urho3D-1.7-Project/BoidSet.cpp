@@ -1,71 +1,113 @@
 // Inculude directives
+#include <Urho3D/Core/Profiler.h>
 #include "BoidSet.h"
+#include "BoidPrefab.h"
+#include "FlockRenderer.h"
 
 
 // Initialisation function
-void BoidSet::Initialise(ResourceCache* cache, Scene* scene, int numbOfBoids, bool copy, bool limit, bool halfUpdate)
+void BoidSet::Initialise(BoidPrefab& prefab, int numbOfBoids, const FlockRandom& random, bool copy, bool limit, bool halfUpdate, bool pooled)
 {
-	// Set the number of boids
+	// Build every boid at once
+	BeginBuild(numbOfBoids, random, copy, limit, halfUpdate, pooled);
+	Build(prefab, numberOfBoids_);
+}
+
+
+// Start a set whose boids are built over several frames by Build
+void BoidSet::BeginBuild(int numbOfBoids, const FlockRandom& random, bool copy, bool limit, bool halfUpdate, bool pooled)
+{
+	// Set the number of boids - a set initialised again starts empty
 	numberOfBoids_ = numbOfBoids;
+	boidList.clear();
+	boidList.reserve(numberOfBoids_);
+	random_ = random;
 
-	// Loop to call the Initialise function for each Boid in the array
-	for (int i = 0; i < numberOfBoids_; i++)
+	// Settings of the boids to build
+	copy_ = copy;
+	limit_ = limit;
+	pooled_ = pooled;
+
+	// Half update - two phases
+	SetUpdatePhases(halfUpdate ? 2 : 1);
+
+	// Size the flock state arrays up front, so building never grows them
+	positions_.resize(numberOfBoids_);
+	velocities_.resize(numberOfBoids_);
+	rotations_.resize(numberOfBoids_);
+	modelTypes_.resize(numberOfBoids_);
+	alive_.resize(numberOfBoids_);
+}
+
+
+// Build up to the number of boids of the set - true once every boid is built
+bool BoidSet::Build(BoidPrefab& prefab, int maxBoids)
+{
+	URHO3D_PROFILE(BuildBoidSet);
+
+	// Loop to call the Initialise function for the next boids in the array
+	int end = Min((int)boidList.size() + maxBoids, numberOfBoids_);
+	for (int i = (int)boidList.size(); i < end; i++)
 	{
-		Vector3 startPos = Vector3(Random(50.0f) - 25.0f, Random(50.0f) - 25.0f, Random(50.0f) - 25.0f);
+		// Each boid's own stream - the same start whichever order, frame or thread builds it
+		FlockRandom boidRandom = random_.Split(i);
+		Vector3 startPos = Vector3(boidRandom.Next(50.0f) - 25.0f, boidRandom.Next(50.0f) - 25.0f, boidRandom.Next(50.0f) - 25.0f);
 		boidList.push_back(Boid());
-		boidList[i].Initialise(cache, scene, startPos, copy, limit);
+		boidList[i].Initialise(prefab, startPos, boidRandom, copy_, limit_, pooled_);
 		boidList[i].SetNumberOfBoids(numberOfBoids_);
 	}
 
-	// Set flags
-	halfUpdate_ = halfUpdate;
+	// Not finished
+	if (!IsBuilt())
+		return false;
+
+	// Fill in the flock state
+	SyncState();
+	return true;
+}
+
+
+// Is every boid built
+bool BoidSet::IsBuilt() const
+{
+	return (int)boidList.size() == numberOfBoids_;
 }
 
 
 // Update - called each frame by the game engine
 void BoidSet::Update(float timeStep)
 {
-	// Half update optimisation
-	static int update = 1;
-	int i = 0;
-	int end = numberOfBoids_;
+	// Pooled - nothing in play
+	if (!active_)
+		return;
 
-	// Update half
-	if (halfUpdate_)
-	{
-		// Update first half
-		if (update == 1)
-		{
-			i = 0;
-			end = numberOfBoids_ / 2;
-			update = 2;
-		}
-
-		// Update second half
-		else
-		{
-			i = numberOfBoids_ / 2;
-			end = numberOfBoids_;
-			update = 1;
-		}
-	}
-
-	// Update all
-	else
-	{
-		i = 0;
-		end = numberOfBoids_;
-	}
+	// Staggered update - only this frame's phase of the set (all of it with one phase)
+	int i = updatePhase_ * numberOfBoids_ / updatePhases_;
+	int end = (updatePhase_ + 1) * numberOfBoids_ / updatePhases_;
+	updatePhase_ = (updatePhase_ + 1) % updatePhases_;
 
 	// Loop to call the ComputeForce and Update function for each boid in the array
 	for (; i < end; i++)
 	{
+		// Out of play
+		if (!boidList[i].IsAlive())
+			continue;
+
 		// Compute the force applied to each boid
 		// Passed the address of the first element in the array
-		boidList[i].ComputeForce(&boidList[0]);
+		boidList[i].ComputeForce(&boidList[0], counters_);
+
+		// Update the boid - lockstep boids are moved below
+		if (!boidList[i].IsLockstep())
+			boidList[i].Update(timeStep);
+	}
 
-		// Update the boid
-		boidList[i].Update(timeStep);
+	// Lockstep boids only move by their own integration, so every one moves every tick, with the
+	// force last found for it - the physics moves the other boids whatever the phase
+	for (auto& boid : boidList)
+	{
+		if (boid.IsLockstep() && boid.IsAlive())
+			boid.Update(timeStep);
 	}
 }
 
@@ -78,4 +120,69 @@ void BoidSet::SetTargets(Node* node, float forceStrength)
 	{
 		boidList[i].SetTargetVectors(node, forceStrength);
 	}
+}
+
+
+// Copy the boid transforms from the rigid bodies into the flock state arrays
+void BoidSet::SyncState()
+{
+	// Loop through boids
+	for (int i = 0; i < numberOfBoids_; i++)
+	{
+		positions_[i] = boidList[i].GetPosition();
+		velocities_[i] = boidList[i].GetVelocity();
+		rotations_[i] = boidList[i].GetRotation();
+		modelTypes_[i] = boidList[i].modelType_;
+		alive_[i] = boidList[i].pNode->IsEnabled() ? 1 : 0;
+	}
+}
+
+
+// Move the boids in lockstep instead of through the physics
+void BoidSet::SetLockstep(bool lockstep)
+{
+	for (auto& boid : boidList)
+		boid.SetLockstep(lockstep);
+}
+
+
+// Split the set into phases, one updated each frame (1 updates every boid every frame)
+void BoidSet::SetUpdatePhases(int phases)
+{
+	// Start again from the first phase
+	updatePhases_ = Clamp(phases, 1, BOID_MAX_UPDATE_PHASES);
+	updatePhase_ = 0;
+}
+
+
+// Draw the boids through instanced flock renderers instead of a model per boid
+void BoidSet::EnableInstancing(ResourceCache* cache, Scene* scene)
+{
+	// One renderer per model type on a local node
+	Node* node = scene->CreateChild("FlockRenderer", LOCAL);
+	for (int type = 0; type < NUM_BOID_MODELS; type++)
+	{
+		renderers_[type] = node->CreateComponent<FlockRenderer>(LOCAL);
+		renderers_[type]->SetModel(cache->GetResource<Model>(BOID_MODELS[type]));
+		renderers_[type]->ApplyMaterialList(BOID_MATERIALS[type]);
+		renderers_[type]->SetCastShadows(true);
+		renderers_[type]->SetFlock(this, type);
+	}
+
+	// The boids keep their physics but no longer draw themselves
+	for (auto& boid : boidList)
+		boid.pObject->SetEnabled(false);
+}
+
+
+// Rebuild the instanced renderers from the flock state
+void BoidSet::UpdateRenderers()
+{
+	// Not instancing
+	if (!renderers_[0])
+		return;
+
+	// Rebuild each renderer
+	for (int type = 0; type < NUM_BOID_MODELS; type++)
+		renderers_[type]->UpdateInstances();
 }
\ No newline at end of file
@@ -3,6 +3,13 @@
 // Include directives
 #include "Boid.h"
 
+// Forward declarations
+class BoidPrefab;
+class FlockRenderer;
+
+// Most update phases a set can be split into
+const int BOID_MAX_UPDATE_PHASES = 4;
+
 // Boid Set class
 class BoidSet
 {
@@ -13,8 +20,19 @@ public:
 	// Constructor
 	BoidSet() {};
 
-	// Initialisation function
-	void Initialise(ResourceCache* cache, Scene* scene, int numbOfBoids, bool copy, bool limit, bool halfUpdate);
+	// Initialisation function - the boids are placed from the set's random stream
+	// - A pooled set's boids start retired, for the wave director to spawn
+	void Initialise(BoidPrefab& prefab, int numbOfBoids, const FlockRandom& random, bool copy, bool limit, bool halfUpdate, bool pooled = false);
+
+	// Start a set whose boids are built over several frames by Build
+	// - The set is not updated, or handed to the game's systems, until it is built
+	void BeginBuild(int numbOfBoids, const FlockRandom& random, bool copy, bool limit, bool halfUpdate, bool pooled = false);
+
+	// Build up to the number of boids of the set - true once every boid is built
+	bool Build(BoidPrefab& prefab, int maxBoids);
+
+	// Is every boid built
+	bool IsBuilt() const;
 
 	// Update - called each frame by the game engine
 	void Update(float timeStep);
@@ -22,9 +40,51 @@ public:
 	// Set the targets
 	void SetTargets(Node* node, float forceStrength);
 
+	// Copy the boid transforms from the rigid bodies into the flock state arrays
+	void SyncState();
+
+	// Move the boids in lockstep instead of through the physics
+	void SetLockstep(bool lockstep);
+
+	// Split the set into phases, one updated each frame (1 updates every boid every frame)
+	void SetUpdatePhases(int phases);
+
+	// Draw the boids through instanced flock renderers instead of a model per boid
+	void EnableInstancing(ResourceCache* cache, Scene* scene);
+
+	// Rebuild the instanced renderers from the flock state
+	void UpdateRenderers();
+
 	// Number of boids
 	int numberOfBoids_;
 
-	// Optimisation flag
-	bool halfUpdate_ = false;
-};
\ No newline at end of file
+	// Number of update phases - 2 is the half update optimisation
+	int updatePhases_ = 1;
+
+	// Phase of the set updated next - per set so the sets don't share it
+	int updatePhase_ = 0;
+
+	// In play - a set pooled by the wave director holds only retired boids and is not updated
+	bool active_ = true;
+
+	// Flock state - one entry per boid, refreshed by SyncState
+	std::vector<Vector3> positions_;
+	std::vector<Vector3> velocities_;
+	std::vector<Quaternion> rotations_;
+	std::vector<int> modelTypes_;
+	std::vector<unsigned char> alive_;
+
+	// Random stream of the set - each boid draws from its own split of it
+	FlockRandom random_;
+
+	// Settings of the boids still to be built
+	bool copy_ = false;
+	bool limit_ = false;
+	bool pooled_ = false;
+
+	// Counters of the flock kernel over the current frame (see FlockCounters.h)
+	FlockCounters counters_;
+
+	// Instanced renderers, one per model type (null when not instancing)
+	FlockRenderer* renderers_[NUM_BOID_MODELS] = {};
+};
@@ -0,0 +1,149 @@
+// Include directives
+#include <cstdio>
+#include <Urho3D/IO/Log.h>
+#include "BotClient.h"
+
+// One pass of the scripted flight
+struct BotScriptStep
+{
+	float duration_;
+	unsigned buttons_;
+	float yaw_;
+	float pitch_;
+};
+
+// Scripted flight - cruise, turn, attack run, brake and roll, repeated
+static const BotScriptStep BOT_SCRIPT[] =
+{
+	{ 3.0f, CTRL_FORWARD, 0.0f, 0.0f },
+	{ 1.0f, CTRL_FORWARD | CTRL_LEFT, 1.0f, 0.0f },
+	{ 2.0f, CTRL_FORWARD | CTRL_FIRE, 0.0f, -0.5f },
+	{ 1.0f, CTRL_BACK, -1.0f, 0.5f },
+	{ 1.0f, CTRL_RIGHT | CTRL_FIRE, 0.0f, 0.0f }
+};
+static const unsigned BOT_SCRIPT_STEPS = sizeof(BOT_SCRIPT) / sizeof(BOT_SCRIPT[0]);
+
+
+// Initialise the bot - the ID seeds its random controls
+void BotClient::Initialise(unsigned id, BotBehaviour behaviour)
+{
+	id_ = id;
+	behaviour_ = behaviour;
+	random_ = id * 2654435761u + 1;
+	time_ = 0.0f;
+	holdTimer_ = 0.0f;
+	held_.Reset();
+	reportTimer_ = 0.0f;
+	numUpdates_ = 0;
+	numSnapshots_ = 0;
+}
+
+
+// Controls for the next physics step
+Controls BotClient::GetControls(float timeStep)
+{
+	// Time flown
+	time_ += timeStep;
+
+	// Scripted - find the step of the script for the time
+	if (behaviour_ == BOT_SCRIPTED)
+	{
+		// Length of one pass
+		float length = 0.0f;
+		for (unsigned i = 0; i < BOT_SCRIPT_STEPS; i++)
+			length += BOT_SCRIPT[i].duration_;
+
+		// Find the step, each bot starting at a different point
+		float t = fmodf(time_ + id_ * 0.37f, length);
+		unsigned step = 0;
+		while (step < BOT_SCRIPT_STEPS - 1 && t >= BOT_SCRIPT[step].duration_)
+		{
+			t -= BOT_SCRIPT[step].duration_;
+			step++;
+		}
+
+		// Controls of the step
+		Controls controls;
+		controls.buttons_ = BOT_SCRIPT[step].buttons_;
+		controls.yaw_ = BOT_SCRIPT[step].yaw_;
+		controls.pitch_ = BOT_SCRIPT[step].pitch_;
+		return controls;
+	}
+
+	// Random - hold each choice for a while
+	holdTimer_ -= timeStep;
+	if (holdTimer_ <= 0.0f)
+	{
+		holdTimer_ = BOT_HOLD_TIME;
+		held_.Reset();
+
+		// Mostly forward, sometimes braking
+		float speed = NextRandom();
+		if (speed < 0.7f)
+			held_.Set(CTRL_FORWARD);
+		else if (speed < 0.85f)
+			held_.Set(CTRL_BACK);
+
+		// Roll and fire
+		float roll = NextRandom();
+		if (roll < 0.2f)
+			held_.Set(CTRL_LEFT);
+		else if (roll < 0.4f)
+			held_.Set(CTRL_RIGHT);
+		if (NextRandom() < 0.3f)
+			held_.Set(CTRL_FIRE);
+
+		// Steer
+		held_.yaw_ = (NextRandom() * 2.0f - 1.0f) * BOT_MAX_TURN;
+		held_.pitch_ = (NextRandom() * 2.0f - 1.0f) * BOT_MAX_TURN;
+	}
+
+	// Return the held controls
+	return held_;
+}
+
+
+// Count a network update of the server received
+void BotClient::AddUpdate()
+{
+	numUpdates_++;
+}
+
+
+// Count a flock snapshot or lockstep tick received
+void BotClient::AddSnapshot()
+{
+	numSnapshots_++;
+}
+
+
+// Measure the connection and report it every BOT_REPORT_INTERVAL
+void BotClient::Update(Connection* connection, float timeStep)
+{
+	// Not time to report yet
+	reportTimer_ += timeStep;
+	if (reportTimer_ < BOT_REPORT_INTERVAL)
+		return;
+
+	// Report the connection
+	if (connection)
+	{
+		char text[200];
+		snprintf(text, sizeof(text), "Bot %u: round trip %.1f ms, %.0f bytes/s in, %.1f updates/s, %.1f flock channel snapshots/s",
+			id_, connection->GetRoundTripTime() * 1000.0f, connection->GetBytesInPerSec(), numUpdates_ / reportTimer_, numSnapshots_ / reportTimer_);
+		URHO3D_LOGINFO(text);
+	}
+
+	// Start the next measurement
+	reportTimer_ = 0.0f;
+	numUpdates_ = 0;
+	numSnapshots_ = 0;
+}
+
+
+// Next random number in [0, 1)
+float BotClient::NextRandom()
+{
+	random_ = random_ * 1664525u + 1013904223u;
+	return (random_ >> 8) / 16777216.0f;
+}
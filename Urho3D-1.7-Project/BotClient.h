@@ -0,0 +1,85 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/Network/Connection.h>
+#include "ShipControls.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Bot behaviours
+enum BotBehaviour
+{
+	BOT_RANDOM = 0,
+	BOT_SCRIPTED
+};
+
+// Seconds between bot reports in the log
+const float BOT_REPORT_INTERVAL = 5.0f;
+
+// Seconds a random bot holds its controls
+const float BOT_HOLD_TIME = 0.5f;
+
+// Largest yaw and pitch a bot steers with (as mouse movement scaled by the rotation speed)
+const float BOT_MAX_TURN = 2.0f;
+
+// Bot client class
+// - Flies a headless client's ship with scripted or random controls, using the same
+//   buttons as a player (forward, back, left, right and fire)
+// - Counts the server's network updates, whether the boids come by scene replication or the
+//   flock channel, and the flock snapshots (or lockstep ticks) among them, and reports the round
+//   trip time, bytes received each second and both rates in the log
+// - Random controls come from the bot's own generator, so they never disturb the seeded
+//   flock of a lockstep game
+class BotClient
+{
+public:
+	// Constructor
+	BotClient() :
+		behaviour_(BOT_RANDOM),
+		id_(0),
+		random_(1),
+		time_(0.0f),
+		holdTimer_(0.0f),
+		reportTimer_(0.0f),
+		numUpdates_(0),
+		numSnapshots_(0)
+	{}
+
+	// Initialise the bot - the ID seeds its random controls
+	void Initialise(unsigned id, BotBehaviour behaviour);
+
+	// Controls for the next physics step
+	Controls GetControls(float timeStep);
+
+	// Count a network update of the server received
+	void AddUpdate();
+
+	// Count a flock snapshot or lockstep tick received
+	void AddSnapshot();
+
+	// Measure the connection and report it every BOT_REPORT_INTERVAL
+	void Update(Connection* connection, float timeStep);
+
+private:
+	// Next random number in [0, 1)
+	float NextRandom();
+
+	// Behaviour and ID
+	BotBehaviour behaviour_;
+	unsigned id_;
+
+	// Random generator state
+	unsigned random_;
+
+	// Time flown and time left on the held controls
+	float time_;
+	float holdTimer_;
+	Controls held_;
+
+	// Measurement
+	float reportTimer_;
+	unsigned numUpdates_;
+	unsigned numSnapshots_;
+};
@@ -0,0 +1,446 @@
+// Include directives
+#include "EffectsBudget.h"
+#include <algorithm>
+
+// Ribbon trail vertex distance next to the camera
+static const float TRAIL_VERTEX_DISTANCE = 0.1f;
+
+// Radius used to test if a missile and its effects are on screen
+static const float EFFECTS_RADIUS = 2.0f;
+
+
+// Initialisation function - creates the emitter pool
+void EffectsBudget::Initialise(ResourceCache* cache, Scene* scene, int poolSize, CreateMode mode)
+{
+	// Start from an empty pool
+	Clear();
+
+	// Particle effect shared by all the emitters
+	ParticleEffect* effect = cache->GetResource<ParticleEffect>("Particle/Fire.xml");
+	if (!effect)
+		return;
+
+	// Node holding the unused emitters
+	poolNode_ = scene->CreateChild("EffectsPool", mode);
+
+	// Create the pooled emitters
+	for (int i = 0; i < poolSize; i++)
+	{
+		PooledEmitter pooled;
+		pooled.node_ = poolNode_->CreateChild("ParticleEmitter", mode);
+		pooled.emitter_ = pooled.node_->CreateComponent<ParticleEmitter>(mode);
+		pooled.emitter_->SetEffect(effect);
+		pooled.emitter_->SetNumParticles(MISSILE_PARTICLES);
+		pooled.emitter_->SetEmitting(false);
+		pooled.emitter_->SetEnabled(false);
+		pooled.owner_ = nullptr;
+		pooled.numParticles_ = MISSILE_PARTICLES;
+		pool_.push_back(pooled);
+	}
+}
+
+
+// Add a set of missiles to be managed
+void EffectsBudget::AddMissileSet(MissileSet* missileSet)
+{
+	missileSets_.push_back(missileSet);
+}
+
+
+// Remove a set of missiles, returning any emitters it holds
+void EffectsBudget::RemoveMissileSet(MissileSet* missileSet)
+{
+	// Take the emitters back from the missiles
+	for (auto& missile : missileSet->missileList)
+	{
+		for (auto& pooled : pool_)
+		{
+			if (pooled.owner_ == &missile)
+			{
+				missile.DetachEmitter(poolNode_);
+				pooled.owner_ = nullptr;
+			}
+		}
+	}
+
+	// Stop managing the set
+	missileSets_.erase(std::remove(missileSets_.begin(), missileSets_.end(), missileSet), missileSets_.end());
+}
+
+
+// Forget the pool and missile sets (the scene has been cleared)
+void EffectsBudget::Clear()
+{
+	pool_.clear();
+	missileSets_.clear();
+	candidates_.clear();
+	remoteEffects_.clear();
+	poolNode_ = nullptr;
+	liveParticles_ = 0;
+	trailSegments_ = 0;
+}
+
+
+// Update - called each frame after the missiles have moved
+void EffectsBudget::Update(Node* cameraNode)
+{
+	// Camera used for the distance and visibility tests (none when headless)
+	Camera* camera = cameraNode ? cameraNode->GetComponent<Camera>() : nullptr;
+	Vector3 cameraPosition = camera ? cameraNode->GetWorldPosition() : Vector3::ZERO;
+	Frustum frustum;
+	if (camera)
+		frustum = camera->GetFrustum();
+
+	// Collect the missiles in flight
+	candidates_.clear();
+	for (auto missileSet : missileSets_)
+	{
+		for (auto& missile : missileSet->missileList)
+		{
+			// Not in flight - give back its emitter
+			if (!missile.IsInFlight())
+			{
+				ReturnEmitter(&missile);
+				continue;
+			}
+
+			// Distance and visibility
+			Candidate candidate;
+			Vector3 position = missile.pNodeMissile->GetWorldPosition();
+			candidate.missile_ = &missile;
+			candidate.distance_ = camera ? (position - cameraPosition).Length() : 0.0f;
+			candidate.onScreen_ = !camera || frustum.IsInside(Sphere(position, EFFECTS_RADIUS)) != OUTSIDE;
+			candidates_.push_back(candidate);
+		}
+	}
+
+	// Nearest missiles first
+	std::sort(candidates_.begin(), candidates_.end(),
+		[](const Candidate& a, const Candidate& b) { return a.distance_ < b.distance_; });
+
+	// ------------------------------------ PARTICLE EMITTERS --------------------------------------
+	// The nearest on-screen missiles within the fade distance get an emitter
+	unsigned numEmitters = 0;
+	std::vector<bool> wantsEmitter(candidates_.size(), false);
+	for (unsigned i = 0; i < candidates_.size() && numEmitters < pool_.size(); i++)
+	{
+		if (candidates_[i].onScreen_ && candidates_[i].distance_ < EFFECTS_LOD_DISTANCE)
+		{
+			wantsEmitter[i] = true;
+			numEmitters++;
+		}
+	}
+
+	// Take the emitters back from missiles that dropped out
+	for (unsigned i = 0; i < candidates_.size(); i++)
+	{
+		if (!wantsEmitter[i])
+			ReturnEmitter(candidates_[i].missile_);
+	}
+
+	// Lend the free emitters and work out the particles wanted at each distance
+	int wantedParticles = 0;
+	for (unsigned i = 0; i < candidates_.size(); i++)
+	{
+		if (!wantsEmitter[i])
+			continue;
+
+		// Lend a free emitter
+		Missile* missile = candidates_[i].missile_;
+		if (!missile->HasEmitter())
+		{
+			for (auto& pooled : pool_)
+			{
+				if (!pooled.owner_)
+				{
+					pooled.owner_ = missile;
+					missile->AttachEmitter(pooled.node_, pooled.emitter_);
+					break;
+				}
+			}
+		}
+
+		// Particles fade out linearly to the fog end
+		wantedParticles += (int)(MISSILE_PARTICLES * (1.0f - candidates_[i].distance_ / EFFECTS_LOD_DISTANCE));
+	}
+
+	// Scale every emitter down if the total is over budget
+	float particleScale = 1.0f;
+	if (wantedParticles > maxParticles_)
+		particleScale = (float)maxParticles_ / (float)wantedParticles;
+
+	// Apply the particle counts - only resize the emitters on a change of at least 10 particles
+	liveParticles_ = 0;
+	for (auto& pooled : pool_)
+	{
+		if (!pooled.owner_)
+			continue;
+
+		// Particles for this distance
+		float distance = camera ? (pooled.owner_->pNodeMissile->GetWorldPosition() - cameraPosition).Length() : 0.0f;
+		float fade = Max(0.0f, 1.0f - distance / EFFECTS_LOD_DISTANCE);
+		int numParticles = Max(10, ((int)(MISSILE_PARTICLES * fade * particleScale) / 10) * 10);
+
+		// Resize the emitter
+		if (numParticles != pooled.numParticles_)
+		{
+			pooled.emitter_->SetNumParticles(numParticles);
+			pooled.numParticles_ = numParticles;
+		}
+		liveParticles_ += numParticles;
+	}
+
+	// --------------------------------------- RIBBON TRAILS ---------------------------------------
+	// Nearest trails first until the segment budget runs out, coarser with distance
+	trailSegments_ = 0;
+	for (auto& candidate : candidates_)
+	{
+		RibbonTrail* trail = candidate.missile_->GetTrail();
+
+		// Off screen - no trail
+		if (!candidate.onScreen_)
+		{
+			if (trail->IsEnabled())
+				trail->SetEnabled(false);
+			continue;
+		}
+
+		// Vertex distance grows with the camera distance
+		float vertexDistance = TRAIL_VERTEX_DISTANCE * (1.0f + 4.0f * candidate.distance_ / EFFECTS_LOD_DISTANCE);
+		int segments = TrailSegments(trail, vertexDistance);
+
+		// Over budget - no trail
+		if (trailSegments_ + segments > maxTrailSegments_)
+		{
+			if (trail->IsEnabled())
+				trail->SetEnabled(false);
+			continue;
+		}
+
+		// Enable the trail
+		if (!trail->IsEnabled())
+		{
+			trail->SetEnabled(true);
+			trail->SetEmitting(true);
+		}
+		if (Abs(trail->GetVertexDistance() - vertexDistance) > TRAIL_VERTEX_DISTANCE * 0.5f)
+			trail->SetVertexDistance(vertexDistance);
+		trailSegments_ += segments;
+	}
+}
+
+
+// Server: lend the emitters and hold the caps, without a camera
+void EffectsBudget::UpdatePool()
+{
+	// Emitters allowed - the particle cap is held by lending fewer, so the clients are free
+	// to fade the particles of each by their own cameras
+	unsigned maxEmitters = Min((unsigned)pool_.size(), (unsigned)Max(maxParticles_ / MISSILE_PARTICLES, 0));
+
+	// Collect the missiles in flight - the ones holding an emitter keep it while the cap allows
+	candidates_.clear();
+	unsigned numEmitters = 0;
+	for (auto missileSet : missileSets_)
+	{
+		for (auto& missile : missileSet->missileList)
+		{
+			// Not in flight - give back its emitter
+			if (!missile.IsInFlight())
+			{
+				ReturnEmitter(&missile);
+				continue;
+			}
+
+			// Keep the emitter, or give it back if over the cap
+			if (missile.HasEmitter())
+			{
+				if (numEmitters < maxEmitters)
+					numEmitters++;
+				else
+					ReturnEmitter(&missile);
+			}
+
+			Candidate candidate;
+			candidate.missile_ = &missile;
+			candidate.distance_ = 0.0f;
+			candidate.onScreen_ = true;
+			candidates_.push_back(candidate);
+		}
+	}
+
+	// Lend the free emitters to the missiles in flight without one, up to the cap
+	for (auto& candidate : candidates_)
+	{
+		if (numEmitters >= maxEmitters)
+			break;
+		if (candidate.missile_->HasEmitter())
+			continue;
+		for (auto& pooled : pool_)
+		{
+			if (!pooled.owner_)
+			{
+				pooled.owner_ = candidate.missile_;
+				candidate.missile_->AttachEmitter(pooled.node_, pooled.emitter_);
+				numEmitters++;
+				break;
+			}
+		}
+	}
+	liveParticles_ = numEmitters * MISSILE_PARTICLES;
+
+	// Trails in flight order until the segment budget runs out, at the finest vertex distance
+	// - the clients only ever make them coarser
+	trailSegments_ = 0;
+	for (auto& candidate : candidates_)
+	{
+		RibbonTrail* trail = candidate.missile_->GetTrail();
+		int segments = TrailSegments(trail, TRAIL_VERTEX_DISTANCE);
+
+		// Over budget - no trail
+		if (trailSegments_ + segments > maxTrailSegments_)
+		{
+			if (trail->IsEnabled())
+				trail->SetEnabled(false);
+			continue;
+		}
+
+		// Enable the trail
+		if (!trail->IsEnabled())
+		{
+			trail->SetEnabled(true);
+			trail->SetEmitting(true);
+		}
+		trailSegments_ += segments;
+	}
+}
+
+
+// Client: add a replicated emitter or trail to be faded by the client's camera
+void EffectsBudget::AddRemoteEffect(Drawable* effect)
+{
+	remoteEffects_.push_back(WeakPtr<Drawable>(effect));
+}
+
+
+// Client: fade the replicated emitters and trails by the camera
+void EffectsBudget::UpdateView(Node* cameraNode)
+{
+	// Camera used for the distance tests
+	Camera* camera = cameraNode ? cameraNode->GetComponent<Camera>() : nullptr;
+	if (!camera)
+		return;
+	Vector3 cameraPosition = cameraNode->GetWorldPosition();
+
+	liveParticles_ = 0;
+	trailSegments_ = 0;
+	for (unsigned i = 0; i < remoteEffects_.size();)
+	{
+		// Forget the effects that have gone
+		Drawable* effect = remoteEffects_[i];
+		if (!effect)
+		{
+			remoteEffects_[i] = remoteEffects_.back();
+			remoteEffects_.pop_back();
+			continue;
+		}
+		i++;
+
+		// Not lent to a missile, or no trail in flight - the server has switched it off
+		if (!effect->IsEnabledEffective())
+			continue;
+
+		// Fade by the camera distance - off-screen effects are culled and not updated anyway
+		float distance = (effect->GetNode()->GetWorldPosition() - cameraPosition).Length();
+		float fade = Max(0.0f, 1.0f - distance / EFFECTS_LOD_DISTANCE);
+
+		// Emitter - its particle count, which the server never changes
+		if (effect->GetType() == ParticleEmitter::GetTypeStatic())
+		{
+			ParticleEmitter* emitter = static_cast<ParticleEmitter*>(effect);
+			int numParticles = Max(10, ((int)(MISSILE_PARTICLES * fade) / 10) * 10);
+			if (numParticles != (int)emitter->GetNumParticles())
+				emitter->SetNumParticles(numParticles);
+			liveParticles_ += numParticles;
+		}
+
+		// Trail - coarser with distance and hidden past the fog end, through the vertex
+		// distance and view mask, which the server never changes
+		else
+		{
+			RibbonTrail* trail = static_cast<RibbonTrail*>(effect);
+			float vertexDistance = TRAIL_VERTEX_DISTANCE * (1.0f + 4.0f * Min(distance / EFFECTS_LOD_DISTANCE, 1.0f));
+			if (Abs(trail->GetVertexDistance() - vertexDistance) > TRAIL_VERTEX_DISTANCE * 0.5f)
+				trail->SetVertexDistance(vertexDistance);
+			unsigned viewMask = fade > 0.0f ? DEFAULT_VIEWMASK : 0;
+			if (trail->GetViewMask() != viewMask)
+				trail->SetViewMask(viewMask);
+			if (viewMask)
+				trailSegments_ += TrailSegments(trail, vertexDistance);
+		}
+	}
+}
+
+
+// Number of trail segments of a missile trail at a given vertex distance
+int EffectsBudget::TrailSegments(RibbonTrail* trail, float vertexDistance)
+{
+	return CeilToInt(trail->GetLifetime() * MISSILE_NETWORK_SPEED / vertexDistance);
+}
+
+
+// Take a missile's emitter back to the pool
+void EffectsBudget::ReturnEmitter(Missile* missile)
+{
+	// No emitter attached
+	if (!missile->HasEmitter())
+		return;
+
+	for (auto& pooled : pool_)
+	{
+		if (pooled.owner_ == missile)
+			pooled.owner_ = nullptr;
+	}
+	missile->DetachEmitter(poolNode_);
+}
+
+
+// Set the particle budget
+void EffectsBudget::SetMaxParticles(int maxParticles)
+{
+	maxParticles_ = maxParticles;
+}
+
+
+// Set the trail segment budget
+void EffectsBudget::SetMaxTrailSegments(int maxTrailSegments)
+{
+	maxTrailSegments_ = maxTrailSegments;
+}
+
+
+// Get the particle budget
+int EffectsBudget::GetMaxParticles()
+{
+	return maxParticles_;
+}
+
+
+// Get the trail segment budget
+int EffectsBudget::GetMaxTrailSegments()
+{
+	return maxTrailSegments_;
+}
+
+
+// Get the particles allowed on the last update
+int EffectsBudget::GetLiveParticles()
+{
+	return liveParticles_;
+}
+
+
+// Get the trail segments allowed on the last update
+int EffectsBudget::GetTrailSegments()
+{
+	return trailSegments_;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+// Include directives
+#include "MissileSet.h"
+
+// Default number of pooled particle emitters
+const int EMITTER_POOL_SIZE = 16;
+
+// Number of particles of an emitter next to the camera
+const int MISSILE_PARTICLES = 100;
+
+// Default cap on the live particles of all emitters
+const int MAX_LIVE_PARTICLES = 800;
+
+// Default cap on the ribbon trail segments of all missiles
+const int MAX_TRAIL_SEGMENTS = 2000;
+
+// Distance at which the missile effects have faded out (fog end)
+const float EFFECTS_LOD_DISTANCE = 250.0f;
+
+// Effects budget class
+// - Lends a fixed pool of particle emitters to the nearest on-screen missiles
+// - Scales the particles of each emitter by the camera distance
+// - Switches off the trails of off-screen missiles and caps the total trail segments
+// - In a network game the work is split: the server only lends the (replicated) emitters and
+//   holds the global caps, with no camera of its own, and each client fades the replicated
+//   emitters and trails by its own camera - it only changes attributes the server leaves alone
+class EffectsBudget
+{
+public:
+	// Constructor
+	EffectsBudget() :
+		poolNode_(nullptr),
+		maxParticles_(MAX_LIVE_PARTICLES),
+		maxTrailSegments_(MAX_TRAIL_SEGMENTS),
+		liveParticles_(0),
+		trailSegments_(0)
+	{}
+
+	// Initialisation function - creates the emitter pool
+	void Initialise(ResourceCache* cache, Scene* scene, int poolSize, CreateMode mode);
+
+	// Add a set of missiles to be managed
+	void AddMissileSet(MissileSet* missileSet);
+
+	// Remove a set of missiles, returning any emitters it holds
+	void RemoveMissileSet(MissileSet* missileSet);
+
+	// Forget the pool and missile sets (the scene has been cleared)
+	void Clear();
+
+	// Update - called each frame after the missiles have moved
+	void Update(Node* cameraNode);
+
+	// Server: lend the emitters and hold the caps, without a camera - called each frame after the missiles have moved
+	void UpdatePool();
+
+	// Client: add a replicated emitter or trail to be faded by the client's camera
+	void AddRemoteEffect(Drawable* effect);
+
+	// Client: fade the replicated emitters and trails by the camera - called each frame
+	void UpdateView(Node* cameraNode);
+
+	// Set the budgets
+	void SetMaxParticles(int maxParticles);
+	void SetMaxTrailSegments(int maxTrailSegments);
+
+	// Get the budgets
+	int GetMaxParticles();
+	int GetMaxTrailSegments();
+
+	// Get the particles and trail segments allowed on the last update
+	int GetLiveParticles();
+	int GetTrailSegments();
+
+private:
+	// A pooled emitter
+	struct PooledEmitter
+	{
+		Node* node_;
+		ParticleEmitter* emitter_;
+		Missile* owner_;
+		int numParticles_;
+	};
+
+	// A missile in flight considered for effects
+	struct Candidate
+	{
+		Missile* missile_;
+		float distance_;
+		bool onScreen_;
+	};
+
+	// Number of trail segments of a missile trail at a given vertex distance
+	int TrailSegments(RibbonTrail* trail, float vertexDistance);
+
+	// Take a missile's emitter back to the pool
+	void ReturnEmitter(Missile* missile);
+
+	// Pool of emitters and the node holding the unused ones
+	std::vector<PooledEmitter> pool_;
+	Node* poolNode_;
+
+	// The managed missile sets
+	std::vector<MissileSet*> missileSets_;
+
+	// Missiles considered this frame
+	std::vector<Candidate> candidates_;
+
+	// Client: the replicated emitters and trails
+	std::vector<WeakPtr<Drawable> > remoteEffects_;
+
+	// Budgets
+	int maxParticles_;
+	int maxTrailSegments_;
+
+	// Usage on the last update
+	int liveParticles_;
+	int trailSegments_;
+};
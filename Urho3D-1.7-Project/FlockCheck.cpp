@@ -0,0 +1,282 @@
+// Include directives
+#include "FlockCheck.h"
+#include "BoidPrefab.h"
+#include "FlockRenderer.h"
+
+
+// Run the check on a flock created in the scene - true if it stays within the bounds (the
+// exact kernel) or stays a number (with shortcuts)
+bool FlockCheck::Run(ResourceCache* cache, Scene* scene, int numBoids, bool copy, bool limit, bool halfUpdate, int ticks)
+{
+	// The flock as built, moved in lockstep
+	BoidPrefab prefab;
+	prefab.Initialise(cache, scene, LOCAL);
+	BoidSet set;
+	FlockRandom random(FLOCK_CHECK_SEED);
+	set.Initialise(prefab, numBoids, random.Split(0), copy, limit, halfUpdate);
+	set.SetLockstep(true);
+
+	// Same seeded state for the flock and the reference
+	FlockRandom state = random.Split(1);
+	std::vector<Vector3> positions(numBoids);
+	std::vector<Vector3> velocities(numBoids);
+	for (int i = 0; i < numBoids; i++)
+	{
+		positions[i] = Vector3(state.Next(50.0f) - 25.0f, state.Next(50.0f) - 25.0f, state.Next(50.0f) - 25.0f);
+		velocities[i] = Vector3(state.Next(2.0f) - 1.0f, state.Next(2.0f) - 1.0f, state.Next(2.0f) - 1.0f) * 5.0f;
+		set.boidList[i].SetState(positions[i], velocities[i]);
+		set.boidList[i].force_ = Vector3::ZERO;
+	}
+
+	// Forget earlier results - the bounds hold for the exact kernel only
+	exact_ = !copy && !limit && !halfUpdate;
+	maxForceError_ = 0.0f;
+	maxDrift_ = 0.0f;
+	numForceFailures_ = 0;
+	firstFailedTick_ = -1;
+
+	// Flock state the kernel sees, and its forces before the check
+	std::vector<Vector3> livePositions(numBoids);
+	std::vector<Vector3> liveVelocities(numBoids);
+	std::vector<Vector3> savedForces(numBoids);
+
+	for (int tick = 0; tick < ticks; tick++)
+	{
+		bool failed = false;
+
+		// The kernel's force on each boid against the reference force for the same state
+		for (int i = 0; i < numBoids; i++)
+		{
+			livePositions[i] = set.boidList[i].GetPosition();
+			liveVelocities[i] = set.boidList[i].GetVelocity();
+			savedForces[i] = set.boidList[i].force_;
+		}
+		for (int i = 0; i < numBoids; i++)
+		{
+			// Kernel
+			Boid& boid = set.boidList[i];
+			boid.ComputeForce(&set.boidList[0], set.counters_);
+
+			// Reference
+			Vector3 expected = ReferenceForce(livePositions, liveVelocities, i, boid.forceStrength_);
+			float error = (boid.force_ - expected).Length() / Max(expected.Length(), 1.0f);
+			maxForceError_ = Max(maxForceError_, error);
+			if (boid.force_.IsNaN() || (exact_ && error > FLOCK_CHECK_FORCE_TOLERANCE))
+			{
+				numForceFailures_++;
+				failed = true;
+			}
+		}
+
+		// Put the forces back, so the step copies what it would have copied
+		for (int i = 0; i < numBoids; i++)
+			set.boidList[i].force_ = savedForces[i];
+
+		// Step the flock as the game does
+		set.Update(FLOCK_CHECK_STEP);
+
+		// Step the reference flock - each boid moves before the next one's force is found, as in the game
+		for (int i = 0; i < numBoids; i++)
+		{
+			Vector3 force = ReferenceForce(positions, velocities, i, set.boidList[i].forceStrength_);
+			ReferenceMove(set.boidList[i], positions[i], velocities[i], force, FLOCK_CHECK_STEP);
+		}
+
+		// Drift between the flocks
+		for (int i = 0; i < numBoids; i++)
+		{
+			float drift = (set.boidList[i].GetPosition() - positions[i]).Length();
+			maxDrift_ = Max(maxDrift_, drift);
+			if (set.boidList[i].GetPosition().IsNaN() || (exact_ && drift > FLOCK_CHECK_DRIFT))
+				failed = true;
+		}
+
+		// First tick out of bounds
+		if (failed && firstFailedTick_ < 0)
+			firstFailedTick_ = tick;
+	}
+
+	// Remove the checked boids
+	for (auto& boid : set.boidList)
+		boid.pNode->Remove();
+
+	return firstFailedTick_ < 0;
+}
+
+
+// Run the instancing check on flocks created in the scene - true if the batches don't grow with the flock
+bool FlockCheck::RunInstancing(ResourceCache* cache, Scene* scene)
+{
+	BoidPrefab prefab;
+	prefab.Initialise(cache, scene, LOCAL);
+
+	bool passed = true;
+	for (int size = 0; size < NUM_FLOCK_CHECK_INSTANCING_SIZES; size++)
+	{
+		// An instanced flock of the size, drawn from its state
+		int numBoids = FLOCK_CHECK_INSTANCING_SIZES[size];
+		BoidSet set;
+		FlockRandom random(FLOCK_CHECK_SEED);
+		set.Initialise(prefab, numBoids, random.Split(0), true, true, true);
+		set.EnableInstancing(cache, scene);
+		set.SyncState();
+		set.UpdateRenderers();
+
+		// Every boid drawn, by the same batches as the first flock
+		unsigned numInstances = 0;
+		for (int type = 0; type < NUM_BOID_MODELS; type++)
+			numInstances += set.renderers_[type]->GetNumInstances();
+		instancingBatches_[size] = CountBatches(set);
+		if (numInstances != (unsigned)numBoids || instancingBatches_[size] != instancingBatches_[0])
+			passed = false;
+
+		// Remove the checked boids and their renderers
+		for (auto& boid : set.boidList)
+			boid.pNode->Remove();
+		set.renderers_[0]->GetNode()->Remove();
+	}
+
+	return passed;
+}
+
+
+// Were the bounds checked - false when the errors of a shortcut were only reported
+bool FlockCheck::IsExact()
+{
+	return exact_;
+}
+
+
+// Largest relative force error found
+float FlockCheck::GetMaxForceError()
+{
+	return maxForceError_;
+}
+
+
+// Furthest drift from the reference flock
+float FlockCheck::GetMaxDrift()
+{
+	return maxDrift_;
+}
+
+
+// Number of forces out of bounds
+unsigned FlockCheck::GetNumForceFailures()
+{
+	return numForceFailures_;
+}
+
+
+// First tick out of bounds, -1 if none
+int FlockCheck::GetFirstFailedTick()
+{
+	return firstFailedTick_;
+}
+
+
+// Batches drawing each flock size in the instancing check
+unsigned FlockCheck::GetInstancingBatches(int size)
+{
+	return instancingBatches_[size];
+}
+
+
+// Batches the set would be drawn with - its enabled renderers' and boid models'
+unsigned FlockCheck::CountBatches(BoidSet& set)
+{
+	unsigned batches = 0;
+	for (int type = 0; type < NUM_BOID_MODELS; type++)
+	{
+		if (set.renderers_[type] && set.renderers_[type]->IsEnabledEffective())
+			batches += set.renderers_[type]->GetBatches().Size();
+	}
+	for (auto& boid : set.boidList)
+	{
+		if (boid.pObject->IsEnabledEffective())
+			batches += boid.pObject->GetBatches().Size();
+	}
+	return batches;
+}
+
+
+// Reference force on a boid - every neighbour, no shortcuts
+Vector3 FlockCheck::ReferenceForce(const std::vector<Vector3>& positions, const std::vector<Vector3>& velocities,
+	int index, float forceStrength)
+{
+	const Vector3& position = positions[index];
+	const Vector3& velocity = velocities[index];
+
+	// Sums over the neighbours in range of each rule
+	Vector3 centreOfMass;
+	Vector3 direction;
+	Vector3 separationForce;
+	int numCohesion = 0;
+	int numAlignment = 0;
+	int numSeparation = 0;
+	for (unsigned i = 0; i < positions.size(); i++)
+	{
+		if ((int)i == index)
+			continue;
+
+		Vector3 separation = position - positions[i];
+		float distance = separation.LengthSquared();
+		if (distance < Boid::CohesionForce_Range)
+		{
+			centreOfMass += positions[i];
+			numCohesion++;
+		}
+		if (distance < Boid::AlignmentForce_Range)
+		{
+			direction += velocities[i];
+			numAlignment++;
+		}
+		if (distance < Boid::SeperationForce_Range)
+		{
+			separationForce += separation / separation.Length();
+			numSeparation++;
+		}
+	}
+
+	// Alignment - steer towards the average heading
+	Vector3 alignmentForce;
+	if (numAlignment > 0)
+	{
+		direction /= numAlignment;
+		alignmentForce += (direction - velocity) * Boid::AlignmentForce_Factor;
+	}
+
+	// Separation - steer away from close neighbours
+	if (numSeparation > 0)
+		separationForce *= Boid::SeperationForce_Factor;
+
+	// Cohesion - steer towards the centre of mass; a boid without cohesion neighbours has no force
+	if (numCohesion == 0)
+		return Vector3::ZERO;
+	centreOfMass /= numCohesion;
+	Vector3 desiredVelocity = (centreOfMass - position).Normalized() * Boid::CohesionForce_VMax;
+	Vector3 cohesionForce;
+	cohesionForce += (desiredVelocity - velocity) * Boid::CohesionForce_Factor;
+
+	// Plus the pull to the centre of the world
+	return separationForce + alignmentForce + cohesionForce + (Vector3::ZERO - position) / forceStrength;
+}
+
+
+// Move a reference boid as the lockstep integration does
+void FlockCheck::ReferenceMove(const Boid& boid, Vector3& position, Vector3& velocity, const Vector3& force, float timeStep)
+{
+	// Apply the force (unit mass) and clamp the speed
+	velocity += force * timeStep;
+	float speed = velocity.Length();
+	if (speed < boid.minSpeed_)
+		velocity = velocity.Normalized() * boid.minSpeed_;
+	else if (speed > boid.maxSpeed_)
+		velocity = velocity.Normalized() * boid.maxSpeed_;
+
+	// Move and keep inside the world
+	position += velocity * timeStep;
+	position.x_ = Clamp(position.x_, -boid.worldSize_, boid.worldSize_);
+	position.y_ = Clamp(position.y_, -boid.worldSize_, boid.worldSize_);
+	position.z_ = Clamp(position.z_, -boid.worldSize_, boid.worldSize_);
+}
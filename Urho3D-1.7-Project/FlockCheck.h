@@ -0,0 +1,88 @@
+#pragma once
+
+// Include directives
+#include <vector>
+#include "BoidSet.h"
+
+// Seed of the starting state of the checked flock
+const unsigned FLOCK_CHECK_SEED = 12345;
+
+// Default number of boids and ticks checked, and the tick (seconds)
+const int FLOCK_CHECK_BOIDS = 100;
+const int FLOCK_CHECK_TICKS = 600;
+const float FLOCK_CHECK_STEP = 1.0f / 60.0f;
+
+// Largest force error allowed, relative to the reference force (or to 1 for a smaller force)
+const float FLOCK_CHECK_FORCE_TOLERANCE = 1.0e-3f;
+
+// Furthest a boid may drift from the reference flock (units)
+const float FLOCK_CHECK_DRIFT = 0.05f;
+
+// Sizes of the instanced flocks whose batches are counted
+const int FLOCK_CHECK_INSTANCING_SIZES[] = { 10, 100, 1000 };
+const int NUM_FLOCK_CHECK_INSTANCING_SIZES = 3;
+
+// Flock check class
+// - Runs the flock kernel as it is built and flagged (copy range, neighbour limit, half
+//   update) side by side with a plain O(N^2) implementation of the same cohesion, alignment
+//   and separation rules, both from the same seeded state
+// - Each tick every boid's force is compared with the reference force for the same state,
+//   and the flock is compared with a reference flock moved by the reference forces
+// - Boids are moved with the lockstep integration, which is deterministic and needs no physics
+// - The exact kernel (no shortcuts) passes if the force error and the drift stay within the
+//   bounds for every tick
+// - Each shortcut changes the result on purpose - the copy range hands on a neighbour's force,
+//   the neighbour limit stops counting early and the half update moves half the flock a tick -
+//   so with any of them the errors are only reported, and the run fails only if a boid's
+//   state stops being a number
+// - The instancing check builds instanced flocks of several sizes and passes if they are
+//   drawn with the same number of batches, holding every boid between them
+class FlockCheck
+{
+public:
+	// Constructor
+	FlockCheck() :
+		exact_(true),
+		maxForceError_(0.0f),
+		maxDrift_(0.0f),
+		numForceFailures_(0),
+		firstFailedTick_(-1),
+		instancingBatches_()
+	{}
+
+	// Run the check on a flock created in the scene - true if it stays within the bounds (the
+	// exact kernel) or stays a number (with shortcuts)
+	bool Run(ResourceCache* cache, Scene* scene, int numBoids, bool copy, bool limit, bool halfUpdate, int ticks);
+
+	// Run the instancing check on flocks created in the scene - true if the batches don't grow with the flock
+	bool RunInstancing(ResourceCache* cache, Scene* scene);
+
+	// Results - whether the bounds were checked, or the errors only reported
+	bool IsExact();
+	float GetMaxForceError();
+	float GetMaxDrift();
+	unsigned GetNumForceFailures();
+	int GetFirstFailedTick();
+
+	// Instancing results - the batches drawing each flock size
+	unsigned GetInstancingBatches(int size);
+
+private:
+	// Reference force on a boid - every neighbour, no shortcuts
+	static Vector3 ReferenceForce(const std::vector<Vector3>& positions, const std::vector<Vector3>& velocities,
+		int index, float forceStrength);
+
+	// Move a reference boid as the lockstep integration does
+	static void ReferenceMove(const Boid& boid, Vector3& position, Vector3& velocity, const Vector3& force, float timeStep);
+
+	// Batches the set would be drawn with - its enabled renderers' and boid models'
+	static unsigned CountBatches(BoidSet& set);
+
+	// Results
+	bool exact_;
+	float maxForceError_;
+	float maxDrift_;
+	unsigned numForceFailures_;
+	int firstFailedTick_;
+	unsigned instancingBatches_[NUM_FLOCK_CHECK_INSTANCING_SIZES];
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+// Counters of the flock kernel - how often its shortcuts fire
+// - Counted only when built with FLOCK_COUNTERS (the CMake option of the same name), otherwise
+//   FLOCK_COUNT compiles to nothing
+// - Each boid set counts into its own counters, so a set run on a worker thread needs no locking
+struct FlockCounters
+{
+	// Boids whose force was computed
+	unsigned boids_ = 0;
+
+	// Forces copied from a boid inside Copy_Range
+	unsigned copies_ = 0;
+
+	// Neighbours looked at, and accepted into each force
+	unsigned visited_ = 0;
+	unsigned cohesion_ = 0;
+	unsigned alignment_ = 0;
+	unsigned separation_ = 0;
+
+	// Searches ended early by the neighbour limit
+	unsigned limitBreaks_ = 0;
+
+	// Start counting again
+	void Reset() { *this = FlockCounters(); }
+};
+
+// Count an event of the flock kernel
+#ifdef FLOCK_COUNTERS
+#define FLOCK_COUNT(counters, counter) (++(counters).counter)
+#else
+#define FLOCK_COUNT(counters, counter) ((void)(counters))
+#endif
@@ -0,0 +1,549 @@
+// Include directives
+#include <Urho3D/Network/Network.h>
+#include "FlockLockstep.h"
+
+// Parameter flags
+static const unsigned char LOCKSTEP_GROUPS = 1;
+static const unsigned char LOCKSTEP_COPY = 2;
+static const unsigned char LOCKSTEP_LIMIT = 4;
+static const unsigned char LOCKSTEP_HALF_UPDATE = 8;
+
+
+// Initialise the server side
+void FlockLockstep::InitialiseServer(const LockstepParameters& parameters)
+{
+	// The server runs from its first tick
+	Clear();
+	server_ = true;
+	started_ = true;
+	parameters_ = parameters;
+}
+
+
+// Initialise the client side - waits for the server's state
+void FlockLockstep::InitialiseClient()
+{
+	Clear();
+	server_ = false;
+}
+
+
+// Add a set of boids to be run in lockstep
+void FlockLockstep::AddBoidSet(BoidSet* boidSet)
+{
+	sets_.push_back(boidSet);
+}
+
+
+// Forget the boid sets and any pending state
+void FlockLockstep::Clear()
+{
+	// Flock state
+	started_ = false;
+	startPending_ = false;
+	resyncPending_ = false;
+	skipTick_ = false;
+	sets_.clear();
+	tick_ = 0;
+	stateTick_ = 0;
+	sentTick_ = 0;
+
+	// Messages and events
+	pendingState_.Clear();
+	events_.clear();
+	joined_.Clear();
+	lastServerTick_ = 0;
+	serverConnection_ = nullptr;
+
+	// Checksums
+	checksumPending_ = false;
+	checksumTick_ = 0;
+	checksum_ = 0;
+	for (unsigned i = 0; i < LOCKSTEP_CHECKSUM_HISTORY; i++)
+		clientChecksumTicks_[i] = 0;
+	pendingChecksums_.clear();
+}
+
+
+// Run the flock for a physics step - called from the physics pre-step
+void FlockLockstep::Step()
+{
+	// Not running
+	if (!started_)
+		return;
+
+	// Server - run one tick and take the checksum when due
+	if (server_)
+	{
+		RunTick();
+		if (tick_ % LOCKSTEP_CHECKSUM_TICKS == 0)
+		{
+			checksumTick_ = tick_;
+			checksum_ = Checksum();
+			checksumPending_ = true;
+		}
+		return;
+	}
+
+	// Client - stay a few ticks behind the server, catch up when far behind,
+	// slow down when close, and never run a tick the server has not reported
+	unsigned lag = lastServerTick_ > tick_ ? lastServerTick_ - tick_ : 0;
+	unsigned ticks = 0;
+	if (lag > 2 * LOCKSTEP_DELAY_TICKS)
+		ticks = Min(lag - LOCKSTEP_DELAY_TICKS, LOCKSTEP_MAX_CATCHUP);
+	else if (lag >= LOCKSTEP_DELAY_TICKS)
+		ticks = 1;
+	else if (lag > 0)
+	{
+		skipTick_ = !skipTick_;
+		ticks = skipTick_ ? 0 : 1;
+	}
+
+	// Run the ticks
+	for (unsigned i = 0; i < ticks; i++)
+	{
+		// Apply the events for this tick - they arrive in tick order
+		unsigned applied = 0;
+		while (applied < events_.size() && events_[applied].tick_ <= tick_)
+			ApplyEvent(events_[applied++]);
+		events_.erase(events_.begin(), events_.begin() + applied);
+
+		// Run the tick
+		RunTick();
+
+		// Keep the checksum to compare with the server's
+		if (tick_ % LOCKSTEP_CHECKSUM_TICKS == 0)
+		{
+			unsigned slot = (tick_ / LOCKSTEP_CHECKSUM_TICKS) % LOCKSTEP_CHECKSUM_HISTORY;
+			clientChecksumTicks_[slot] = tick_;
+			clientChecksums_[slot] = Checksum();
+
+			// Compare with a server checksum that arrived early
+			for (unsigned j = 0; j < pendingChecksums_.size(); j++)
+			{
+				if (pendingChecksums_[j].first == tick_)
+					CompareChecksum(serverConnection_, pendingChecksums_[j].first, pendingChecksums_[j].second);
+			}
+		}
+
+		// Forget the server checksums that have been passed
+		for (unsigned j = 0; j < pendingChecksums_.size();)
+		{
+			if (pendingChecksums_[j].first <= tick_)
+				pendingChecksums_.erase(pendingChecksums_.begin() + j);
+			else
+				j++;
+		}
+	}
+}
+
+
+// Send the tick, events and checksum to the clients - called each frame (server)
+void FlockLockstep::Update(Scene* scene)
+{
+	// Only the server sends, and only when there is something new
+	if (!server_ || !started_ || (tick_ == sentTick_ && events_.empty()))
+		return;
+
+	// Tick message - the tick, the events since the last message and the checksum when taken
+	VectorBuffer message;
+	message.WriteUInt(tick_);
+	message.WriteVLE(events_.size());
+	for (auto& event : events_)
+	{
+		message.WriteUInt(event.tick_);
+		message.WriteVLE(event.index_);
+		message.WriteUByte(event.type_);
+	}
+	message.WriteBool(checksumPending_);
+	if (checksumPending_)
+	{
+		message.WriteUInt(checksumTick_);
+		message.WriteUInt(checksum_);
+	}
+
+	// Send to each client - new clients are sent the exact state first
+	VectorBuffer state;
+	const Vector<SharedPtr<Connection> >& connections = scene->GetSubsystem<Network>()->GetClientConnections();
+	for (unsigned i = 0; i < connections.Size(); ++i)
+	{
+		// Client still loading the scene
+		Connection* connection = connections[i];
+		if (!connection->IsSceneLoaded())
+			continue;
+
+		// Joining or resyncing client
+		if (!joined_.Contains(connection))
+		{
+			if (state.GetSize() == 0)
+				WriteState(state);
+			connection->SendMessage(MSG_LOCKSTEPSTATE, true, true, state);
+			joined_.Insert(connection);
+		}
+
+		// Reliable and in order, so the events of a tick always arrive before a later tick number
+		connection->SendMessage(MSG_LOCKSTEPTICK, true, true, message);
+	}
+
+	// Sent
+	events_.clear();
+	checksumPending_ = false;
+	sentTick_ = tick_;
+}
+
+
+// Handle a network message, returns true if it belonged to the lockstep channel
+bool FlockLockstep::HandleMessage(Connection* connection, int msgID, MemoryBuffer& message)
+{
+	// Parameters and exact state from the server
+	if (msgID == MSG_LOCKSTEPSTATE)
+	{
+		// Only a client takes the state
+		if (server_)
+			return true;
+		serverConnection_ = connection;
+
+		// Parameters
+		parameters_.seed_ = message.ReadUInt();
+		parameters_.numbOfBoids_ = message.ReadInt();
+		unsigned char flags = message.ReadUByte();
+		parameters_.useGroups_ = (flags & LOCKSTEP_GROUPS) != 0;
+		parameters_.copy_ = (flags & LOCKSTEP_COPY) != 0;
+		parameters_.limit_ = (flags & LOCKSTEP_LIMIT) != 0;
+		parameters_.halfUpdate_ = (flags & LOCKSTEP_HALF_UPDATE) != 0;
+		parameters_.tickStep_ = message.ReadFloat();
+		stateTick_ = message.ReadUInt();
+
+		// Apply a resync straight away
+		if (started_)
+			ReadState(message);
+
+		// Keep the first state until the boid sets have been built
+		else
+		{
+			pendingState_.Clear();
+			pendingState_.Write(message.GetData() + message.GetPosition(), message.GetSize() - message.GetPosition());
+			startPending_ = true;
+		}
+		return true;
+	}
+
+	// Tick, events and checksum from the server
+	if (msgID == MSG_LOCKSTEPTICK)
+	{
+		// Only a client that has the state uses them
+		if (server_ || (!started_ && !startPending_))
+			return true;
+
+		// Events
+		unsigned serverTick = message.ReadUInt();
+		unsigned numEvents = message.ReadVLE();
+		for (unsigned i = 0; i < numEvents; i++)
+		{
+			Event event;
+			event.tick_ = message.ReadUInt();
+			event.index_ = message.ReadVLE();
+			event.type_ = message.ReadUByte();
+
+			// Already part of the last state
+			if (event.tick_ < stateTick_)
+				continue;
+
+			// Arrived after its tick was run - the flock has diverged
+			if (started_ && event.tick_ < tick_)
+				RequestResync(connection);
+			else
+				events_.push_back(event);
+		}
+
+		// Checksum
+		if (message.ReadBool())
+		{
+			unsigned checksumTick = message.ReadUInt();
+			unsigned checksum = message.ReadUInt();
+			CompareChecksum(connection, checksumTick, checksum);
+		}
+
+		// The client may now run up to this tick
+		lastServerTick_ = Max(lastServerTick_, serverTick);
+		return true;
+	}
+
+	// Client asking for the exact state again
+	if (msgID == MSG_LOCKSTEPRESYNC)
+	{
+		if (server_)
+		{
+			URHO3D_LOGWARNINGF("Lockstep client diverged at tick %u, resending the flock state", message.ReadUInt());
+			joined_.Erase(connection);
+		}
+		return true;
+	}
+
+	// Not a lockstep message
+	return false;
+}
+
+
+// Record a boid killed by the server
+void FlockLockstep::RecordKill(Node* node)
+{
+	RecordEvent(node, LOCKSTEP_EVENT_KILL);
+}
+
+
+// Record a boid brought back by the server
+void FlockLockstep::RecordSpawn(Node* node)
+{
+	RecordEvent(node, LOCKSTEP_EVENT_SPAWN);
+}
+
+
+// Forget a client that has disconnected (server)
+void FlockLockstep::RemoveConnection(Connection* connection)
+{
+	joined_.Erase(connection);
+}
+
+
+// Client has received the parameters and is waiting for its boid sets to be built
+bool FlockLockstep::IsStartPending()
+{
+	return startPending_;
+}
+
+
+// Parameters of the flock being run
+const LockstepParameters& FlockLockstep::GetParameters()
+{
+	return parameters_;
+}
+
+
+// Apply the server's state once the boid sets have been built (client)
+void FlockLockstep::StartClient()
+{
+	// Nothing received
+	if (!startPending_)
+		return;
+
+	// Apply the state
+	MemoryBuffer state(pendingState_.GetData(), pendingState_.GetSize());
+	startPending_ = false;
+	started_ = ReadState(state);
+	pendingState_.Clear();
+}
+
+
+// Is the flock running
+bool FlockLockstep::IsStarted()
+{
+	return started_;
+}
+
+
+// Number of ticks run
+unsigned FlockLockstep::GetTick()
+{
+	return tick_;
+}
+
+
+// Run a single tick of every boid set
+void FlockLockstep::RunTick()
+{
+	for (auto boidSet : sets_)
+		boidSet->Update(parameters_.tickStep_);
+	tick_++;
+}
+
+
+// Apply an event to a boid
+void FlockLockstep::ApplyEvent(const Event& event)
+{
+	// Find the set holding the boid
+	unsigned index = event.index_;
+	for (auto boidSet : sets_)
+	{
+		// In a later set
+		if (index >= (unsigned)boidSet->numberOfBoids_)
+		{
+			index -= boidSet->numberOfBoids_;
+			continue;
+		}
+
+		// Kill or bring back the boid
+		boidSet->boidList[index].pNode->SetEnabled(event.type_ == LOCKSTEP_EVENT_SPAWN);
+		return;
+	}
+}
+
+
+// Record an event for a boid node (server)
+void FlockLockstep::RecordEvent(Node* node, unsigned char type)
+{
+	// Only the server records events
+	if (!server_ || !started_)
+		return;
+
+	// Find the boid's index across the sets
+	unsigned index = 0;
+	for (auto boidSet : sets_)
+	{
+		for (int i = 0; i < boidSet->numberOfBoids_; i++, index++)
+		{
+			// The event applies before the next tick is run
+			if (boidSet->boidList[i].pNode == node)
+			{
+				Event event;
+				event.tick_ = tick_;
+				event.index_ = index;
+				event.type_ = type;
+				events_.push_back(event);
+				return;
+			}
+		}
+	}
+}
+
+
+// Checksum of the flock state - FNV-1a over the exact positions, velocities and alive flags
+unsigned FlockLockstep::Checksum()
+{
+	unsigned hash = 2166136261u;
+	for (auto boidSet : sets_)
+	{
+		for (auto& boid : boidSet->boidList)
+		{
+			// Exact state of the boid
+			float values[6];
+			Vector3 position = boid.GetPosition();
+			Vector3 velocity = boid.GetVelocity();
+			values[0] = position.x_;
+			values[1] = position.y_;
+			values[2] = position.z_;
+			values[3] = velocity.x_;
+			values[4] = velocity.y_;
+			values[5] = velocity.z_;
+
+			// Hash the bytes
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+			for (unsigned i = 0; i < sizeof(values); i++)
+				hash = (hash ^ bytes[i]) * 16777619u;
+			hash = (hash ^ (boid.pNode->IsEnabled() ? 1u : 0u)) * 16777619u;
+		}
+	}
+	return hash;
+}
+
+
+// Write the parameters and the exact flock state (server)
+void FlockLockstep::WriteState(VectorBuffer& message)
+{
+	// Parameters
+	unsigned char flags = 0;
+	if (parameters_.useGroups_) flags |= LOCKSTEP_GROUPS;
+	if (parameters_.copy_) flags |= LOCKSTEP_COPY;
+	if (parameters_.limit_) flags |= LOCKSTEP_LIMIT;
+	if (parameters_.halfUpdate_) flags |= LOCKSTEP_HALF_UPDATE;
+	message.WriteUInt(parameters_.seed_);
+	message.WriteInt(parameters_.numbOfBoids_);
+	message.WriteUByte(flags);
+	message.WriteFloat(parameters_.tickStep_);
+	message.WriteUInt(tick_);
+
+	// Each set, then each boid - the steering force is sent because boids copy their neighbours'
+	message.WriteVLE(sets_.size());
+	for (auto boidSet : sets_)
+	{
+		message.WriteUByte((unsigned char)boidSet->updatePhase_);
+		message.WriteVLE(boidSet->numberOfBoids_);
+		for (auto& boid : boidSet->boidList)
+		{
+			message.WriteVector3(boid.GetPosition());
+			message.WriteVector3(boid.GetVelocity());
+			message.WriteVector3(boid.force_);
+			message.WriteBool(boid.pNode->IsEnabled());
+		}
+	}
+}
+
+
+// Read the exact flock state that follows the parameters and tick (client)
+bool FlockLockstep::ReadState(MemoryBuffer& message)
+{
+	// The sets must match the server's
+	unsigned numSets = message.ReadVLE();
+	if (numSets != sets_.size())
+	{
+		URHO3D_LOGERRORF("Lockstep state has %u boid sets, expected %u", numSets, (unsigned)sets_.size());
+		return false;
+	}
+
+	// Each set, then each boid
+	for (auto boidSet : sets_)
+	{
+		boidSet->updatePhase_ = message.ReadUByte();
+		unsigned numBoids = message.ReadVLE();
+		if (numBoids != (unsigned)boidSet->numberOfBoids_)
+		{
+			URHO3D_LOGERRORF("Lockstep state has %u boids in a set, expected %d", numBoids, boidSet->numberOfBoids_);
+			return false;
+		}
+		for (auto& boid : boidSet->boidList)
+		{
+			Vector3 position = message.ReadVector3();
+			Vector3 velocity = message.ReadVector3();
+			boid.SetState(position, velocity);
+			boid.force_ = message.ReadVector3();
+			boid.pNode->SetEnabled(message.ReadBool());
+		}
+	}
+
+	// Continue from the server's tick - events before it are part of the state
+	tick_ = stateTick_;
+	lastServerTick_ = Max(lastServerTick_, tick_);
+	unsigned stale = 0;
+	while (stale < events_.size() && events_[stale].tick_ < tick_)
+		stale++;
+	events_.erase(events_.begin(), events_.begin() + stale);
+
+	// Checksums from before the state no longer apply
+	for (unsigned i = 0; i < LOCKSTEP_CHECKSUM_HISTORY; i++)
+		clientChecksumTicks_[i] = 0;
+	resyncPending_ = false;
+	return true;
+}
+
+
+// Compare a server checksum with the client's own (client)
+void FlockLockstep::CompareChecksum(Connection* connection, unsigned tick, unsigned checksum)
+{
+	// Not run that far yet - compare when the tick is reached
+	if (!started_ || tick > tick_)
+	{
+		pendingChecksums_.push_back(std::make_pair(tick, checksum));
+		return;
+	}
+
+	// Compare with the client's checksum of that tick, if still held
+	unsigned slot = (tick / LOCKSTEP_CHECKSUM_TICKS) % LOCKSTEP_CHECKSUM_HISTORY;
+	if (clientChecksumTicks_[slot] == tick && clientChecksums_[slot] != checksum)
+		RequestResync(connection);
+}
+
+
+// Ask the server for its exact state (client)
+void FlockLockstep::RequestResync(Connection* connection)
+{
+	// Already asked
+	if (resyncPending_ || !connection)
+		return;
+
+	// Ask for the state
+	URHO3D_LOGWARNINGF("Lockstep flock diverged at tick %u, asking the server to resync", tick_);
+	VectorBuffer message;
+	message.WriteUInt(tick_);
+	connection->SendMessage(MSG_LOCKSTEPRESYNC, true, true, message);
+	resyncPending_ = true;
+}
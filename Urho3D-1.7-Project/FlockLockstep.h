@@ -0,0 +1,191 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Network/Connection.h>
+#include "BoidSet.h"
+
+// Network message IDs of the lockstep channel
+const int MSG_LOCKSTEPSTATE = 0x62;
+const int MSG_LOCKSTEPTICK = 0x63;
+const int MSG_LOCKSTEPRESYNC = 0x64;
+
+// Ticks between flock checksums
+const unsigned LOCKSTEP_CHECKSUM_TICKS = 60;
+
+// Ticks a client tries to stay behind the server
+const unsigned LOCKSTEP_DELAY_TICKS = 6;
+
+// Most ticks a client runs in one physics step when catching up
+const unsigned LOCKSTEP_MAX_CATCHUP = 4;
+
+// Number of client checksums kept to compare with the server's
+const unsigned LOCKSTEP_CHECKSUM_HISTORY = 8;
+
+// Lockstep flock events
+enum LockstepEventType
+{
+	LOCKSTEP_EVENT_KILL = 0,
+	LOCKSTEP_EVENT_SPAWN
+};
+
+// Everything a client needs to build the same boid sets as the server
+struct LockstepParameters
+{
+	unsigned seed_ = 0;
+	int numbOfBoids_ = 0;
+	bool useGroups_ = false;
+	bool copy_ = false;
+	bool limit_ = false;
+	bool halfUpdate_ = false;
+	float tickStep_ = 1.0f / 60.0f;
+};
+
+// Flock lockstep class
+// - Server and clients run the same flock simulation at a fixed tick, so boid transforms are
+//   never sent: the server sends the flock parameters and seed, its exact flock state once on
+//   join, then only its tick number and the kill/spawn events, tagged with the tick they apply at
+// - Clients stay a few ticks behind the server and never run past the last tick the server has
+//   reported, so every event for a tick has arrived before that tick is run
+// - Every LOCKSTEP_CHECKSUM_TICKS the server sends a checksum of the flock state. A client whose
+//   own checksum differs (or that receives an event too late) asks for the exact state again
+class FlockLockstep
+{
+public:
+	// Constructor
+	FlockLockstep() :
+		server_(false),
+		started_(false),
+		startPending_(false),
+		resyncPending_(false),
+		skipTick_(false),
+		tick_(0),
+		stateTick_(0),
+		sentTick_(0),
+		lastServerTick_(0),
+		checksumPending_(false),
+		checksumTick_(0),
+		checksum_(0)
+	{}
+
+	// Initialise the server side
+	void InitialiseServer(const LockstepParameters& parameters);
+
+	// Initialise the client side - waits for the server's state
+	void InitialiseClient();
+
+	// Add a set of boids to be run in lockstep
+	void AddBoidSet(BoidSet* boidSet);
+
+	// Forget the boid sets and any pending state
+	void Clear();
+
+	// Run the flock for a physics step - called from the physics pre-step
+	void Step();
+
+	// Send the tick, events and checksum to the clients - called each frame (server)
+	void Update(Scene* scene);
+
+	// Handle a network message, returns true if it belonged to the lockstep channel
+	bool HandleMessage(Connection* connection, int msgID, MemoryBuffer& message);
+
+	// Record a boid killed by the server
+	void RecordKill(Node* node);
+
+	// Record a boid brought back by the server
+	void RecordSpawn(Node* node);
+
+	// Forget a client that has disconnected (server)
+	void RemoveConnection(Connection* connection);
+
+	// Client has received the parameters and is waiting for its boid sets to be built
+	bool IsStartPending();
+
+	// Parameters of the flock being run
+	const LockstepParameters& GetParameters();
+
+	// Apply the server's state once the boid sets have been built (client)
+	void StartClient();
+
+	// Is the flock running
+	bool IsStarted();
+
+	// Number of ticks run
+	unsigned GetTick();
+
+private:
+	// A kill or spawn
+	struct Event
+	{
+		unsigned tick_;
+		unsigned index_;
+		unsigned char type_;
+	};
+
+	// Run a single tick of every boid set
+	void RunTick();
+
+	// Apply an event to a boid
+	void ApplyEvent(const Event& event);
+
+	// Record an event for a boid node (server)
+	void RecordEvent(Node* node, unsigned char type);
+
+	// Checksum of the flock state
+	unsigned Checksum();
+
+	// Write the parameters and the exact flock state (server)
+	void WriteState(VectorBuffer& message);
+
+	// Read the exact flock state that follows the parameters and tick (client)
+	bool ReadState(MemoryBuffer& message);
+
+	// Compare a server checksum with the client's own (client)
+	void CompareChecksum(Connection* connection, unsigned tick, unsigned checksum);
+
+	// Ask the server for its exact state (client)
+	void RequestResync(Connection* connection);
+
+	// Server or client side
+	bool server_;
+
+	// Flock state
+	bool started_;
+	bool startPending_;
+	bool resyncPending_;
+	bool skipTick_;
+	LockstepParameters parameters_;
+	std::vector<BoidSet*> sets_;
+	unsigned tick_;
+
+	// Tick of the last state received (client) and the last tick sent (server)
+	unsigned stateTick_;
+	unsigned sentTick_;
+
+	// State received before the boid sets were built (client)
+	VectorBuffer pendingState_;
+
+	// Events not yet sent (server) or not yet applied (client)
+	std::vector<Event> events_;
+
+	// Clients that have been sent the state (server)
+	HashSet<Connection*> joined_;
+
+	// Last tick reported by the server (client)
+	unsigned lastServerTick_;
+
+	// Last checksum taken (server) and the checksums of recent ticks (client)
+	bool checksumPending_;
+	unsigned checksumTick_;
+	unsigned checksum_;
+	unsigned clientChecksumTicks_[LOCKSTEP_CHECKSUM_HISTORY] = {};
+	unsigned clientChecksums_[LOCKSTEP_CHECKSUM_HISTORY] = {};
+
+	// Server checksums for ticks the client has not run yet (client)
+	std::vector<std::pair<unsigned, unsigned> > pendingChecksums_;
+
+	// Connection to the server (client)
+	WeakPtr<Connection> serverConnection_;
+};
@@ -0,0 +1,53 @@
+// Include directives
+#include "FlockRandom.h"
+
+// Step of the generator state (the golden ratio in 64 bits)
+static const unsigned long long FLOCK_RANDOM_STEP = 0x9E3779B97F4A7C15ull;
+
+
+// Constructor
+FlockRandom::FlockRandom(unsigned seed) :
+	state_(Mix(seed))
+{
+}
+
+
+// Independent stream for the index - the parent is left as it is
+FlockRandom FlockRandom::Split(unsigned index) const
+{
+	FlockRandom stream;
+	stream.state_ = Mix(state_ ^ Mix((index + 1ull) * FLOCK_RANDOM_STEP));
+	return stream;
+}
+
+
+// Next random number
+unsigned FlockRandom::NextUInt()
+{
+	state_ += FLOCK_RANDOM_STEP;
+	return (unsigned)(Mix(state_) >> 32);
+}
+
+
+// Next random number in [0, 1)
+float FlockRandom::Next()
+{
+	// 24 bits fit a float exactly
+	return (NextUInt() >> 8) / 16777216.0f;
+}
+
+
+// Next random number in [0, range)
+float FlockRandom::Next(float range)
+{
+	return Next() * range;
+}
+
+
+// Scramble a value (the SplitMix64 finaliser)
+unsigned long long FlockRandom::Mix(unsigned long long value)
+{
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
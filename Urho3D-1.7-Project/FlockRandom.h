@@ -0,0 +1,31 @@
+#pragma once
+
+// Flock random class
+// - A seeded generator (SplitMix64) with its own state, so the flock never draws from the
+//   engine's global Random() and two runs from the same seed start bit for bit the same
+// - Split gives an independent stream for an index without advancing the parent, so each
+//   boid set, and each boid of a set, draws the same numbers whatever thread or order builds it
+// - Only integer arithmetic and an exact conversion to float, so every platform agrees
+class FlockRandom
+{
+public:
+	// Constructor
+	explicit FlockRandom(unsigned seed = 0);
+
+	// Independent stream for the index - the parent is left as it is
+	FlockRandom Split(unsigned index) const;
+
+	// Next random number
+	unsigned NextUInt();
+
+	// Next random number in [0, 1), and in [0, range)
+	float Next();
+	float Next(float range);
+
+private:
+	// Scramble a value (the SplitMix64 finaliser)
+	static unsigned long long Mix(unsigned long long value);
+
+	// Generator state
+	unsigned long long state_;
+};
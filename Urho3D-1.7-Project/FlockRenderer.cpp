@@ -0,0 +1,124 @@
+// Include directives
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Scene/Node.h>
+#include "FlockRenderer.h"
+#include "BoidSet.h"
+
+// Weights used to turn the bounding box size into a single LOD scale
+static const Vector3 LOD_DOT_SCALE(1 / 3.0f, 1 / 3.0f, 1 / 3.0f);
+
+// Constructor
+FlockRenderer::FlockRenderer(Context* context) :
+	StaticModel(context),
+	boidSet_(nullptr),
+	modelType_(0),
+	numWorldTransforms_(0)
+{
+}
+
+
+// Destructor
+FlockRenderer::~FlockRenderer()
+{
+}
+
+
+// Register object factory
+void FlockRenderer::RegisterObject(Context* context)
+{
+	context->RegisterFactory<FlockRenderer>();
+	URHO3D_COPY_BASE_ATTRIBUTES(StaticModel);
+}
+
+
+// Calculate the distance and prepare the instanced batches for rendering
+void FlockRenderer::UpdateBatches(const FrameInfo& frame)
+{
+	// Getting the world bounding box ensures the transforms are updated
+	const BoundingBox& worldBoundingBox = GetWorldBoundingBox();
+	distance_ = frame.camera_->GetDistance(worldBoundingBox.Center());
+
+	// Every batch draws all the instances
+	for (unsigned i = 0; i < batches_.Size(); ++i)
+	{
+		batches_[i].distance_ = distance_;
+		batches_[i].worldTransform_ = numWorldTransforms_ ? &worldTransforms_[0] : &Matrix3x4::IDENTITY;
+		batches_[i].numWorldTransforms_ = numWorldTransforms_;
+	}
+
+	// Pick the LOD level for the group as a whole
+	float scale = worldBoundingBox.Size().DotProduct(LOD_DOT_SCALE);
+	float newLodDistance = frame.camera_->GetLodDistance(distance_, scale, lodBias_);
+	if (newLodDistance != lodDistance_)
+	{
+		lodDistance_ = newLodDistance;
+		CalculateLodLevels();
+	}
+}
+
+
+// Picking is done through the physics world, not the octree
+void FlockRenderer::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results)
+{
+}
+
+
+// Set the boid set and model type to draw
+void FlockRenderer::SetFlock(BoidSet* boidSet, int modelType)
+{
+	boidSet_ = boidSet;
+	modelType_ = modelType;
+	UpdateInstances();
+}
+
+
+// Rebuild the instance transforms from the flock state - call after the flock has moved
+void FlockRenderer::UpdateInstances()
+{
+	// No flock or model
+	numWorldTransforms_ = 0;
+	instanceBoundingBox_.Clear();
+	if (!boidSet_ || !model_)
+	{
+		OnMarkedDirty(node_);
+		return;
+	}
+
+	// Build a transform for each living boid of this model type
+	const unsigned numBoids = boidSet_->positions_.size();
+	worldTransforms_.Resize(numBoids);
+	for (unsigned i = 0; i < numBoids; i++)
+	{
+		// Dead or a different model
+		if (!boidSet_->alive_[i] || boidSet_->modelTypes_[i] != modelType_)
+			continue;
+
+		// Instance transform and bounds
+		Matrix3x4 transform(boidSet_->positions_[i], boidSet_->rotations_[i], 1.0f);
+		worldTransforms_[numWorldTransforms_++] = transform;
+		instanceBoundingBox_.Merge(boundingBox_.Transformed(transform));
+	}
+
+	// Reinsert the group into the octree
+	OnMarkedDirty(node_);
+}
+
+
+// Get the number of instances drawn
+unsigned FlockRenderer::GetNumInstances() const
+{
+	return numWorldTransforms_;
+}
+
+
+// Recalculate the world-space bounding box
+void FlockRenderer::OnWorldBoundingBoxUpdate()
+{
+	// The instances were merged when they were built
+	if (numWorldTransforms_)
+		worldBoundingBox_ = instanceBoundingBox_;
+	else
+		worldBoundingBox_.Define(node_->GetWorldPosition());
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Graphics/StaticModel.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Forward declarations
+class BoidSet;
+
+// Flock renderer class
+// - Draws every boid of one model type in a boid set as a single instanced batch
+// - The instance transforms are built from the boid set's flock state arrays, so the
+//   boids themselves need no drawable of their own
+// - Culled and lit as one unit (like StaticModelGroup), which keeps the draw call
+//   count constant in the flock size
+class FlockRenderer : public StaticModel
+{
+	// Enable type information
+	URHO3D_OBJECT(FlockRenderer, StaticModel);
+
+public:
+	// Constructor
+	FlockRenderer(Context* context);
+
+	// Destructor
+	virtual ~FlockRenderer();
+
+	// Register object factory
+	static void RegisterObject(Context* context);
+
+	// Calculate the distance and prepare the instanced batches for rendering
+	virtual void UpdateBatches(const FrameInfo& frame);
+
+	// Picking is done through the physics world, not the octree
+	virtual void ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results);
+
+	// Set the boid set and model type to draw
+	void SetFlock(BoidSet* boidSet, int modelType);
+
+	// Rebuild the instance transforms from the flock state - call after the flock has moved
+	void UpdateInstances();
+
+	// Get the number of instances drawn
+	unsigned GetNumInstances() const;
+
+protected:
+	// Recalculate the world-space bounding box
+	virtual void OnWorldBoundingBoxUpdate();
+
+private:
+	// The boid set and model type drawn
+	BoidSet* boidSet_;
+	int modelType_;
+
+	// Per-instance world transforms
+	PODVector<Matrix3x4> worldTransforms_;
+	unsigned numWorldTransforms_;
+
+	// Bounding box of all the instances
+	BoundingBox instanceBoundingBox_;
+};
@@ -0,0 +1,761 @@
+// Include directives
+#include <algorithm>
+#include <cstdio>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Network/Network.h>
+#include "FlockReplication.h"
+
+// Record kinds, in the low two bits of each record's index gap - a zero ends the records
+static const unsigned char FLOCK_RECORD_NONE = 0;
+static const unsigned char FLOCK_RECORD_DELTA = 1;
+static const unsigned char FLOCK_RECORD_FULL = 2;
+static const unsigned char FLOCK_RECORD_DEAD = 3;
+
+// Largest position change (in quantised steps) written as a delta
+static const int FLOCK_MAX_DELTA = 127;
+
+
+// Quantise a world coordinate to 16 bits
+static unsigned short QuantisePosition(float value)
+{
+	float unit = (value + FLOCK_WORLD_EXTENT) / (2.0f * FLOCK_WORLD_EXTENT);
+	return (unsigned short)Clamp(RoundToInt(unit * 65535.0f), 0, 65535);
+}
+
+
+// Turn a 16 bit coordinate back into a world coordinate
+static float DequantisePosition(unsigned short value)
+{
+	return value / 65535.0f * (2.0f * FLOCK_WORLD_EXTENT) - FLOCK_WORLD_EXTENT;
+}
+
+
+// Quantise a heading to a yaw and pitch byte
+static void QuantiseHeading(const Vector3& heading, unsigned char& yaw, unsigned char& pitch)
+{
+	// Angles of the heading (degrees)
+	Vector3 direction = heading.Normalized();
+	float yawAngle = Atan2(direction.x_, direction.z_);
+	float pitchAngle = Asin(Clamp(-direction.y_, -1.0f, 1.0f));
+
+	// Yaw wraps around, pitch is clamped
+	yaw = (unsigned char)(RoundToInt((yawAngle + 180.0f) / 360.0f * 256.0f) & 0xff);
+	pitch = (unsigned char)Clamp(RoundToInt((pitchAngle + 90.0f) / 180.0f * 255.0f), 0, 255);
+}
+
+
+// Grid cell of a coordinate along an axis
+static int GridCell(float value)
+{
+	return Clamp((int)((value + FLOCK_WORLD_EXTENT) / FLOCK_GRID_CELL), 0, FLOCK_GRID_SIZE - 1);
+}
+
+
+// Turn a yaw and pitch byte back into a rotation (boids never roll)
+static Quaternion DequantiseHeading(unsigned char yaw, unsigned char pitch)
+{
+	float yawAngle = yaw / 256.0f * 360.0f - 180.0f;
+	float pitchAngle = pitch / 255.0f * 180.0f - 90.0f;
+	return Quaternion(pitchAngle, yawAngle, 0.0f);
+}
+
+
+// Initialise the server side
+void FlockReplication::InitialiseServer(Scene* scene)
+{
+	Clear();
+	server_ = true;
+	scene_ = scene;
+}
+
+
+// Initialise the client side
+void FlockReplication::InitialiseClient(ResourceCache* cache, Scene* scene)
+{
+	Clear();
+	server_ = false;
+	scene_ = scene;
+	cache_ = cache;
+}
+
+
+// Add a set of boids to be sent (server)
+void FlockReplication::AddBoidSet(BoidSet* boidSet)
+{
+	sets_.push_back(boidSet);
+}
+
+
+// Forget the boid sets, the history and any client boid nodes
+void FlockReplication::Clear()
+{
+	// Remove the client boid nodes that are still in the scene
+	for (auto& node : clientNodes_)
+	{
+		if (node)
+			node->Remove();
+	}
+	clientNodes_.clear();
+
+	// Forget the boid sets and the snapshots
+	sets_.clear();
+	clients_.Clear();
+	current_.sequence_ = 0;
+	current_.numBoids_ = 0;
+	current_.boids_.clear();
+	positions_.clear();
+	for (unsigned i = 0; i < FLOCK_HISTORY; i++)
+	{
+		history_[i].sequence_ = 0;
+		history_[i].numBoids_ = 0;
+		history_[i].indices_.clear();
+		history_[i].boids_.clear();
+	}
+	sequence_ = 0;
+	lastReceived_ = 0;
+	sendTimer_ = 0.0f;
+
+	// Forget the buffered states
+	buffer_.Clear();
+	clientTime_ = 0.0f;
+
+	// Reset the bandwidth measurement
+	statsTimer_ = 0.0f;
+	bytesSent_ = 0;
+	bytesPerClient_ = 0.0f;
+	lastSnapshotSize_ = 0;
+}
+
+
+// Update - called each frame after the flock state has been refreshed (server), or to move the client boids
+void FlockReplication::Update(float timeStep)
+{
+	// No scene
+	if (!scene_)
+		return;
+
+	// Client - draw the boids from the buffered snapshots
+	if (!server_)
+	{
+		UpdateClient(timeStep);
+		return;
+	}
+
+	// Report the bandwidth used
+	statsTimer_ += timeStep;
+	if (statsTimer_ >= FLOCK_STATS_INTERVAL)
+		ReportStats();
+
+	// Nothing to send or not time to send yet
+	sendTimer_ += timeStep;
+	if (sets_.empty() || sendTimer_ < sendInterval_)
+		return;
+	sendTimer_ = Min(sendTimer_ - sendInterval_, sendInterval_);
+
+	// Snapshot the flock once for every client
+	TakeSnapshot();
+
+	// Send each client a delta against the last snapshot it acknowledged
+	VectorBuffer message;
+	const Vector<SharedPtr<Connection> >& connections = scene_->GetSubsystem<Network>()->GetClientConnections();
+	for (unsigned i = 0; i < connections.Size(); ++i)
+	{
+		// Client still loading the scene
+		Connection* connection = connections[i];
+		if (!connection->IsSceneLoaded())
+			continue;
+
+		// What the client is sent of the snapshot, kept to delta against
+		ClientView& client = clients_[connection];
+		const Snapshot* base = FindSnapshot(client.history_, client.acked_);
+		Snapshot& view = client.history_[sequence_ % FLOCK_HISTORY];
+		if (base == &view)
+			base = nullptr;
+		BuildView(connection, base, view);
+
+		// Write and send the snapshot
+		message.Clear();
+		WriteSnapshot(message, view, base);
+		connection->SendMessage(MSG_FLOCKSNAPSHOT, false, false, message);
+
+		// Measure the bandwidth
+		bytesSent_ += message.GetSize();
+		lastSnapshotSize_ = message.GetSize();
+	}
+}
+
+
+// Handle a network message, returns true if it belonged to the flock channel
+bool FlockReplication::HandleMessage(Connection* connection, int msgID, MemoryBuffer& message)
+{
+	// Snapshot from the server
+	if (msgID == MSG_FLOCKSNAPSHOT)
+	{
+		if (!server_ && scene_)
+			ReadSnapshot(connection, message);
+		return true;
+	}
+
+	// Acknowledgement from a client - only move forward
+	if (msgID == MSG_FLOCKACK)
+	{
+		unsigned sequence = message.ReadUInt();
+		HashMap<Connection*, ClientView>::Iterator client = clients_.Find(connection);
+		if (server_ && client != clients_.End() && sequence <= sequence_ && sequence > client->second_.acked_)
+			client->second_.acked_ = sequence;
+		return true;
+	}
+
+	// Not a flock message
+	return false;
+}
+
+
+// Forget a client that has disconnected (server)
+void FlockReplication::RemoveConnection(Connection* connection)
+{
+	clients_.Erase(connection);
+}
+
+
+// Set the number of snapshots sent each second
+void FlockReplication::SetSnapshotRate(float rate)
+{
+	sendInterval_ = 1.0f / Max(rate, 1.0f);
+}
+
+
+// Set the area of interest of the clients
+void FlockReplication::SetInterest(float radius, float viewRange, float viewAngle)
+{
+	interestRadius_ = Max(radius, 0.0f);
+	viewRange_ = Max(viewRange, interestRadius_);
+	viewAngle_ = Clamp(viewAngle, 0.0f, 180.0f);
+}
+
+
+// Set the delay the client boids are drawn at and their longest extrapolation (client)
+void FlockReplication::SetInterpolation(float delay, float maxExtrapolation)
+{
+	buffer_.SetDelay(delay);
+	buffer_.SetMaxExtrapolation(maxExtrapolation);
+}
+
+
+// The buffered snapshots, for their jitter and buffer statistics (client)
+SnapshotBuffer& FlockReplication::GetSnapshotBuffer()
+{
+	return buffer_;
+}
+
+
+// Flock channel bytes sent to each client per second (server)
+float FlockReplication::GetBytesPerClient()
+{
+	return bytesPerClient_;
+}
+
+
+// Size in bytes of the last snapshot sent or received
+unsigned FlockReplication::GetLastSnapshotSize()
+{
+	return lastSnapshotSize_;
+}
+
+
+// Build the next snapshot from the flock state (server)
+void FlockReplication::TakeSnapshot()
+{
+	// Next snapshot
+	sequence_++;
+	Snapshot& snapshot = current_;
+	snapshot.sequence_ = sequence_;
+	snapshot.boids_.clear();
+	positions_.clear();
+
+	// Quantise every boid of every set
+	for (auto boidSet : sets_)
+	{
+		for (int i = 0; i < boidSet->numberOfBoids_; i++)
+		{
+			// Boids face along their velocity - fall back to the rotation when stopped
+			Vector3 heading = boidSet->velocities_[i];
+			if (heading.LengthSquared() < M_EPSILON)
+				heading = boidSet->rotations_[i] * Vector3::FORWARD;
+
+			// Quantised state
+			BoidState state;
+			state.x_ = QuantisePosition(boidSet->positions_[i].x_);
+			state.y_ = QuantisePosition(boidSet->positions_[i].y_);
+			state.z_ = QuantisePosition(boidSet->positions_[i].z_);
+			QuantiseHeading(heading, state.yaw_, state.pitch_);
+			state.type_ = (unsigned char)boidSet->modelTypes_[i];
+			state.alive_ = boidSet->alive_[i];
+			snapshot.boids_.push_back(state);
+			positions_.push_back(boidSet->positions_[i]);
+		}
+	}
+	unsigned numBoids = snapshot.boids_.size();
+	snapshot.numBoids_ = numBoids;
+
+	// Count the live boids in each grid cell, then place them cell by cell
+	gridStarts_.assign(FLOCK_GRID_SIZE * FLOCK_GRID_SIZE * FLOCK_GRID_SIZE + 1, 0);
+	boidCells_.resize(numBoids);
+	for (unsigned i = 0; i < numBoids; i++)
+	{
+		const Vector3& position = positions_[i];
+		boidCells_[i] = (GridCell(position.z_) * FLOCK_GRID_SIZE + GridCell(position.y_)) * FLOCK_GRID_SIZE + GridCell(position.x_);
+		if (snapshot.boids_[i].alive_)
+			gridStarts_[boidCells_[i] + 1]++;
+	}
+	for (unsigned cell = 1; cell < gridStarts_.size(); cell++)
+		gridStarts_[cell] += gridStarts_[cell - 1];
+	gridBoids_.resize(gridStarts_.back());
+
+	// The candidate list holds where each cell is filled up to while placing
+	candidates_.assign(gridStarts_.begin(), gridStarts_.end() - 1);
+	for (unsigned i = 0; i < numBoids; i++)
+	{
+		if (snapshot.boids_[i].alive_)
+			gridBoids_[candidates_[boidCells_[i]]++] = i;
+	}
+
+	// Nothing added by a query yet
+	stamps_.assign(numBoids, 0);
+	stamp_ = 0;
+}
+
+
+// Add the boids in the grid cells the box touches to the candidates, once each (server)
+void FlockReplication::QueryGrid(const Vector3& min, const Vector3& max)
+{
+	int minX = GridCell(min.x_), maxX = GridCell(max.x_);
+	int minY = GridCell(min.y_), maxY = GridCell(max.y_);
+	int minZ = GridCell(min.z_), maxZ = GridCell(max.z_);
+	for (int z = minZ; z <= maxZ; z++)
+	{
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				unsigned cell = (z * FLOCK_GRID_SIZE + y) * FLOCK_GRID_SIZE + x;
+				for (unsigned j = gridStarts_[cell]; j < gridStarts_[cell + 1]; j++)
+				{
+					unsigned index = gridBoids_[j];
+					if (stamps_[index] != stamp_)
+					{
+						stamps_[index] = stamp_;
+						candidates_.push_back(index);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+// Build what a client is sent of the snapshot - its area of interest at its update rates (server)
+void FlockReplication::BuildView(Connection* connection, const Snapshot* base, Snapshot& view)
+{
+	// A base of a different flock can't be used
+	unsigned numBoids = current_.numBoids_;
+	if (base && base->numBoids_ != numBoids)
+		base = nullptr;
+
+	// The client's camera, sent with its controls
+	Vector3 cameraPosition = connection->GetPosition();
+	Vector3 cameraDirection = connection->GetRotation() * Vector3::FORWARD;
+	float viewCos = Cos(viewAngle_);
+
+	// The boids in the grid cells around the radius
+	candidates_.clear();
+	stamp_++;
+	Vector3 radius(interestRadius_, interestRadius_, interestRadius_);
+	QueryGrid(cameraPosition - radius, cameraPosition + radius);
+
+	// And around the view - within the discs at the near and far ends of its rounded cap, or
+	// the whole range for a cone wider than a half space
+	if (viewRange_ > interestRadius_ && viewAngle_ > 0.0f)
+	{
+		BoundingBox box(cameraPosition, cameraPosition);
+		if (viewAngle_ < 90.0f)
+		{
+			float discRadius = viewRange_ * Sin(viewAngle_);
+			Vector3 extent(discRadius * Sqrt(Max(1.0f - cameraDirection.x_ * cameraDirection.x_, 0.0f)),
+				discRadius * Sqrt(Max(1.0f - cameraDirection.y_ * cameraDirection.y_, 0.0f)),
+				discRadius * Sqrt(Max(1.0f - cameraDirection.z_ * cameraDirection.z_, 0.0f)));
+			Vector3 nearDisc = cameraPosition + cameraDirection * (viewRange_ * viewCos);
+			Vector3 farDisc = cameraPosition + cameraDirection * viewRange_;
+			box.Merge(nearDisc - extent);
+			box.Merge(nearDisc + extent);
+			box.Merge(farDisc - extent);
+			box.Merge(farDisc + extent);
+		}
+		else
+		{
+			Vector3 range(viewRange_, viewRange_, viewRange_);
+			box.Merge(cameraPosition - range);
+			box.Merge(cameraPosition + range);
+		}
+		QueryGrid(box.min_, box.max_);
+	}
+
+	// In index order, to walk along the base
+	std::sort(candidates_.begin(), candidates_.end());
+
+	// Only the live boids in the area
+	view.sequence_ = current_.sequence_;
+	view.numBoids_ = numBoids;
+	view.indices_.clear();
+	view.boids_.clear();
+	unsigned b = 0;
+	for (unsigned i : candidates_)
+	{
+		// Distance and direction from the camera
+		Vector3 offset = positions_[i] - cameraPosition;
+		float distance = offset.Length();
+
+		// Outside the area of interest - hidden on the client
+		bool inRadius = distance <= interestRadius_;
+		bool inView = distance <= viewRange_ && offset.DotProduct(cameraDirection) >= viewCos * distance;
+		if (!inRadius && !inView)
+			continue;
+
+		// What the client was last sent of it
+		const BoidState* old = nullptr;
+		if (base)
+		{
+			while (b < base->indices_.size() && base->indices_[b] < i)
+				b++;
+			if (b < base->indices_.size() && base->indices_[b] == i)
+				old = &base->boids_[b];
+		}
+
+		// Distant boids are only sent every few snapshots (staggered) - the client keeps the base state
+		const BoidState& state = current_.boids_[i];
+		unsigned interval = distance > FLOCK_FAR_DISTANCE ? 4 : (distance > FLOCK_MID_DISTANCE ? 2 : 1);
+		bool keep = interval > 1 && old && old->type_ == state.type_ && (view.sequence_ + i) % interval != 0;
+		view.indices_.push_back(i);
+		view.boids_.push_back(keep ? *old : state);
+	}
+}
+
+
+// Write a snapshot, as a delta against the base when there is one (server)
+void FlockReplication::WriteSnapshot(VectorBuffer& message, const Snapshot& snapshot, const Snapshot* base)
+{
+	// A base of a different flock can't be used
+	if (base && base->numBoids_ != snapshot.numBoids_)
+		base = nullptr;
+
+	// Header - the server's time lets the client draw the snapshots at an even pace
+	message.WriteUInt(snapshot.sequence_);
+	message.WriteUInt(base ? base->sequence_ : 0);
+	message.WriteFloat(scene_->GetElapsedTime());
+	message.WriteVLE(snapshot.numBoids_);
+
+	// Records in index order, walking the snapshot and the base together - boids unchanged
+	// since the base are left out, and boids of the base that left the area or died are dead
+	unsigned numBase = base ? base->indices_.size() : 0;
+	unsigned v = 0;
+	unsigned b = 0;
+	unsigned last = 0;
+	while (v < snapshot.indices_.size() || b < numBase)
+	{
+		unsigned index = v < snapshot.indices_.size() ? snapshot.indices_[v] : M_MAX_UNSIGNED;
+		unsigned baseIndex = b < numBase ? base->indices_[b] : M_MAX_UNSIGNED;
+
+		// Gone from the area
+		unsigned char kind;
+		if (baseIndex < index)
+		{
+			message.WriteVLE((baseIndex - last) << 2 | FLOCK_RECORD_DEAD);
+			last = baseIndex;
+			b++;
+			continue;
+		}
+
+		// New to the client or a changed model - send it whole
+		const BoidState& state = snapshot.boids_[v++];
+		const BoidState* old = nullptr;
+		if (baseIndex == index)
+			old = &base->boids_[b++];
+		if (!old || old->type_ != state.type_)
+			kind = FLOCK_RECORD_FULL;
+
+		// Unchanged since the base
+		else if (state.x_ == old->x_ && state.y_ == old->y_ && state.z_ == old->z_ && state.yaw_ == old->yaw_ && state.pitch_ == old->pitch_)
+			continue;
+
+		// Small moves are sent as a delta
+		else
+		{
+			int dx = (int)state.x_ - (int)old->x_;
+			int dy = (int)state.y_ - (int)old->y_;
+			int dz = (int)state.z_ - (int)old->z_;
+			if (Abs(dx) <= FLOCK_MAX_DELTA && Abs(dy) <= FLOCK_MAX_DELTA && Abs(dz) <= FLOCK_MAX_DELTA)
+				kind = FLOCK_RECORD_DELTA;
+			else
+				kind = FLOCK_RECORD_FULL;
+		}
+
+		// The record - its index as the gap from the last one, with its kind
+		message.WriteVLE((index - last) << 2 | kind);
+		last = index;
+		if (kind == FLOCK_RECORD_DELTA)
+		{
+			message.WriteByte((signed char)((int)state.x_ - (int)old->x_));
+			message.WriteByte((signed char)((int)state.y_ - (int)old->y_));
+			message.WriteByte((signed char)((int)state.z_ - (int)old->z_));
+			message.WriteUByte(state.yaw_);
+			message.WriteUByte(state.pitch_);
+		}
+		else
+		{
+			message.WriteUByte(state.type_);
+			message.WriteUShort(state.x_);
+			message.WriteUShort(state.y_);
+			message.WriteUShort(state.z_);
+			message.WriteUByte(state.yaw_);
+			message.WriteUByte(state.pitch_);
+		}
+	}
+
+	// End of the records
+	message.WriteVLE(FLOCK_RECORD_NONE);
+}
+
+
+// Read a snapshot and buffer it for the client boid nodes (client)
+void FlockReplication::ReadSnapshot(Connection* connection, MemoryBuffer& message)
+{
+	// Header
+	unsigned sequence = message.ReadUInt();
+	unsigned baseSequence = message.ReadUInt();
+	float sendTime = message.ReadFloat();
+	unsigned numBoids = message.ReadVLE();
+	lastSnapshotSize_ = message.GetSize();
+
+	// Older than the snapshot already applied
+	if (sequence <= lastReceived_)
+		return;
+
+	// The base must still be held - otherwise wait for the server to send a newer base
+	const Snapshot* base = nullptr;
+	if (baseSequence)
+	{
+		base = FindSnapshot(history_, baseSequence);
+		if (!base || base->numBoids_ != numBoids || sequence - baseSequence >= FLOCK_HISTORY)
+			return;
+	}
+
+	// Pace the buffer by the server's clock
+	buffer_.AddArrival(sendTime, clientTime_);
+
+	// Rebuild the boids in the area from the base and the records
+	Snapshot& snapshot = history_[sequence % FLOCK_HISTORY];
+	snapshot.sequence_ = sequence;
+	snapshot.numBoids_ = numBoids;
+	snapshot.indices_.clear();
+	snapshot.boids_.clear();
+	unsigned numBase = base ? base->indices_.size() : 0;
+	unsigned b = 0;
+	unsigned index = 0;
+	for (;;)
+	{
+		// Next record - a zero (or the end of the message) ends them
+		unsigned record = message.ReadVLE();
+		if (record == FLOCK_RECORD_NONE)
+			break;
+		index += record >> 2;
+		unsigned char kind = record & 3;
+		if (index >= numBoids)
+			break;
+
+		// Boids of the base before it are unchanged
+		for (; b < numBase && base->indices_[b] < index; b++)
+		{
+			snapshot.indices_.push_back(base->indices_[b]);
+			snapshot.boids_.push_back(base->boids_[b]);
+		}
+
+		// Start from the base
+		BoidState state = {};
+		if (b < numBase && base->indices_[b] == index)
+			state = base->boids_[b++];
+
+		// Position change and heading
+		if (kind == FLOCK_RECORD_DELTA)
+		{
+			state.x_ = (unsigned short)(state.x_ + message.ReadByte());
+			state.y_ = (unsigned short)(state.y_ + message.ReadByte());
+			state.z_ = (unsigned short)(state.z_ + message.ReadByte());
+			state.yaw_ = message.ReadUByte();
+			state.pitch_ = message.ReadUByte();
+		}
+
+		// Whole state
+		else if (kind == FLOCK_RECORD_FULL)
+		{
+			state.type_ = (unsigned char)Min((int)message.ReadUByte(), NUM_BOID_MODELS - 1);
+			state.x_ = message.ReadUShort();
+			state.y_ = message.ReadUShort();
+			state.z_ = message.ReadUShort();
+			state.yaw_ = message.ReadUByte();
+			state.pitch_ = message.ReadUByte();
+			state.alive_ = 1;
+		}
+
+		// Dead or out of the area - hidden, and no longer held
+		else
+		{
+			state.alive_ = 0;
+			ApplyState(index, sendTime, state);
+			continue;
+		}
+
+		// Store and buffer the state
+		snapshot.indices_.push_back(index);
+		snapshot.boids_.push_back(state);
+		ApplyState(index, sendTime, state);
+	}
+
+	// The rest of the base is unchanged
+	for (; b < numBase; b++)
+	{
+		snapshot.indices_.push_back(base->indices_[b]);
+		snapshot.boids_.push_back(base->boids_[b]);
+	}
+
+	// Applied - acknowledge it so the server can delta against it
+	lastReceived_ = sequence;
+	VectorBuffer ack;
+	ack.WriteUInt(sequence);
+	connection->SendMessage(MSG_FLOCKACK, false, false, ack);
+}
+
+
+// Buffer the state of a client boid, creating its node if needed (client)
+void FlockReplication::ApplyState(unsigned index, float sendTime, const BoidState& state)
+{
+	// Room for the boid
+	if (clientNodes_.size() <= index)
+		clientNodes_.resize(index + 1);
+	Node* node = clientNodes_[index];
+
+	// Dead boids are hidden once the buffer reaches them
+	Vector3 position(DequantisePosition(state.x_), DequantisePosition(state.y_), DequantisePosition(state.z_));
+	if (!state.alive_)
+	{
+		if (node)
+			buffer_.AddState(index, sendTime, position, DequantiseHeading(state.yaw_, state.pitch_), false);
+		return;
+	}
+
+	// Create the node - a kinematic body keeps the crosshair targeting working
+	if (!node)
+	{
+		node = scene_->CreateChild("Boid", LOCAL);
+		node->CreateComponent<StaticModel>(LOCAL)->SetCastShadows(true);
+		RigidBody* rigidBody = node->CreateComponent<RigidBody>(LOCAL);
+		rigidBody->SetCollisionLayer(1);
+		rigidBody->SetMass(1.0f);
+		rigidBody->SetUseGravity(false);
+		rigidBody->SetKinematic(true);
+		node->CreateComponent<CollisionShape>(LOCAL)->SetBox(Vector3::ONE);
+		node->SetEnabled(false);
+		clientNodes_[index] = node;
+	}
+
+	// Set the model of the boid type
+	StaticModel* object = node->GetComponent<StaticModel>();
+	Model* model = cache_->GetResource<Model>(BOID_MODELS[state.type_]);
+	if (object->GetModel() != model)
+	{
+		object->SetModel(model);
+		object->ApplyMaterialList(BOID_MATERIALS[state.type_]);
+	}
+
+	// Buffer the move
+	buffer_.AddState(index, sendTime, position, DequantiseHeading(state.yaw_, state.pitch_), true);
+}
+
+
+// Move the client boid nodes to the buffered states (client)
+void FlockReplication::UpdateClient(float timeStep)
+{
+	// Advance the local clock and the time drawn at
+	clientTime_ += timeStep;
+	buffer_.Update(clientTime_);
+
+	// Move each boid
+	Vector3 position;
+	Quaternion rotation;
+	bool visible;
+	for (unsigned i = 0; i < clientNodes_.size(); i++)
+	{
+		// No node, or nothing received yet
+		Node* node = clientNodes_[i];
+		if (!node || !buffer_.Sample(i, position, rotation, visible))
+			continue;
+
+		// Show or hide and move the boid
+		if (node->IsEnabled() != visible)
+			node->SetEnabled(visible);
+		if (visible)
+			node->SetTransform(position, rotation);
+	}
+
+	// Report the buffer state
+	statsTimer_ += timeStep;
+	if (statsTimer_ >= FLOCK_STATS_INTERVAL)
+	{
+		char text[160];
+		snprintf(text, sizeof(text), "Flock buffer jitter %.1f ms, %.1f ms buffered, %u boids extrapolated, %u held",
+			buffer_.GetJitter() * 1000.0f, buffer_.GetBufferedTime() * 1000.0f, buffer_.GetNumExtrapolated(), buffer_.GetNumStale());
+		URHO3D_LOGINFO(text);
+		statsTimer_ = 0.0f;
+	}
+}
+
+
+// The snapshot held in a history for a sequence number, or null when it has gone
+FlockReplication::Snapshot* FlockReplication::FindSnapshot(Snapshot* history, unsigned sequence)
+{
+	// No snapshot
+	if (!sequence)
+		return nullptr;
+
+	// The slot has been reused by a newer snapshot
+	Snapshot& snapshot = history[sequence % FLOCK_HISTORY];
+	if (snapshot.sequence_ != sequence)
+		return nullptr;
+	return &snapshot;
+}
+
+
+// Log the bandwidth used (server)
+void FlockReplication::ReportStats()
+{
+	// Average over the clients
+	const Vector<SharedPtr<Connection> >& connections = scene_->GetSubsystem<Network>()->GetClientConnections();
+	unsigned numClients = connections.Size();
+	bytesPerClient_ = numClients ? bytesSent_ / (float)numClients / statsTimer_ : 0.0f;
+
+	// The whole connection, to compare with scene replication
+	if (numClients)
+	{
+		float connectionBytes = 0.0f;
+		for (unsigned i = 0; i < numClients; ++i)
+			connectionBytes += connections[i]->GetBytesOutPerSec();
+		char text[160];
+		snprintf(text, sizeof(text), "Flock channel %.0f bytes/s per client, connection total %.0f bytes/s per client",
+			bytesPerClient_, connectionBytes / numClients);
+		URHO3D_LOGINFO(text);
+	}
+
+	// Start the next measurement
+	statsTimer_ = 0.0f;
+	bytesSent_ = 0;
+}
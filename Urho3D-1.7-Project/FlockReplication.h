@@ -0,0 +1,221 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Network/Connection.h>
+#include "BoidSet.h"
+#include "SnapshotBuffer.h"
+
+// Network message IDs of the flock channel (above the engine's own messages)
+const int MSG_FLOCKSNAPSHOT = 0x60;
+const int MSG_FLOCKACK = 0x61;
+
+// Default number of flock snapshots sent each second
+const float FLOCK_SNAPSHOT_RATE = 20.0f;
+
+// Number of snapshots kept to delta against
+const unsigned FLOCK_HISTORY = 32;
+
+// Half size of the quantised world - the boids are clamped inside it
+const float FLOCK_WORLD_EXTENT = 256.0f;
+
+// Seconds between bandwidth reports in the log
+const float FLOCK_STATS_INTERVAL = 5.0f;
+
+// Default area of interest of a client - all boids within the radius, and the boids within
+// the view range inside the view cone (half angle in degrees) of the client's camera
+const float FLOCK_INTEREST_RADIUS = 80.0f;
+const float FLOCK_VIEW_RANGE = 300.0f;
+const float FLOCK_VIEW_ANGLE = 50.0f;
+
+// Distances past which a boid is only sent every second and every fourth snapshot
+const float FLOCK_MID_DISTANCE = 60.0f;
+const float FLOCK_FAR_DISTANCE = 150.0f;
+
+// Size of a cell of the grid the clients' areas are looked up in, and the cells along an axis
+const float FLOCK_GRID_CELL = 32.0f;
+const int FLOCK_GRID_SIZE = 16;
+
+// Flock replication class
+// - The server keeps its boids local and sends packed snapshots to each client instead
+// - Positions are quantised to 16 bits per axis, the heading to a yaw and pitch byte
+//   taken from the velocity (boids always face along their velocity)
+// - Each snapshot is a delta against the last snapshot the client acknowledged: only the
+//   boids that changed are written, as a small position delta where it fits
+// - Snapshots are sent unreliable, so a lost one is simply replaced by the next
+// - Clients build local boid nodes (with a kinematic body for targeting) from the snapshots,
+//   and draw them a short delay behind the server's clock from a snapshot buffer
+// - Each client is only sent the boids in its area of interest, taken from the camera position
+//   and rotation it sends each physics step. Distant boids are sent at a lower rate. Boids that
+//   leave the area are hidden on the client and sent whole when they come back
+// - The boids are put in a grid once a snapshot, and each client's area is looked up in it, so
+//   the server only visits the boids near each client; a client's snapshot holds only the boids
+//   in its area, and only the boids that changed, came in or left are written - by their index
+class FlockReplication
+{
+public:
+	// Constructor
+	FlockReplication() :
+		server_(false),
+		sendInterval_(1.0f / FLOCK_SNAPSHOT_RATE),
+		sendTimer_(0.0f),
+		sequence_(0),
+		lastReceived_(0),
+		statsTimer_(0.0f),
+		bytesSent_(0),
+		bytesPerClient_(0.0f),
+		lastSnapshotSize_(0)
+	{}
+
+	// Initialise the server side
+	void InitialiseServer(Scene* scene);
+
+	// Initialise the client side
+	void InitialiseClient(ResourceCache* cache, Scene* scene);
+
+	// Add a set of boids to be sent (server)
+	void AddBoidSet(BoidSet* boidSet);
+
+	// Forget the boid sets, the history and any client boid nodes
+	void Clear();
+
+	// Update - called each frame after the flock state has been refreshed (server), or to
+	// move the client boid nodes along the buffered snapshots (client)
+	void Update(float timeStep);
+
+	// Handle a network message, returns true if it belonged to the flock channel
+	bool HandleMessage(Connection* connection, int msgID, MemoryBuffer& message);
+
+	// Forget a client that has disconnected (server)
+	void RemoveConnection(Connection* connection);
+
+	// Set the number of snapshots sent each second
+	void SetSnapshotRate(float rate);
+
+	// Set the area of interest of the clients
+	void SetInterest(float radius, float viewRange, float viewAngle);
+
+	// Set the delay the client boids are drawn at and their longest extrapolation (client)
+	void SetInterpolation(float delay, float maxExtrapolation);
+
+	// The buffered snapshots, for their jitter and buffer statistics (client)
+	SnapshotBuffer& GetSnapshotBuffer();
+
+	// Flock channel bytes sent to each client per second (server)
+	float GetBytesPerClient();
+
+	// Size in bytes of the last snapshot sent or received
+	unsigned GetLastSnapshotSize();
+
+private:
+	// Quantised state of one boid
+	struct BoidState
+	{
+		unsigned short x_, y_, z_;
+		unsigned char yaw_, pitch_;
+		unsigned char type_, alive_;
+	};
+
+	// A snapshot of the flock - the whole flock (server), or the boids a client was sent, by
+	// index in order
+	struct Snapshot
+	{
+		unsigned sequence_ = 0;
+		unsigned numBoids_ = 0;
+		std::vector<unsigned> indices_;
+		std::vector<BoidState> boids_;
+	};
+
+	// What a client has been sent (server)
+	struct ClientView
+	{
+		unsigned acked_ = 0;
+		Snapshot history_[FLOCK_HISTORY];
+	};
+
+	// Build the next snapshot from the flock state, and the grid of its boids (server)
+	void TakeSnapshot();
+
+	// Add the boids in the grid cells the box touches to the candidates, once each (server)
+	void QueryGrid(const Vector3& min, const Vector3& max);
+
+	// Build what a client is sent of the snapshot - its area of interest at its update rates (server)
+	void BuildView(Connection* connection, const Snapshot* base, Snapshot& view);
+
+	// Write a snapshot, as a delta against the base when there is one (server)
+	void WriteSnapshot(VectorBuffer& message, const Snapshot& snapshot, const Snapshot* base);
+
+	// Read a snapshot and apply it to the client boid nodes (client)
+	void ReadSnapshot(Connection* connection, MemoryBuffer& message);
+
+	// Buffer the state of a client boid, creating its node if needed (client)
+	void ApplyState(unsigned index, float sendTime, const BoidState& state);
+
+	// Move the client boid nodes to the buffered states (client)
+	void UpdateClient(float timeStep);
+
+	// The snapshot held in a history for a sequence number, or null when it has gone
+	Snapshot* FindSnapshot(Snapshot* history, unsigned sequence);
+
+	// Log the bandwidth used (server)
+	void ReportStats();
+
+	// Server or client side
+	bool server_;
+
+	// Scene and cache
+	Scene* scene_ = nullptr;
+	ResourceCache* cache_ = nullptr;
+
+	// The boid sets sent (server)
+	std::vector<BoidSet*> sets_;
+
+	// Latest snapshot of the flock and the boid positions it was taken from (server)
+	Snapshot current_;
+	std::vector<Vector3> positions_;
+
+	// Grid of the live boids - each cell's first entry in the boid list, and the boids by cell (server)
+	std::vector<unsigned> gridStarts_;
+	std::vector<unsigned> gridBoids_;
+	std::vector<unsigned> boidCells_;
+
+	// Boids near a client's area, and the query each boid was last added by (server)
+	std::vector<unsigned> candidates_;
+	std::vector<unsigned> stamps_;
+	unsigned stamp_ = 0;
+
+	// What each client has been sent and has acknowledged (server)
+	HashMap<Connection*, ClientView> clients_;
+
+	// Recent snapshots received (client)
+	Snapshot history_[FLOCK_HISTORY];
+
+	// Area of interest
+	float interestRadius_ = FLOCK_INTEREST_RADIUS;
+	float viewRange_ = FLOCK_VIEW_RANGE;
+	float viewAngle_ = FLOCK_VIEW_ANGLE;
+
+	// Client boid nodes, one per boid (client)
+	std::vector<WeakPtr<Node> > clientNodes_;
+
+	// Received boid states and the local clock they are drawn by (client)
+	SnapshotBuffer buffer_;
+	float clientTime_ = 0.0f;
+
+	// Send rate
+	float sendInterval_;
+	float sendTimer_;
+
+	// Sequence number of the last snapshot sent (server)
+	unsigned sequence_;
+
+	// Sequence number of the last snapshot applied (client)
+	unsigned lastReceived_;
+
+	// Bandwidth measurement
+	float statsTimer_;
+	unsigned bytesSent_;
+	float bytesPerClient_;
+	unsigned lastSnapshotSize_;
+};
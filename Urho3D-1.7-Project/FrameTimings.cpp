@@ -0,0 +1,274 @@
+// Include directives
+#include <cstdio>
+#include <cstring>
+#include <Urho3D/IO/Log.h>
+#include "FrameTimings.h"
+
+
+// Forget every time
+void TimingHistogram::Reset()
+{
+	for (unsigned i = 0; i < TIMING_BUCKETS; i++)
+		counts_[i] = 0;
+	count_ = 0;
+	max_ = 0;
+}
+
+
+// Count a time
+void TimingHistogram::Record(long long usec)
+{
+	counts_[BucketOf(usec)]++;
+	count_++;
+	max_ = Max(max_, usec);
+}
+
+
+// Number of times counted
+unsigned TimingHistogram::GetCount() const
+{
+	return count_;
+}
+
+
+// Time below which the fraction of the times fall
+long long TimingHistogram::GetPercentile(float fraction) const
+{
+	// Nothing counted
+	if (!count_)
+		return 0;
+
+	// Walk the buckets up to the count wanted
+	unsigned wanted = Max((unsigned)CeilToInt(fraction * count_), 1u);
+	unsigned counted = 0;
+	for (unsigned i = 0; i < TIMING_BUCKETS; i++)
+	{
+		counted += counts_[i];
+		if (counted >= wanted)
+			return Min(ValueOf(i), max_);
+	}
+	return max_;
+}
+
+
+// Longest time counted
+long long TimingHistogram::GetMax() const
+{
+	return max_;
+}
+
+
+// Bucket of a time
+unsigned TimingHistogram::BucketOf(long long usec)
+{
+	// Exact below 32
+	if (usec < 32)
+		return (unsigned)Max(usec, 0LL);
+
+	// Then 16 buckets to each doubling
+	unsigned shift = 0;
+	while ((usec >> shift) >= 32)
+		shift++;
+	return Min(16 * shift + (unsigned)(usec >> shift), TIMING_BUCKETS - 1);
+}
+
+
+// The longest time in a bucket
+long long TimingHistogram::ValueOf(unsigned bucket)
+{
+	if (bucket < 32)
+		return bucket;
+	unsigned shift = bucket / 16 - 1;
+	long long step = bucket - 16 * shift;
+	return ((step + 1) << shift) - 1;
+}
+
+
+// Constructor
+FrameTimings::FrameTimings() :
+	numStages_(0),
+	current_(0),
+	frameNumber_(0),
+	frameStart_(0),
+	hitchThreshold_((long long)(TIMING_HITCH_THRESHOLD * 1000000.0f)),
+	lastHitch_(0),
+	fps_(0.0f),
+	fpsFrames_(0),
+	fpsStart_(0)
+{
+	for (unsigned i = 0; i < TIMING_HITCH_FRAMES; i++)
+		recent_[i] = FrameRecord();
+}
+
+
+// Index of a stage by name - adds it the first time
+unsigned FrameTimings::AddStage(const char* name)
+{
+	// Already added
+	for (unsigned i = 0; i < numStages_; i++)
+	{
+		if (!strcmp(names_[i], name))
+			return i;
+	}
+
+	// No room - time it as the last stage
+	if (numStages_ == TIMING_MAX_STAGES)
+		return TIMING_MAX_STAGES - 1;
+
+	// Add it
+	names_[numStages_] = name;
+	return numStages_++;
+}
+
+
+// Set the frame time counted as a hitch (seconds)
+void FrameTimings::SetHitchThreshold(float threshold)
+{
+	hitchThreshold_ = (long long)(threshold * 1000000.0f);
+}
+
+
+// End the last frame and start the next - called at the beginning of each frame
+void FrameTimings::BeginFrame()
+{
+	long long now = timer_.GetUSec(false);
+
+	// End the frame - the first call only starts the clock
+	if (frameNumber_)
+	{
+		FrameRecord& record = recent_[current_];
+		record.time_ = now - frameStart_;
+
+		// Count the frame and the stages that ran in it
+		frame_.Record(record.time_);
+		for (unsigned i = 0; i < numStages_; i++)
+		{
+			if (record.ran_ & (1u << i))
+				stages_[i].Record(record.stages_[i]);
+		}
+
+		// A hitch - log the frames leading up to it, unless one was just logged
+		if (record.time_ > hitchThreshold_ && frameNumber_ - lastHitch_ > TIMING_HITCH_FRAMES)
+		{
+			LogHitch();
+			lastHitch_ = frameNumber_;
+		}
+
+		// Frame rate over the last second
+		fpsFrames_++;
+		if (now - fpsStart_ >= 1000000)
+		{
+			fps_ = fpsFrames_ * 1000000.0f / (now - fpsStart_);
+			fpsFrames_ = 0;
+			fpsStart_ = now;
+		}
+	}
+	else
+		fpsStart_ = now;
+
+	// Start the next frame over the oldest
+	frameNumber_++;
+	current_ = (current_ + 1) % TIMING_HITCH_FRAMES;
+	FrameRecord& next = recent_[current_];
+	next.number_ = frameNumber_;
+	next.time_ = 0;
+	next.ran_ = 0;
+	frameStart_ = now;
+}
+
+
+// Start timing a stage
+long long FrameTimings::BeginStage()
+{
+	return timer_.GetUSec(false);
+}
+
+
+// Add the time of a stage to the current frame - a stage may run several times in a frame
+void FrameTimings::EndStage(unsigned stage, long long start)
+{
+	FrameRecord& record = recent_[current_];
+	long long time = timer_.GetUSec(false) - start;
+	if (record.ran_ & (1u << stage))
+		record.stages_[stage] += time;
+	else
+	{
+		record.stages_[stage] = time;
+		record.ran_ |= 1u << stage;
+	}
+}
+
+
+// Frames each second, over the last second
+float FrameTimings::GetFps() const
+{
+	return fps_;
+}
+
+
+// The percentiles of the frame and each stage, a line each
+String FrameTimings::GetReport() const
+{
+	String report;
+	char line[160];
+
+	// Whole frame
+	snprintf(line, sizeof(line), "%-24s p50 %7.2f  p95 %7.2f  p99 %7.2f  max %7.2f ms  (%u frames)",
+		"Frame", frame_.GetPercentile(0.5f) / 1000.0f, frame_.GetPercentile(0.95f) / 1000.0f,
+		frame_.GetPercentile(0.99f) / 1000.0f, frame_.GetMax() / 1000.0f, frame_.GetCount());
+	report += line;
+
+	// Each stage
+	for (unsigned i = 0; i < numStages_; i++)
+	{
+		const TimingHistogram& stage = stages_[i];
+		snprintf(line, sizeof(line), "\n%-24s p50 %7.2f  p95 %7.2f  p99 %7.2f  max %7.2f ms  (%u frames)",
+			names_[i], stage.GetPercentile(0.5f) / 1000.0f, stage.GetPercentile(0.95f) / 1000.0f,
+			stage.GetPercentile(0.99f) / 1000.0f, stage.GetMax() / 1000.0f, stage.GetCount());
+		report += line;
+	}
+	return report;
+}
+
+
+// Forget the times
+void FrameTimings::Reset()
+{
+	frame_.Reset();
+	for (unsigned i = 0; i < numStages_; i++)
+		stages_[i].Reset();
+}
+
+
+// Log the breakdown of the recent frames
+void FrameTimings::LogHitch()
+{
+	char text[160];
+
+	// The hitch
+	const FrameRecord& hitch = recent_[current_];
+	snprintf(text, sizeof(text), "Hitch: frame %u took %.2f ms, the last %u frames:", hitch.number_, hitch.time_ / 1000.0f, TIMING_HITCH_FRAMES);
+	URHO3D_LOGWARNING(text);
+
+	// Oldest frame first
+	for (unsigned i = 1; i <= TIMING_HITCH_FRAMES; i++)
+	{
+		// Not timed yet
+		const FrameRecord& record = recent_[(current_ + i) % TIMING_HITCH_FRAMES];
+		if (!record.number_)
+			continue;
+
+		// The frame and its stages
+		snprintf(text, sizeof(text), "  frame %u: %.2f ms", record.number_, record.time_ / 1000.0f);
+		String line(text);
+		for (unsigned j = 0; j < numStages_; j++)
+		{
+			if (record.ran_ & (1u << j))
+			{
+				snprintf(text, sizeof(text), ", %s %.2f", names_[j], record.stages_[j] / 1000.0f);
+				line += text;
+			}
+		}
+		URHO3D_LOGWARNING(line);
+	}
+}
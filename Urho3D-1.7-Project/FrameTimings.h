@@ -0,0 +1,129 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Core/Timer.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Most stages timed
+const unsigned TIMING_MAX_STAGES = 16;
+
+// Frames whose breakdown is logged when a frame hitches
+const unsigned TIMING_HITCH_FRAMES = 10;
+
+// Default frame time counted as a hitch (seconds)
+const float TIMING_HITCH_THRESHOLD = 0.033f;
+
+// Buckets of a histogram - 16 to each doubling of the time, up to several minutes
+const unsigned TIMING_BUCKETS = 400;
+
+// Timing histogram class
+// - Counts times (microseconds) in log-linear buckets, as a HDR histogram does: exact below
+//   32 us, then 16 buckets to each doubling, so any percentile is within about 6%
+// - Fixed size, so recording is a few shifts and an increment
+class TimingHistogram
+{
+public:
+	// Constructor
+	TimingHistogram() { Reset(); }
+
+	// Forget every time
+	void Reset();
+
+	// Count a time
+	void Record(long long usec);
+
+	// Number of times counted
+	unsigned GetCount() const;
+
+	// Time below which the fraction of the times fall
+	long long GetPercentile(float fraction) const;
+
+	// Longest time counted
+	long long GetMax() const;
+
+private:
+	// Bucket of a time, and the longest time in a bucket
+	static unsigned BucketOf(long long usec);
+	static long long ValueOf(unsigned bucket);
+
+	// Count of each bucket
+	unsigned counts_[TIMING_BUCKETS];
+
+	// Times counted and the longest
+	unsigned count_;
+	long long max_;
+};
+
+// Frame timings class
+// - Always on: times the whole frame and each named stage of it into histograms
+// - Keeps the breakdown of the last TIMING_HITCH_FRAMES frames and logs it when a frame takes
+//   longer than the hitch threshold, so a hitch can be put down to a stage
+// - Reports the p50, p95, p99 and longest times of the frame and of each stage
+class FrameTimings
+{
+public:
+	// Constructor
+	FrameTimings();
+
+	// Index of a stage by name - adds it the first time
+	unsigned AddStage(const char* name);
+
+	// Set the frame time counted as a hitch (seconds)
+	void SetHitchThreshold(float threshold);
+
+	// End the last frame and start the next - called at the beginning of each frame
+	void BeginFrame();
+
+	// Time a stage - BeginStage returns the start to pass to EndStage
+	long long BeginStage();
+	void EndStage(unsigned stage, long long start);
+
+	// Frames each second, over the last second
+	float GetFps() const;
+
+	// The percentiles of the frame and each stage, a line each
+	String GetReport() const;
+
+	// Forget the times
+	void Reset();
+
+private:
+	// Time of a frame and of each stage in it (microseconds)
+	struct FrameRecord
+	{
+		unsigned number_;
+		long long time_;
+		long long stages_[TIMING_MAX_STAGES];
+		unsigned ran_;
+	};
+
+	// Log the breakdown of the recent frames
+	void LogHitch();
+
+	// Stage names and histograms, and the frame histogram
+	const char* names_[TIMING_MAX_STAGES];
+	TimingHistogram stages_[TIMING_MAX_STAGES];
+	unsigned numStages_;
+	TimingHistogram frame_;
+
+	// Recent frames, the one being timed last
+	FrameRecord recent_[TIMING_HITCH_FRAMES];
+	unsigned current_;
+	unsigned frameNumber_;
+
+	// Clock and the start of the frame (microseconds)
+	HiresTimer timer_;
+	long long frameStart_;
+
+	// Hitch threshold (microseconds) and the frame of the last hitch logged
+	long long hitchThreshold_;
+	unsigned lastHitch_;
+
+	// Frame rate
+	float fps_;
+	unsigned fpsFrames_;
+	long long fpsStart_;
+};
@@ -0,0 +1,232 @@
+// Include directives
+#include <cstdio>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include "FrameTrace.h"
+
+
+// Destructor
+FrameTrace::~FrameTrace()
+{
+	Thread::Stop();
+}
+
+
+// Start recording - the trace is written to the file
+void FrameTrace::Initialise(Context* context, const String& fileName)
+{
+	context_ = context;
+	fileName_ = fileName;
+	enabled_ = !fileName.Empty();
+
+	// Storage for the whole window and its copy up front
+	Thread::Stop();
+	frames_.clear();
+	pendingWindow_.clear();
+	pending_ = false;
+	if (enabled_)
+	{
+		frames_.resize(TRACE_FRAMES);
+		pendingWindow_.resize(TRACE_FRAMES);
+	}
+
+	// Start on the first frame
+	current_ = 0;
+	numFrames_ = 1;
+	frameNumber_ = 0;
+	depth_ = 0;
+	timer_.Reset();
+	lastWrite_ = 0;
+	if (enabled_)
+	{
+		frames_[0].number_ = 0;
+		frames_[0].start_ = 0;
+		frames_[0].end_ = -1;
+		frames_[0].numScopes_ = 0;
+		Run();
+	}
+}
+
+
+// Is the trace being recorded
+bool FrameTrace::IsEnabled()
+{
+	return enabled_;
+}
+
+
+// End the last frame and start the next - called at the beginning of each frame
+void FrameTrace::BeginFrame()
+{
+	// Not recording
+	if (!enabled_)
+		return;
+
+	// End the frame
+	long long now = timer_.GetUSec(false);
+	Frame& frame = frames_[current_];
+	frame.end_ = now;
+
+	// A slow frame - have the window it is in written, if one has not been written lately
+	if (frame.end_ - frame.start_ > (long long)(TRACE_SLOW_FRAME * 1000000.0f) &&
+		(!lastWrite_ || now - lastWrite_ > (long long)(TRACE_MIN_INTERVAL * 1000000.0f)))
+	{
+		char text[64];
+		snprintf(text, sizeof(text), "Frame %u took %.1f ms", frame.number_, (frame.end_ - frame.start_) / 1000.0f);
+		URHO3D_LOGWARNING(text);
+		if (QueueWrite())
+			lastWrite_ = now;
+	}
+
+	// Start the next one over the oldest
+	current_ = (current_ + 1) % TRACE_FRAMES;
+	numFrames_ = Min(numFrames_ + 1, TRACE_FRAMES);
+	Frame& next = frames_[current_];
+	next.number_ = ++frameNumber_;
+	next.start_ = now;
+	next.end_ = -1;
+	next.numScopes_ = 0;
+	depth_ = 0;
+}
+
+
+// Open a scope of the current frame - returns the scope's index
+unsigned FrameTrace::BeginScope(const char* name)
+{
+	// Not recording, or the frame is full
+	if (!enabled_)
+		return M_MAX_UNSIGNED;
+	Frame& frame = frames_[current_];
+	if (frame.numScopes_ == TRACE_MAX_SCOPES)
+		return M_MAX_UNSIGNED;
+
+	// Start the scope
+	Scope& scope = frame.scopes_[frame.numScopes_];
+	scope.name_ = name;
+	scope.start_ = timer_.GetUSec(false);
+	scope.end_ = -1;
+	depth_++;
+	return frame.numScopes_++;
+}
+
+
+// Close a scope of the current frame
+void FrameTrace::EndScope(unsigned index)
+{
+	// Dropped scope, or opened on an earlier frame
+	if (index == M_MAX_UNSIGNED || !depth_)
+		return;
+
+	// End it
+	frames_[current_].scopes_[index].end_ = timer_.GetUSec(false);
+	depth_--;
+}
+
+
+// Write the frames held to the file - at once, on the calling thread
+bool FrameTrace::Write()
+{
+	// Not recording
+	if (!enabled_)
+		return false;
+
+	// Let a write in progress finish first, so it doesn't overwrite this one, then carry on
+	Thread::Stop();
+	bool written = WriteFrames(frames_, current_, numFrames_);
+	Run();
+	return written;
+}
+
+
+// Write the copied window - runs on the trace's thread
+void FrameTrace::ThreadFunction()
+{
+	for (;;)
+	{
+		// A window to write
+		bool pending;
+		{
+			MutexLock lock(mutex_);
+			pending = pending_;
+		}
+		if (pending)
+		{
+			WriteFrames(pendingWindow_, pendingCurrent_, pendingFrames_);
+			MutexLock lock(mutex_);
+			pending_ = false;
+			continue;
+		}
+
+		// Nothing left and told to stop
+		if (!shouldRun_)
+			break;
+		Time::Sleep(1);
+	}
+}
+
+
+// Hand a copy of the window to the trace's thread - false if it is still writing the last one
+bool FrameTrace::QueueWrite()
+{
+	MutexLock lock(mutex_);
+	if (pending_)
+		return false;
+
+	// Copy into the storage made up front - no allocation
+	pendingWindow_ = frames_;
+	pendingCurrent_ = current_;
+	pendingFrames_ = numFrames_;
+	pending_ = true;
+	return true;
+}
+
+
+// Build the JSON of a window of frames and write it to the file
+bool FrameTrace::WriteFrames(const std::vector<Frame>& frames, unsigned current, unsigned numFrames)
+{
+	// One complete ("X") event for each ended frame and each closed scope, oldest frame first
+	String json;
+	json.Reserve(numFrames * 512);
+	json += "{\"traceEvents\":[\n";
+	char event[256];
+	unsigned numWritten = 0;
+	unsigned oldest = (current + 1 + TRACE_FRAMES - numFrames) % TRACE_FRAMES;
+	for (unsigned i = 0; i < numFrames; i++)
+	{
+		// The frame - the current one is written only if it has ended
+		const Frame& frame = frames[(oldest + i) % TRACE_FRAMES];
+		if (frame.end_ < 0)
+			continue;
+		snprintf(event, sizeof(event), "%s{\"name\":\"Frame %u\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":1}",
+			numWritten ? ",\n" : "", frame.number_, frame.start_, frame.end_ - frame.start_);
+		json += event;
+		numWritten++;
+
+		// Its scopes - nested scopes nest by time
+		for (unsigned j = 0; j < frame.numScopes_; j++)
+		{
+			const Scope& scope = frame.scopes_[j];
+			if (scope.end_ < 0)
+				continue;
+			snprintf(event, sizeof(event), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":1}",
+				scope.name_, scope.start_, scope.end_ - scope.start_);
+			json += event;
+		}
+	}
+	json += "\n]}\n";
+
+	// Nothing has ended yet
+	if (!numWritten)
+		return false;
+
+	// Write the file
+	File file(context_, fileName_, FILE_WRITE);
+	if (!file.IsOpen())
+	{
+		URHO3D_LOGERRORF("Could not write the frame trace to %s", fileName_.CString());
+		return false;
+	}
+	file.Write(json.CString(), json.Length());
+	URHO3D_LOGINFOF("Wrote %u frames of trace to %s", numWritten, fileName_.CString());
+	return true;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+// Include directives
+#include <vector>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Core/Profiler.h>
+#include <Urho3D/Core/Thread.h>
+#include <Urho3D/Core/Timer.h>
+#include "FrameTimings.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Number of frames kept for the trace
+const unsigned TRACE_FRAMES = 300;
+
+// Most scopes recorded in one frame - any more are dropped
+const unsigned TRACE_MAX_SCOPES = 64;
+
+// A frame slower than this writes the trace (seconds)
+const float TRACE_SLOW_FRAME = 0.05f;
+
+// Shortest time between two traces written for slow frames (seconds)
+const float TRACE_MIN_INTERVAL = 10.0f;
+
+// Frame trace class
+// - Records named scopes of the main thread over a rolling window of the last TRACE_FRAMES
+//   frames, in fixed storage, so recording costs two timer reads a scope
+// - Writes the window as a Chrome trace (JSON) that chrome://tracing and Perfetto open,
+//   when a frame is slower than TRACE_SLOW_FRAME and at shutdown
+// - A slow frame only copies the window into a second buffer; the trace's own thread builds
+//   the JSON and writes the file, so the hitch being traced is not made worse by the write
+// - Needs no graphics, so it also runs on a dedicated server and on the bots
+class FrameTrace : public Thread
+{
+public:
+	// Constructor
+	FrameTrace() :
+		context_(nullptr),
+		enabled_(false),
+		current_(0),
+		numFrames_(0),
+		frameNumber_(0),
+		depth_(0),
+		lastWrite_(0),
+		pending_(false),
+		pendingCurrent_(0),
+		pendingFrames_(0)
+	{}
+
+	// Destructor
+	~FrameTrace();
+
+	// Start recording - the trace is written to the file
+	void Initialise(Context* context, const String& fileName);
+
+	// Is the trace being recorded
+	bool IsEnabled();
+
+	// End the last frame and start the next - called at the beginning of each frame
+	void BeginFrame();
+
+	// Open and close a scope of the current frame - returns the scope's index
+	unsigned BeginScope(const char* name);
+	void EndScope(unsigned index);
+
+	// Write the frames held to the file - at once, on the calling thread
+	bool Write();
+
+	// Write the copied window - runs on the trace's thread
+	virtual void ThreadFunction() override;
+
+private:
+	// A timed scope
+	struct Scope
+	{
+		const char* name_;
+		long long start_;
+		long long end_;
+	};
+
+	// The scopes of a frame
+	struct Frame
+	{
+		unsigned number_;
+		long long start_;
+		long long end_;
+		unsigned numScopes_;
+		Scope scopes_[TRACE_MAX_SCOPES];
+	};
+
+	// Hand a copy of the window to the trace's thread - false if it is still writing the last one
+	bool QueueWrite();
+
+	// Build the JSON of a window of frames and write it to the file
+	bool WriteFrames(const std::vector<Frame>& frames, unsigned current, unsigned numFrames);
+
+	// Context for writing the file
+	Context* context_;
+
+	// Output file
+	String fileName_;
+	bool enabled_;
+
+	// Rolling window of frames and the one being recorded
+	std::vector<Frame> frames_;
+	unsigned current_;
+	unsigned numFrames_;
+	unsigned frameNumber_;
+
+	// Scopes open on the current frame
+	unsigned depth_;
+
+	// Time since recording started, and of the last write (microseconds)
+	HiresTimer timer_;
+	long long lastWrite_;
+
+	// Copy of the window waiting for the trace's thread, and whether there is one
+	std::vector<Frame> pendingWindow_;
+	bool pending_;
+	unsigned pendingCurrent_;
+	unsigned pendingFrames_;
+	Mutex mutex_;
+};
+
+// Times a scope for the frame trace and the frame timings until it goes out of scope
+class TraceScope
+{
+public:
+	// Constructor - opens the scope
+	TraceScope(FrameTrace& trace, FrameTimings& timings, unsigned stage, const char* name) :
+		trace_(trace),
+		index_(trace.BeginScope(name)),
+		timings_(timings),
+		stage_(stage),
+		start_(timings.BeginStage())
+	{}
+
+	// Destructor - closes it
+	~TraceScope()
+	{
+		timings_.EndStage(stage_, start_);
+		trace_.EndScope(index_);
+	}
+
+private:
+	// The trace and the scope's index in the frame
+	FrameTrace& trace_;
+	unsigned index_;
+
+	// The timings, the stage and its start
+	FrameTimings& timings_;
+	unsigned stage_;
+	long long start_;
+};
+
+// Profile a stage with the engine's profiler (when built with it), the frame trace and the frame timings
+#define TRACE_SCOPE(name) \
+	URHO3D_PROFILE(name); \
+	static const unsigned traceStage_ ## name = frameTimings_.AddStage(#name); \
+	TraceScope traceScope_ ## name(frameTrace_, frameTimings_, traceStage_ ## name, #name)
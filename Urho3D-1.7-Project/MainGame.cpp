@@ -1,8 +1,13 @@
 // Inculude directives
+#include <cstdio>
 #include <Urho3D/Core/CoreEvents.h>
 #include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Engine/Console.h>
+#include <Urho3D/Engine/DebugHud.h>
 #include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Engine/EngineEvents.h>
 #include <Urho3D/Graphics/DebugRenderer.h>
+#include <Urho3D/Graphics/GraphicsEvents.h>
 #include <Urho3D/Graphics/Camera.h>
 #include <Urho3D/Graphics/Light.h>
 #include <Urho3D/Graphics/Material.h>
@@ -14,6 +19,7 @@
 #include <Urho3D/Graphics/Zone.h>
 #include <Urho3D/Graphics/Terrain.h>
 #include <Urho3D/Input/Input.h>
+#include <Urho3D/IO/File.h>
 #include <Urho3D/IO/FileSystem.h>
 #include <Urho3D/IO/Log.h>
 #include <Urho3D/Physics/CollisionShape.h>
@@ -31,10 +37,13 @@
 #include <Urho3D/UI/Window.h>
 #include <Urho3D/UI/CheckBox.h>
 #include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
 #include <Urho3D/DebugNew.h>
 #include <Urho3D/Network/Connection.h>
 #include <Urho3D/Network/Network.h>
 #include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Network/NetworkPriority.h>
+#include <Urho3D/Scene/SceneEvents.h>
 #include <Urho3D/Audio/Audio.h>
 #include <Urho3D/Audio/AudioEvents.h>
 #include <Urho3D/Audio/Sound.h>
@@ -44,12 +53,23 @@
 #include <string>
 #include <chrono>
 #include "MainGame.h"
+#include "FlockRenderer.h"
 
 using namespace std::chrono;
 
 // Which port this is running on
 static const unsigned short SERVER_PORT = 2345;
 
+// Name of this program, to launch the bots (TARGET_NAME in CMakeLists.txt)
+static const String BOT_PROGRAM("Project");
+
+// Context of the work queue tasks of the server's physics pre-step
+struct PlayerTask
+{
+	MainGame* game_;
+	float timeStep_;
+};
+
 // Custom remote event we use to tell the client which object they control
 static const StringHash E_CLIENTOBJECTID("ClientObjectID");
 
@@ -62,13 +82,6 @@ static const StringHash E_CLIENTISREADY("ClientReadyToStart");
 // String for thr controls
 static const String CONTROLS("controlsText");
 
-// Movement controls
-static const unsigned CTRL_FORWARD	= 1;
-static const unsigned CTRL_BACK		= 2;
-static const unsigned CTRL_LEFT		= 4;
-static const unsigned CTRL_RIGHT	= 8;
-static const unsigned CTRL_FIRE		= 16;
-
 // URHO3D define
 URHO3D_DEFINE_APPLICATION_MAIN(MainGame)
 
@@ -85,7 +98,23 @@ MainGame::MainGame(Context* context)
 	copy_(true),
 	limit_(true),
 	updateHalf_(true),
+	useInstancing_(false),
+	useFlockChannel_(true),
+	useLockstep_(false),
+	seed_(Time::GetSystemTime()),
+	dedicatedServer_(false),
+	tickRate_(SERVER_TICK_RATE),
+	flockCheck_(false),
+	missileCheck_(false),
+	botMode_(false),
+	botCount_(0),
+	botID_(0),
+	botBehaviour_(BOT_RANDOM),
+	serverAddress_("localhost"),
+	bandwidthTime_(0.0f),
+	hitchThreshold_(TIMING_HITCH_THRESHOLD),
 	numbOfBoids_(100),
+	shadowCasterBudget_(BOID_SHADOW_CASTERS),
 	speed_(30.0f),
 	rotationSpeed_(0.1f),
 	speedMultiplier_(1.75f),
@@ -93,25 +122,225 @@ MainGame::MainGame(Context* context)
 	kills_(0),
 	fireTimer_(0.5f),
 	fireTimerReset_(fireTimer_),
+	interestRadius_(FLOCK_INTEREST_RADIUS),
+	interpolationDelay_(SNAPSHOT_DELAY),
 	uiRoot_(GetSubsystem<UI>()->GetRoot())
 {
 	// Time constructor
 	time = new Time(context);
+
+	// Register the custom components
+	FlockRenderer::RegisterObject(context);
 }
 
 
 // Destructor
 MainGame::~MainGame()
 {
+	// Delete the boid sets, built or not
+	for (auto boidSet : boidSets_)
+		delete boidSet;
+	for (auto boidSet : pendingSets_)
+		delete boidSet;
+}
+
+
+// Setup before engine initialization
+void MainGame::Setup()
+{
+	// Execute base class setup
+	Sample::Setup();
+
+	// Read the settings from the command line
+	ParseArguments();
+
+	// A dedicated server or bot needs no window or sound device
+	if (IsHeadless())
+	{
+		engineParameters_["Headless"] = true;
+		engineParameters_["Sound"] = false;
+	}
+
+	// Each bot logs to its own file
+	if (botMode_)
+		engineParameters_["LogName"] = GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d", "logs") + GetTypeName() + "Bot" + String(botID_) + ".log";
+
+	// Record the frame trace if asked for, and the frame times always
+	frameTrace_.Initialise(context_, traceFile_);
+	frameTimings_.SetHitchThreshold(hitchThreshold_);
+}
+
+
+// Read the settings from the command line
+void MainGame::ParseArguments()
+{
+	// Loop through the arguments
+	const Vector<String>& arguments = GetArguments();
+	for (unsigned i = 0; i < arguments.Size(); ++i)
+	{
+		String argument = arguments[i].ToLower();
+
+		// Number of boids allowed to cast shadows
+		if (argument == "-shadowcasters" && i + 1 < arguments.Size())
+			shadowCasterBudget_ = ToInt(arguments[++i]);
+
+		// Draw each boid set with one instanced batch per model type (1) or a model per boid (0)
+		else if (argument == "-instancing" && i + 1 < arguments.Size())
+			useInstancing_ = ToInt(arguments[++i]) != 0;
+
+		// Send the boids through the flock channel (1) or scene replication (0)
+		else if (argument == "-flockchannel" && i + 1 < arguments.Size())
+			useFlockChannel_ = ToInt(arguments[++i]) != 0;
+
+		// Run the flock in lockstep on the server and the clients
+		else if (argument == "-lockstep")
+			useLockstep_ = true;
+
+		// Seed of the boid sets, for runs that start the same each time
+		else if (argument == "-seed" && i + 1 < arguments.Size())
+			seed_ = ToUInt(arguments[++i]);
+
+		// Radius around each client's camera of the boids it is always sent
+		else if (argument == "-interestradius" && i + 1 < arguments.Size())
+			interestRadius_ = ToFloat(arguments[++i]);
+
+		// Run as a dedicated server, without graphics, audio or UI
+		else if (argument == "-server")
+			dedicatedServer_ = true;
+
+		// Ticks a second of a dedicated server
+		else if (argument == "-tickrate" && i + 1 < arguments.Size())
+			tickRate_ = Max(ToInt(arguments[++i]), 1);
+
+		// Delay remote entities are drawn behind the server (milliseconds)
+		else if (argument == "-interpdelay" && i + 1 < arguments.Size())
+			interpolationDelay_ = ToFloat(arguments[++i]) / 1000.0f;
+
+		// Run as a headless bot client
+		else if (argument == "-bot")
+			botMode_ = true;
+
+		// Number of bot clients to launch
+		else if (argument == "-bots" && i + 1 < arguments.Size())
+			botCount_ = Max(ToInt(arguments[++i]), 0);
+
+		// ID of a bot client - seeds its controls and names its log
+		else if (argument == "-botid" && i + 1 < arguments.Size())
+			botID_ = ToUInt(arguments[++i]);
+
+		// Bots fly a script instead of random controls
+		else if (argument == "-botscript")
+			botBehaviour_ = BOT_SCRIPTED;
+
+		// Measure the bytes sent to each bot for the seconds given, report them and exit
+		else if (argument == "-bandwidth" && i + 1 < arguments.Size())
+			bandwidthTime_ = ToFloat(arguments[++i]);
+
+		// Address of the server to connect to
+		else if (argument == "-address" && i + 1 < arguments.Size())
+			serverAddress_ = arguments[++i];
+
+		// Record a trace of the last frames to the file
+		else if (argument == "-trace" && i + 1 < arguments.Size())
+			traceFile_ = arguments[++i];
+
+		// Frame time counted as a hitch (milliseconds)
+		else if (argument == "-hitch" && i + 1 < arguments.Size())
+			hitchThreshold_ = ToFloat(arguments[++i]) / 1000.0f;
+
+		// Check the flock kernel against the reference flock and exit
+		else if (argument == "-flockcheck")
+			flockCheck_ = true;
+
+		// Check the missiles fly the same path at each frame rate and exit
+		else if (argument == "-missilecheck")
+			missileCheck_ = true;
+
+		// Flock kernel shortcuts - copy a close boid's force, limit the neighbours, update half the flock a frame
+		else if (argument == "-copyrange" && i + 1 < arguments.Size())
+			copy_ = ToInt(arguments[++i]) != 0;
+		else if (argument == "-limitneighbours" && i + 1 < arguments.Size())
+			limit_ = ToInt(arguments[++i]) != 0;
+		else if (argument == "-halfupdate" && i + 1 < arguments.Size())
+			updateHalf_ = ToInt(arguments[++i]) != 0;
+
+		// Record the players of a server session to the file
+		else if (argument == "-record" && i + 1 < arguments.Size())
+			recordFile_ = arguments[++i];
+
+		// Play a recorded session back headless and exit
+		else if (argument == "-replay" && i + 1 < arguments.Size())
+			replayFile_ = arguments[++i];
+
+		// Record the flock's trajectories to the file
+		else if (argument == "-trajectory" && i + 1 < arguments.Size())
+			trajectoryFile_ = arguments[++i];
+
+		// Spawn and retire the flocks following the waves in the XML file
+		else if (argument == "-waves" && i + 1 < arguments.Size())
+			wavesFile_ = arguments[++i];
+
+		// Frame time budget (milliseconds) the quality is adjusted to
+		else if (argument == "-framebudget" && i + 1 < arguments.Size())
+			frameBudget_ = ToFloat(arguments[++i]) / 1000.0f;
+
+		// Write the flock counters of each frame to the CSV file
+		else if (argument == "-flockcsv" && i + 1 < arguments.Size())
+			flockCountersCsv_ = arguments[++i];
+	}
+}
+
+
+// Running without graphics, audio or UI
+bool MainGame::IsHeadless()
+{
+	return dedicatedServer_ || botMode_ || flockCheck_ || missileCheck_ || !replayFile_.Empty();
 }
 
 
 // Start function
 void MainGame::Start()
 {
+	// Flock or missile check - no game at all
+	if (flockCheck_)
+	{
+		RunFlockCheck();
+		return;
+	}
+	if (missileCheck_)
+	{
+		RunMissileCheck();
+		return;
+	}
+
+	// Replay - a server without a network, played from the file
+	if (!replayFile_.Empty())
+	{
+		StartReplay();
+		return;
+	}
+
+	// Dedicated server - none of the sample's window, console or input setup
+	if (dedicatedServer_)
+	{
+		StartDedicatedServer();
+		SpawnBots();
+		return;
+	}
+
+	// Bot client - likewise
+	if (botMode_)
+	{
+		StartBot();
+		return;
+	}
+
 	// Execute base class startup
 	Sample::Start();
 
+	// The console sends its commands to the game
+	GetSubsystem<Console>()->SetCommandInterpreter(GetTypeName());
+
 	// Create the scene
 	CreateScene();
 
@@ -141,6 +370,27 @@ void MainGame::Start()
 
 	// Debug 
 	debug_ = scene_->GetComponent<DebugRenderer>();
+
+	// Launch any bots asked for
+	SpawnBots();
+}
+
+
+// Cleanup after the main loop
+void MainGame::Stop()
+{
+	// Finish the recorded session and trajectories
+	recorder_.Stop();
+	trajectory_.Stop();
+
+	// Write the last frames of the trace
+	frameTrace_.Write();
+
+	// Report the frame times
+	URHO3D_LOGINFO("Frame times:\n" + frameTimings_.GetReport());
+
+	// Execute base class cleanup
+	Sample::Stop();
 }
 
 
@@ -148,6 +398,9 @@ void MainGame::Start()
 void MainGame::SubscribeToEvents()
 {
 	// Subscribe to events
+	SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(MainGame, HandleBeginFrame));
+	SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(MainGame, HandleEndRendering));
+	SubscribeToEvent(E_CONSOLECOMMAND, URHO3D_HANDLER(MainGame, HandleConsoleCommand));
 	SubscribeToEvent(E_PHYSICSPRESTEP, URHO3D_HANDLER(MainGame, HandlePhysicsPreStep));
 	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(MainGame, HandleUpdate));
 	SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(MainGame, HandlePostUpdate));
@@ -157,11 +410,23 @@ void MainGame::SubscribeToEvents()
 	SubscribeToEvent(E_CLIENTSCENELOADED, URHO3D_HANDLER(MainGame, HandleClientFinishedLoading));
 	SubscribeToEvent(E_CLIENTISREADY, URHO3D_HANDLER(MainGame, HandleClientToServerReadyToStart));
 	SubscribeToEvent(E_CLIENTOBJECTID, URHO3D_HANDLER(MainGame, HandleServerToClientObjectID));
+	SubscribeToEvent(E_NETWORKMESSAGE, URHO3D_HANDLER(MainGame, HandleNetworkMessage));
+	SubscribeToEvent(E_NETWORKUPDATE, URHO3D_HANDLER(MainGame, HandleNetworkUpdate));
+	SubscribeToEvent(E_NODEADDED, URHO3D_HANDLER(MainGame, HandleNodeAdded));
+	SubscribeToEvent(E_COMPONENTADDED, URHO3D_HANDLER(MainGame, HandleComponentAdded));
+	SubscribeToEvent(E_INTERCEPTNETWORKUPDATE, URHO3D_HANDLER(MainGame, HandleInterceptNetworkUpdate));
+	SubscribeToEvent(E_SERVERCONNECTED, URHO3D_HANDLER(MainGame, HandleServerConnected));
+	SubscribeToEvent(E_SERVERDISCONNECTED, URHO3D_HANDLER(MainGame, HandleServerDisconnected));
+	SubscribeToEvent(E_CONNECTFAILED, URHO3D_HANDLER(MainGame, HandleServerDisconnected));
 
 	// Register remote events
 	GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTISREADY);
 	GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTOBJECTID);
 
+	// A dedicated server or bot has no menu
+	if (IsHeadless())
+		return;
+
 	// Subscribe to events
 	SubscribeToEvent(pStart_, E_RELEASED, URHO3D_HANDLER(MainGame, HandleStart));
 	SubscribeToEvent(pQuit_, E_RELEASED, URHO3D_HANDLER(MainGame, HandleQuit));
@@ -193,8 +458,9 @@ void MainGame::CreateScene()
 	cameraNode_->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
 	camera->SetFarClip(1000.0f);
 
-	// Configure the viewport via the render subsystem (using the GetSubsystem() function)
-	GetSubsystem<Renderer>()->SetViewport(0, new Viewport(context_, scene_, camera));
+	// Configure the viewport via the render subsystem (using the GetSubsystem() function) - none when headless
+	if (GetSubsystem<Renderer>())
+		GetSubsystem<Renderer>()->SetViewport(0, new Viewport(context_, scene_, camera));
 
 	// Create static scene content. First create a zone for ambient	lighting and fog control
 	// Creates a new node which is a child of the scene
@@ -237,8 +503,9 @@ void MainGame::CreateScene()
 	// Initialise the envirnoment objects
 	InitEnvironmentObjects();
 
-	// Initialise the audio
-	InitAudio();
+	// Initialise the audio - a dedicated server or bot plays nothing
+	if (!IsHeadless())
+		InitAudio();
 }
 
 
@@ -339,6 +606,12 @@ Node* MainGame::CreatePlayer()
 	CollisionShape* shape = node->CreateComponent<CollisionShape>();
 	shape->SetBox(Vector3(0.2f, 0.2f, 1.1f));
 
+	// Distant players are sent to a client less often, but never starved
+	NetworkPriority* priority = node->CreateComponent<NetworkPriority>();
+	priority->SetBasePriority(100.0f);
+	priority->SetDistanceFactor(0.25f);
+	priority->SetMinPriority(25.0f);
+
 	// Create a light for the players ship
 	Node* lightNode = node->CreateChild("Light");
 	lightNode->SetDirection(cameraNode_->GetDirection());
@@ -356,7 +629,6 @@ Node* MainGame::CreatePlayer()
 	// Set the players vars
 	node->SetVar("Health", health_);
 	node->SetVar("Kills", kills_);
-	node->SetVar("FireTimer", fireTimerReset_);
 
 	// Set yaw pitch roll
 	yaw_ = 0.0f;
@@ -460,21 +732,161 @@ void MainGame::InitBoids()
 	// Access the resource cache
 	ResourceCache* cache_ = GetSubsystem<ResourceCache>();
 
+	// The sets of a game before go
+	ClearBoidSets();
+
 	// Get the player
 	Node* player = scene_->GetChild("Player", true);
 
-	// Use grouping on the boids
-	if (useGroups_)
+	// Boids sent through the flock channel, run in lockstep or built by a client are not replicated with the scene
+	CreateMode boidMode = (useFlockChannel_ || useLockstep_ || gameModeNetwork) ? LOCAL : REPLICATED;
+
+	// Each set draws from its own stream of the seed
+	FlockRandom random(seed_);
+	URHO3D_LOGINFOF("Boid seed: %u", seed_);
+
+	// Every boid is a copy of the prefab's template of its model type
+	boidPrefab_.Initialise(cache_, scene_, boidMode);
+
+	// A dedicated server or bot draws nothing
+	if (!IsHeadless())
+	{
+		// Only draw the boids on screen, with a distance based level of detail, and only let the
+		// most visible boids cast shadows - unless each set is drawn with instanced batches
+		if (!useInstancing_)
+		{
+			boidLod_.Initialise(context_, cache_, scene_);
+			shadowBudget_.SetMaxCasters(shadowCasterBudget_);
+		}
+
+		// Hold the frame time to the budget by trading quality around the settings the game runs
+		// with - a flock run at the tick keeps its update phases
+		if (frameBudget_ > 0.0f)
+		{
+			QualityLevel defaults;
+			defaults.simpleDistance_ = boidLod_.GetSimpleDistance();
+			defaults.impostorDistance_ = boidLod_.GetImpostorDistance();
+			defaults.updatePhases_ = updateHalf_ ? 2 : 1;
+			defaults.shadowCasters_ = shadowCasterBudget_;
+			defaults.maxParticles_ = effectsBudget_.GetMaxParticles();
+			defaults.maxTrailSegments_ = effectsBudget_.GetMaxTrailSegments();
+			governor_.Initialise(frameBudget_, defaults, &boidLod_, &shadowBudget_, &effectsBudget_, !IsFlockTicked());
+		}
+	}
+
+	// The wave director's waves - a lockstep flock, and a client's copy of the server's, are left alone
+	bool useWaves = !wavesFile_.Empty() && !useLockstep_ && !gameModeNetwork && waveDirector_.Load(cache_, wavesFile_);
+
+	// Use grouping on the boids - five sets, or one set of every boid
+	int numSets = useGroups_ ? 5 : 1;
+	boidSets_.reserve(numSets + (useWaves ? waveDirector_.GetPoolFlocks() : 0));
+	HiresTimer buildTimer;
+	for (int k = 0; k < numSets; k++)
+	{
+		BoidSet* boidSet = new BoidSet();
+		boidSet->Initialise(boidPrefab_, numbOfBoids_ / numSets, random.Split(k + 1), copy_, limit_, updateHalf_);
+		AddBoidSet(boidSet);
+	}
+
+	// How long the flock took to build
+	char text[100];
+	snprintf(text, sizeof(text), "Built %d boids in %.2f ms", numSets * (numbOfBoids_ / numSets), buildTimer.GetUSec(false) / 1000.0f);
+	URHO3D_LOGINFO(text);
+
+	// The wave director's pool of flocks - built a batch of boids a frame while the game runs
+	if (useWaves)
+	{
+		// Stream 0 is not used by a set
+		waveDirector_.Start(random.Split(0));
+		for (auto boidSet : boidSets_)
+			waveDirector_.AddBoidSet(boidSet, false);
+		for (int k = 0; k < waveDirector_.GetPoolFlocks(); k++)
+		{
+			BoidSet* boidSet = new BoidSet();
+			boidSet->BeginBuild(waveDirector_.GetFlockSize(), random.Split(numSets + k + 1), copy_, limit_, updateHalf_, true);
+			pendingSets_.push_back(boidSet);
+		}
+	}
+}
+
+
+// Hand a built boid set to the game's systems
+void MainGame::AddBoidSet(BoidSet* boidSet)
+{
+	boidSets_.push_back(boidSet);
+
+	// A dedicated server or bot draws nothing
+	if (!IsHeadless())
+	{
+		// Draw the set with one instanced batch per model type
+		if (useInstancing_)
+			boidSet->EnableInstancing(GetSubsystem<ResourceCache>(), scene_);
+
+		// Otherwise through the level of detail, shadow budget and on screen tests
+		else
+		{
+			boidLod_.AddBoidSet(boidSet);
+			shadowBudget_.AddBoidSet(boidSet);
+			visibilitySync_.AddBoidSet(boidSet);
+		}
+	}
+
+	// Govern its update phases
+	if (governor_.IsEnabled())
+		governor_.AddBoidSet(boidSet);
+
+	// A running server sends it to the clients - the sets built with the flock are added as the server starts
+	if (gameModeServer && useFlockChannel_ && !useLockstep_)
+		flockReplication_.AddBoidSet(boidSet);
+}
+
+
+// Build the pending boid sets a batch of boids a frame, handing each to the game once it is built
+void MainGame::BuildBoidSets()
+{
+	// Nothing to build
+	if (pendingSets_.empty())
+		return;
+
+	TRACE_SCOPE(BuildBoidSets);
+
+	// The frame's batch, across as many sets as it covers
+	int budget = BOID_BUILD_PER_FRAME;
+	while (!pendingSets_.empty() && budget > 0)
 	{
-		boidSet1_.Initialise(cache_, scene_, (numbOfBoids_ / 5), copy_, limit_, updateHalf_);
-		boidSet2_.Initialise(cache_, scene_, (numbOfBoids_ / 5), copy_, limit_, updateHalf_);
-		boidSet3_.Initialise(cache_, scene_, (numbOfBoids_ / 5), copy_, limit_, updateHalf_);
-		boidSet4_.Initialise(cache_, scene_, (numbOfBoids_ / 5), copy_, limit_, updateHalf_);
-		boidSet5_.Initialise(cache_, scene_, (numbOfBoids_ / 5), copy_, limit_, updateHalf_);
+		// Build the next boids of the first set
+		BoidSet* boidSet = pendingSets_.front();
+		int built = (int)boidSet->boidList.size();
+		bool finished = boidSet->Build(boidPrefab_, budget);
+		budget -= (int)boidSet->boidList.size() - built;
+		if (!finished)
+			break;
+
+		// Into the game, and into the wave director's pool
+		pendingSets_.erase(pendingSets_.begin());
+		AddBoidSet(boidSet);
+		waveDirector_.AddBoidSet(boidSet, boidSet->pooled_);
 	}
+}
 
-	// No groups
-	else boidSet1_.Initialise(cache_, scene_, numbOfBoids_, copy_, limit_, updateHalf_);
+
+// Delete the boid sets, built or not, and stop what directs and governs them
+void MainGame::ClearBoidSets()
+{
+	// Everything that keeps the sets lets go of them first
+	governor_.Reset();
+	waveDirector_.Stop();
+	boidLod_.Clear();
+	shadowBudget_.Clear();
+	visibilitySync_.Clear();
+
+	// Delete the sets
+	for (auto boidSet : boidSets_)
+		delete boidSet;
+	for (auto boidSet : pendingSets_)
+		delete boidSet;
+	boidSets_.clear();
+	pendingSets_.clear();
 }
 
 // ----------------------------------------------------------------------------------------------
@@ -592,10 +1004,18 @@ void MainGame::HandleStart(StringHash eventType, VariantMap& eventData)
 	player_ = CreatePlayer();
 	missileSet_.Initialise(cache, scene_, player_);
 
+	// Pool the missile effects
+	effectsBudget_.Initialise(cache, scene_, EMITTER_POOL_SIZE, LOCAL);
+	effectsBudget_.AddMissileSet(&missileSet_);
+
 	// Initialise the UI and boids
 	InitBoids();
 	InitUI();
 
+	// Record the flock's trajectories
+	if (!trajectoryFile_.Empty())
+		trajectory_.Start(context_, trajectoryFile_);
+
 	// Set the game mode
 	gameModeSingle = true;
 
@@ -620,6 +1040,112 @@ void MainGame::HandleStart(StringHash eventType, VariantMap& eventData)
 }
 
 
+// Start of a frame - the frame trace and timings move on to the next frame
+void MainGame::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	frameTrace_.BeginFrame();
+	frameTimings_.BeginFrame();
+	governor_.BeginFrame();
+	fps = frameTimings_.GetFps();
+
+	// Count the flock kernel afresh
+	for (auto boidSet : boidSets_)
+		boidSet->counters_.Reset();
+
+	// Without a console window, commands are read from the standard input
+	if (IsHeadless())
+	{
+		String command = GetConsoleInput();
+		if (!command.Empty() && !RunCommand(command.Trimmed()))
+			URHO3D_LOGINFOF("Unknown command %s", command.CString());
+	}
+}
+
+
+// Handle the end of a frame's rendering - before the frame limiter or vertical sync wait
+void MainGame::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+{
+	governor_.EndFrame();
+}
+
+
+// Show the flock counters of the frame in the debug HUD and write them to the CSV file
+void MainGame::ReportFlockCounters()
+{
+#ifdef FLOCK_COUNTERS
+	// Open the CSV file the first time
+	if (!flockCountersCsv_.Empty() && !flockCountersFile_)
+	{
+		flockCountersFile_ = new File(context_, flockCountersCsv_, FILE_WRITE);
+		if (flockCountersFile_->IsOpen())
+			flockCountersFile_->WriteLine("frame,set,boids,copies,visited,cohesion,alignment,separation,limit_breaks");
+		else
+		{
+			URHO3D_LOGERRORF("Could not write the flock counters to %s", flockCountersCsv_.CString());
+			flockCountersCsv_.Clear();
+		}
+	}
+
+	// Each set
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	unsigned frame = GetSubsystem<Time>()->GetFrameNumber();
+	for (unsigned i = 0; i < boidSets_.size(); i++)
+	{
+		const FlockCounters& counters = boidSets_[i]->counters_;
+
+		// Show it in the debug HUD's stats
+		if (debugHud)
+		{
+			debugHud->SetAppStats("Flock " + String(i + 1), String(counters.boids_) + " boids, " +
+				String(counters.copies_) + " copied, " + String(counters.visited_) + " visited, " +
+				String(counters.cohesion_) + "/" + String(counters.alignment_) + "/" + String(counters.separation_) +
+				" accepted, " + String(counters.limitBreaks_) + " limit breaks");
+		}
+
+		// Add a line to the CSV file
+		if (flockCountersFile_ && flockCountersFile_->IsOpen())
+		{
+			flockCountersFile_->WriteLine(String(frame) + "," + String(i + 1) + "," + String(counters.boids_) + "," +
+				String(counters.copies_) + "," + String(counters.visited_) + "," + String(counters.cohesion_) + "," +
+				String(counters.alignment_) + "," + String(counters.separation_) + "," + String(counters.limitBreaks_));
+		}
+	}
+#endif
+}
+
+
+// Command typed in the console
+void MainGame::HandleConsoleCommand(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ConsoleCommand;
+	if (eventData[P_ID].GetString() == GetTypeName())
+		RunCommand(eventData[P_COMMAND].GetString().Trimmed());
+}
+
+
+// Run a console command - true if it is one of the game's
+bool MainGame::RunCommand(const String& command)
+{
+	// Frame time percentiles
+	if (command == "timings")
+	{
+		URHO3D_LOGINFO("Frame times:\n" + frameTimings_.GetReport());
+		return true;
+	}
+
+	// Start the frame times again
+	if (command == "timings reset")
+	{
+		frameTimings_.Reset();
+		URHO3D_LOGINFO("Frame times reset");
+		return true;
+	}
+
+	// Not a game command
+	return false;
+}
+
+
 // Update - called each frame by the game engine
 void MainGame::HandleUpdate(StringHash eventType, VariantMap& eventData)
 {
@@ -629,6 +1155,13 @@ void MainGame::HandleUpdate(StringHash eventType, VariantMap& eventData)
 	// Take the frame time step, which is stored as a float
 	float timeStep = eventData[P_TIMESTEP].GetFloat();
 
+	// A replay steps the scene itself, a tick a frame
+	if (replay_.IsOpen())
+	{
+		timeStep = replay_.GetHeader().tickStep_;
+		scene_->Update(timeStep);
+	}
+
 	// Get the input and UI subsystems
 	Input* input = GetSubsystem<Input>();
 	UI* ui = GetSubsystem<UI>();
@@ -739,7 +1272,7 @@ void MainGame::HandleUpdate(StringHash eventType, VariantMap& eventData)
 	else if (gameModeServer)
 	{
 		// Toggle menu
-		if (input->GetKeyPress(KEY_M))
+		if (input->GetKeyPress(KEY_M) && !dedicatedServer_)
 		{
 			menuVisible_ = !menuVisible_;
 
@@ -747,36 +1280,21 @@ void MainGame::HandleUpdate(StringHash eventType, VariantMap& eventData)
 			GetSubsystem<UI>()->GetCursor()->SetVisible(menuVisible_);
 		}
 
-		// Network connection
-		Network* network = GetSubsystem<Network>();
-		const Vector<SharedPtr<Connection>>& connections = network->GetClientConnections();
-
 		//// Targets set
 		//bool targetset = false;
 
-		// Loop through connections - for missiles
-		for (unsigned i = 0; i < connections.Size(); ++i)
+		// Loop through the players - for missiles
 		{
-			// Connections
-			Connection* connection = connections[i];
-			Node* player = serverObjects_[connection];
-
-			// If the player exsists and the fire timer is above 0
-			if (player && player->GetVar("FireTimer").GetFloat() > 0.0f)
+			TRACE_SCOPE(HandleCollisionsServer);
+			for (unsigned i = 0; i < players_.GetNumSlots(); ++i)
 			{
-				// If the fire players local firetimer is less than 0
-				if (fireTimer_ <= 0)
-					fireTimer_ = player->GetVar("FireTimer").GetFloat();
-
-				// Reduce the timer
-				fireTimer_ -= timeStep;
-
-				// Reset the timer
-				if (fireTimer_ <= 0)
-					player->SetVar("FireTimer", 0.0f);
+				// The player, if the slot is in use
+				PlayerSlot& slot = players_.GetSlot(i);
+				if (!slot.active_ || !slot.node_)
+					continue;
 
 				// Handle collisions
-				HandleCollisionsServer(connection);
+				HandleCollisionsServer(slot);
 
 				//// Set the target
 				//SetBoidTargets(player);
@@ -784,8 +1302,9 @@ void MainGame::HandleUpdate(StringHash eventType, VariantMap& eventData)
 			}
 		}
 
-		// Handle boids update
-		BoidsUpdate(timeStep);
+		// Handle boids update - unless the flock is run at the physics tick
+		if (!IsFlockTicked())
+			BoidsUpdate(timeStep);
 	}
 
 	// Toggle physics debug geometry with space
@@ -797,6 +1316,8 @@ void MainGame::HandleUpdate(StringHash eventType, VariantMap& eventData)
 //  Handle player update
 void MainGame::PlayerUpdate(float timeStep)
 {
+	TRACE_SCOPE(PlayerUpdate);
+
 	// Get the input and UI subsystems
 	Input* input = GetSubsystem<Input>();
 	UI* ui = GetSubsystem<UI>();
@@ -869,36 +1390,112 @@ void MainGame::PlayerUpdate(float timeStep)
 // Handle boids update
 void MainGame::BoidsUpdate(float timeStep)
 {
-	// Use grouping on the boids
-	if (useGroups_)
-	{
-		boidSet1_.Update(timeStep);
-		boidSet2_.Update(timeStep);
-		boidSet3_.Update(timeStep);
-		boidSet4_.Update(timeStep);
-		boidSet5_.Update(timeStep);
-	}
+	TRACE_SCOPE(BoidsUpdate);
 
-	// No groups
-	else boidSet1_.Update(timeStep);
+	// Build the pooled flocks still to come, then spawn and retire boids for the waves
+	BuildBoidSets();
+	waveDirector_.Update(timeStep);
+
+	// Each set
+	for (auto boidSet : boidSets_)
+		boidSet->Update(timeStep);
+}
+
+
+// Is the flock run at the physics tick - in lockstep, and when the session is recorded or replayed
+bool MainGame::IsFlockTicked()
+{
+	return useLockstep_ || !recordFile_.Empty() || !replayFile_.Empty();
 }
 
 
 // Set the target 
 void MainGame::SetBoidTargets(Node* node)
 {
-	// Use grouping on the boids
-	if (useGroups_)
+	// Each set
+	for (auto boidSet : boidSets_)
+		boidSet->SetTargets(node, 2.0f);
+}
+
+
+// Refresh the flock state and the instanced flock renderers
+void MainGame::SyncFlocks()
+{
+	// Each set
+	for (auto boidSet : boidSets_)
+		boidSet->SyncState();
+
+	// Rebuild the instanced renderers
+	if (useInstancing_)
+	{
+		for (auto boidSet : boidSets_)
+			boidSet->UpdateRenderers();
+	}
+}
+
+
+// Record the flock state and the players of the frame to the trajectory file
+void MainGame::RecordTrajectory()
+{
+	TRACE_SCOPE(RecordTrajectory);
+
+	// Boids of the frame
+	unsigned numBoids = 0;
+	for (auto boidSet : boidSets_)
+		numBoids += (unsigned)boidSet->positions_.size();
+
+	// The boid sets in order
+	Time* frameTime = GetSubsystem<Time>();
+	trajectory_.BeginTick(frameTime->GetFrameNumber(), frameTime->GetElapsedTime(), numBoids);
+	for (auto boidSet : boidSets_)
+		trajectory_.AddBoids(*boidSet);
+
+	// The single player, or each player of the server
+	if (gameModeSingle)
+		trajectory_.AddPlayer(player_->GetPosition());
+	else
+	{
+		for (unsigned i = 0; i < players_.GetNumSlots(); ++i)
+		{
+			PlayerSlot& slot = players_.GetSlot(i);
+			if (slot.active_ && slot.node_)
+				trajectory_.AddPlayer(slot.node_->GetPosition());
+		}
+	}
+	trajectory_.EndTick();
+}
+
+
+// Run the boid sets in lockstep
+void MainGame::InitLockstepBoids()
+{
+	// Each set
+	for (auto boidSet : boidSets_)
 	{
-		boidSet1_.SetTargets(node, 2.0f);
-		boidSet2_.SetTargets(node, 2.0f);
-		boidSet3_.SetTargets(node, 2.0f);
-		boidSet4_.SetTargets(node, 2.0f);
-		boidSet5_.SetTargets(node, 2.0f);
+		boidSet->SetLockstep(true);
+		lockstep_.AddBoidSet(boidSet);
 	}
+}
+
+
+// Client: build the server's boid sets once its lockstep parameters have arrived
+void MainGame::StartLockstepClient()
+{
+	// Take the server's flock settings
+	const LockstepParameters& parameters = lockstep_.GetParameters();
+	numbOfBoids_ = parameters.numbOfBoids_;
+	useGroups_ = parameters.useGroups_;
+	copy_ = parameters.copy_;
+	limit_ = parameters.limit_;
+	updateHalf_ = parameters.halfUpdate_;
+
+	// Build the same boid sets from the same seed
+	seed_ = parameters.seed_;
+	InitBoids();
+	InitLockstepBoids();
 
-	// No groups
-	else boidSet1_.SetTargets(node, 2.0f);
+	// Continue from the server's state
+	lockstep_.StartClient();
 }
 
 
@@ -908,14 +1505,82 @@ void MainGame::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 	// Using the update namespace
 	using namespace Update;
 
-	// Take the frame time step, which is stored as a float
-	float timeStep = eventData[P_TIMESTEP].GetFloat();
+	// Take the frame time step, which is stored as a float - a replay's frames are a tick each
+	float timeStep = replay_.IsOpen() ? replay_.GetHeader().tickStep_ : eventData[P_TIMESTEP].GetFloat();
 
 	// Return if no scene or cursor visibile
 	if (GetSubsystem<UI>()->GetFocusElement()) return;
 
-	// Move the camera
-	MoveCamera(timeStep);
+	// Move the camera - a dedicated server has none to fly
+	if (!IsHeadless())
+		MoveCamera(timeStep);
+
+	// Bot: keep the camera on the ship for the server's area of interest, and report the connection
+	if (botMode_)
+	{
+		Node* player = prediction_.GetNode();
+		if (player)
+			cameraNode_->SetTransform(player->GetPosition(), player->GetRotation());
+		bot_.Update(GetSubsystem<Network>()->GetServerConnection(), timeStep);
+	}
+
+	// Refresh the flocks and budget the missile effects after the physics step - the server
+	// only lends the emitters and holds the caps, each client fades the effects by its own camera
+	if (gameModeSingle || gameModeServer)
+	{
+		TRACE_SCOPE(SyncFlocks);
+		SyncFlocks();
+		if (gameModeSingle)
+			effectsBudget_.Update(cameraNode_);
+		else
+			effectsBudget_.UpdatePool();
+	}
+
+	// Record the flock state just refreshed
+	if ((gameModeSingle || gameModeServer) && trajectory_.IsRecording())
+		RecordTrajectory();
+
+	// Send the flock snapshots or the lockstep ticks to the clients
+	if (gameModeServer)
+	{
+		TRACE_SCOPE(Replication);
+		flockReplication_.Update(timeStep);
+		lockstep_.Update(scene_);
+
+		// The loopback bandwidth run is over - failed if no bot loaded the scene or it sent too much
+		if (bandwidthRun_.Update(GetSubsystem<Network>(), timeStep))
+		{
+			if (bandwidthRun_.IsPassed())
+				engine_->Exit();
+			else
+				ErrorExit(bandwidthRun_.GetReport());
+		}
+	}
+
+	// Client: draw the flock and the other replicated nodes from their buffers, and fade the missile effects
+	if (gameModeNetwork)
+	{
+		flockReplication_.Update(timeStep);
+		UpdateRemoteNodes(timeStep);
+		if (!IsHeadless())
+			effectsBudget_.UpdateView(cameraNode_);
+	}
+
+	// The boid drawing budgets only apply to a local view - the server's boids are replicated
+	if (gameModeSingle)
+	{
+		visibilitySync_.Update(cameraNode_);
+		boidLod_.Update(cameraNode_);
+		shadowBudget_.Update(cameraNode_);
+	}
+
+	// Flock kernel counters
+	if (gameModeSingle || gameModeServer)
+		ReportFlockCounters();
+
+	// A dedicated server or bot has no debug geometry or UI
+	if (IsHeadless())
+		return;
 
 	// If draw debug mode is enabled, draw physics debug geometry. Use depth test to make the result easier to interpret
 	if (drawDebug_)
@@ -934,6 +1599,8 @@ void MainGame::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 // Move the camera
 void MainGame::MoveCamera(float timeStep)
 {
+	TRACE_SCOPE(MoveCamera);
+
 	// If single player game
 	if (gameModeSingle)
 	{
@@ -968,6 +1635,8 @@ void MainGame::MoveCamera(float timeStep)
 
 			// Crosshair target
 			{
+				TRACE_SCOPE(CrosshairCast);
+
 				// Ray positions
 				Vector3 startCenter = cameraNode_->GetComponent<Camera>()->ScreenToWorldPoint(Vector3(0.5f, 0.5f, 5.0f));
 				Vector3 endCenter = cameraNode_->GetComponent<Camera>()->ScreenToWorldPoint(Vector3(0.5f, 0.5f, 1000.0f));
@@ -1015,8 +1684,10 @@ void MainGame::MoveCamera(float timeStep)
 		// Only move the camera if we have a controllable object
 		if (clientObjectID_)
 		{
-			// Get the player
-			Node* player = this->scene_->GetNode(clientObjectID_);
+			// Get the player - the predicted ship when there is one
+			Node* player = prediction_.GetNode();
+			if (!player)
+				player = this->scene_->GetNode(clientObjectID_);
 
 			// If we have a player
 			if (player)
@@ -1049,6 +1720,8 @@ void MainGame::MoveCamera(float timeStep)
 
 				// Crosshair target
 				{
+					TRACE_SCOPE(CrosshairCast);
+
 					// Ray positions
 					Vector3 startCenter = cameraNode_->GetComponent<Camera>()->ScreenToWorldPoint(Vector3(0.5f, 0.5f, 5.0f));
 					Vector3 endCenter = cameraNode_->GetComponent<Camera>()->ScreenToWorldPoint(Vector3(0.5f, 0.5f, 1000.0f));
@@ -1132,6 +1805,8 @@ void MainGame::MoveCamera(float timeStep)
 // Handle collisions - single player
 void MainGame::HandleCollisionsSingle()
 {
+	TRACE_SCOPE(HandleCollisionsSingle);
+
 	// Foreach missile in the set
 	for (auto& missile : missileSet_.missileList)
 	{
@@ -1182,13 +1857,10 @@ void MainGame::HandleCollisionsSingle()
 
 
 // Handle collisions - server
-void MainGame::HandleCollisionsServer(Connection* connection)
+void MainGame::HandleCollisionsServer(PlayerSlot& slot)
 {
-	// The network player
-	Node* playerNode = serverObjects_[connection];
-
 	// Foreach missile in the set
-	for (auto& missile : serverMissileSets_[connection]->missileList)
+	for (auto& missile : slot.missiles_->missileList)
 	{
 		// If the missile is active
 		if (missile.IsActive())
@@ -1222,8 +1894,16 @@ void MainGame::HandleCollisionsServer(Connection* connection)
 						// If the node is a boid
 						if (node->GetName() == "Boid")
 						{
-							node->SetEnabled(false); // Reset position instead of disabled?
 							missile.DisableMissile();
+
+							// Replay: the kills recorded are played back instead, so only count the hit
+							if (replay_.IsOpen())
+							{
+								replayKills_++;
+								replayTickKills_++;
+							}
+							else
+								KillBoid(slot, node);
 						}
 					}
 				}
@@ -1235,6 +1915,22 @@ void MainGame::HandleCollisionsServer(Connection* connection)
 	}
 }
 
+
+// A player's missile killed a boid
+void MainGame::KillBoid(PlayerSlot& slot, Node* node)
+{
+	node->SetEnabled(false); // Reset position instead of disabled?
+
+	// Tell the lockstep clients
+	lockstep_.RecordKill(node);
+
+	// Count the kill
+	slot.kills_++;
+	if (slot.node_)
+		slot.node_->SetVar("Kills", (int)slot.kills_);
+	recorder_.RecordKill(players_.IndexOf(slot), node->GetID());
+}
+
 // ----------------------------------------------------------------------------------------------
 // ----------------------------------------------------------------------------------------------
 
@@ -1265,37 +1961,72 @@ void MainGame::HandleClientDisconnected(StringHash eventType, VariantMap& eventD
 	using namespace ClientConnected;
 	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
 
-	// Remove the player
-	Node* player = serverObjects_[connection];
-	if (player != nullptr)
-		player->Remove();
-	serverObjects_.Erase(connection);
+	// Remove the player and their missiles
+	RemovePlayer(connection);
 
-	// Remove the missiles
-	MissileSet* missiles = serverMissileSets_[connection];
-	if (missiles != nullptr)
-		delete missiles;
-	serverMissileSets_.Erase(connection);
+	// Forget the flock snapshots and lockstep state sent to the client
+	flockReplication_.RemoveConnection(connection);
+	lockstep_.RemoveConnection(connection);
 
 	// Set the network game mode
 	gameModeNetwork = false;
 }
 
 
+// Remove a client's player and missiles, if they have them
+void MainGame::RemovePlayer(Connection* connection)
+{
+	// No player for the connection
+	PlayerSlot* slot = players_.Find(connection);
+	if (slot)
+		RemovePlayer(*slot);
+}
+
+
+// Remove a player's ship and missiles
+void MainGame::RemovePlayer(PlayerSlot& slot)
+{
+	// Slot not in use
+	if (!slot.active_)
+		return;
+	recorder_.RecordLeave(players_.IndexOf(slot));
+
+	// Remove the ship
+	if (slot.node_)
+		slot.node_->Remove();
+
+	// Stop managing the missiles - the table deletes them with the slot
+	effectsBudget_.RemoveMissileSet(slot.missiles_);
+	players_.Remove(slot);
+}
+
+
+// Give a player a ship and missiles - a replayed player has no connection
+PlayerSlot& MainGame::AddPlayer(Connection* connection)
+{
+	// Create a controllable object for the player
+	Node* player = CreatePlayer();
+
+	// Missiles
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	MissileSet* missileSet = new MissileSet();
+	missileSet->Initialise(cache, scene_, player);
+	effectsBudget_.AddMissileSet(missileSet);
+
+	// Give the player a slot
+	PlayerSlot& slot = players_.Add(connection, player, missileSet);
+	recorder_.RecordJoin(players_.IndexOf(slot));
+	return slot;
+}
+
+
 // Server started
 void MainGame::HandleStartServer(StringHash eventType, VariantMap& eventData)
 {
 	printf("(HandleStartServer called) Server is started!");
 
-	// Initialise the boids
-	InitBoids();
-
-	// Connection
-	Network* network = GetSubsystem<Network>();
-	network->StartServer(SERVER_PORT);
-
-	// Server game
-	gameModeServer = true;
+	// Build the flock and listen for clients
+	StartServer();
 
 	// Set button visibilty
 	pStart_->SetVisible(false);
@@ -1315,22 +2046,351 @@ void MainGame::HandleStartServer(StringHash eventType, VariantMap& eventData)
 }
 
 
-// Handle a client connected
-void MainGame::HandleConnect(StringHash eventType, VariantMap& eventData)
+// Build the flock and start listening for clients
+void MainGame::StartServer()
 {
-	// Clears scene, prepares it for receiving
-	Network* network = GetSubsystem<Network>();
-	String address = pLineEdit_->GetText().Trimmed();
-	if (address.Empty()) { address = "localhost"; }
+	// Lockstep clients build the same boids from the same seed
+	LockstepParameters parameters;
+	parameters.seed_ = seed_;
+	parameters.numbOfBoids_ = numbOfBoids_;
+	parameters.useGroups_ = useGroups_;
+	parameters.copy_ = copy_;
+	parameters.limit_ = limit_;
+	parameters.halfUpdate_ = updateHalf_;
+	parameters.tickStep_ = 1.0f / scene_->GetComponent<PhysicsWorld>()->GetFps();
 
-	// Reset own object ID from possible previous connection
-	clientObjectID_ = 0;
+	// Initialise the boids
+	InitBoids();
 
-	// Specify scene to use as a client for replication
-	network->Connect(address, SERVER_PORT, scene_);
+	// Run the flock in lockstep with the clients
+	if (useLockstep_)
+	{
+		lockstep_.InitialiseServer(parameters);
+		InitLockstepBoids();
+	}
 
-	// Set the network game mode
-	gameModeNetwork = true;
+	// Or send the boids to the clients through the flock channel
+	flockReplication_.InitialiseServer(scene_);
+	flockReplication_.SetInterest(interestRadius_, FLOCK_VIEW_RANGE, FLOCK_VIEW_ANGLE);
+	if (useFlockChannel_ && !useLockstep_)
+	{
+		for (auto boidSet : boidSets_)
+			flockReplication_.AddBoidSet(boidSet);
+	}
+
+	// Pool the missile effects - replicated so the clients see them
+	effectsBudget_.Initialise(GetSubsystem<ResourceCache>(), scene_, EMITTER_POOL_SIZE, REPLICATED);
+
+	// Record the flock's trajectories
+	if (!trajectoryFile_.Empty())
+		trajectory_.Start(context_, trajectoryFile_);
+
+	// Record the players' session
+	if (!recordFile_.Empty())
+	{
+		SessionHeader header;
+		header.seed_ = parameters.seed_;
+		header.numbOfBoids_ = parameters.numbOfBoids_;
+		header.useGroups_ = parameters.useGroups_;
+		header.copy_ = parameters.copy_;
+		header.limit_ = parameters.limit_;
+		header.halfUpdate_ = parameters.halfUpdate_;
+		header.useLockstep_ = useLockstep_;
+		header.useFlockChannel_ = useFlockChannel_;
+		header.wavesFile_ = wavesFile_;
+		header.tickStep_ = parameters.tickStep_;
+		recorder_.Start(context_, recordFile_, header);
+
+		// The flock reads the bodies as the physics left them, as it does when replayed
+		scene_->GetComponent<PhysicsWorld>()->SetInterpolation(false);
+	}
+
+	// Connection - a replay plays its players back without one
+	if (!replay_.IsOpen())
+	{
+		Network* network = GetSubsystem<Network>();
+		network->StartServer(SERVER_PORT);
+	}
+
+	// Server game
+	gameModeServer = true;
+}
+
+
+// Dedicated server: run the scene, physics, boids and network without graphics, audio or UI
+void MainGame::StartDedicatedServer()
+{
+	// Run at the tick rate and sleep between ticks, sending the clients an update each tick - a
+	// headless engine never has input focus, so the inactive limit is the one that applies
+	engine_->SetMaxFps(tickRate_);
+	engine_->SetMaxInactiveFps(tickRate_);
+	GetSubsystem<Network>()->SetUpdateFps(tickRate_);
+
+	// Create the scene
+	CreateScene();
+
+	// Subscribe to the game and network events
+	SubscribeToEvents();
+
+	// No game modes until the server starts
+	gameModeSingle = false;
+	gameModeNetwork = false;
+	menuVisible_ = false;
+
+	// Start the server
+	StartServer();
+	URHO3D_LOGINFOF("Dedicated server on port %d at %d ticks a second", SERVER_PORT, tickRate_);
+
+	// Measure the bandwidth to the bots if asked - the flock channel must save on what scene
+	// replication would send for every boid each network update
+	bool flockChannel = useFlockChannel_ && !useLockstep_;
+	float sceneBytes = numbOfBoids_ * BANDWIDTH_SCENE_BYTES_PER_BOID * tickRate_;
+	bandwidthRun_.Initialise(bandwidthTime_, flockChannel, flockChannel ? sceneBytes / BANDWIDTH_MIN_SAVING : 0.0f);
+}
+
+
+// Bot client: connect without graphics, audio or UI and fly with made up controls
+void MainGame::StartBot()
+{
+	// Run at the network rate and sleep in between - without focus, like the dedicated server
+	engine_->SetMaxFps(tickRate_);
+	engine_->SetMaxInactiveFps(tickRate_);
+
+	// Create the scene
+	CreateScene();
+
+	// Subscribe to the game and network events
+	SubscribeToEvents();
+
+	// No game modes until connected
+	gameModeSingle = false;
+	gameModeServer = false;
+	menuVisible_ = false;
+
+	// Connect - the bot joins the game once connected
+	bot_.Initialise(botID_, botBehaviour_);
+	ConnectToServer(serverAddress_);
+	URHO3D_LOGINFOF("Bot %u connecting to %s", botID_, serverAddress_.CString());
+}
+
+
+// Check the flock kernel against the reference flock and exit - fails the run if it is out of bounds
+void MainGame::RunFlockCheck()
+{
+	// A bare scene for the flock
+	SharedPtr<Scene> scene(new Scene(context_));
+	scene->CreateComponent<Octree>();
+	scene->CreateComponent<PhysicsWorld>();
+
+	// Check the kernel with the shortcuts asked for
+	FlockCheck check;
+	URHO3D_LOGINFOF("Flock check: %d boids, %d ticks, copy range %s, neighbour limit %s, half update %s",
+		numbOfBoids_, FLOCK_CHECK_TICKS, copy_ ? "on" : "off", limit_ ? "on" : "off", updateHalf_ ? "on" : "off");
+	bool passed = check.Run(GetSubsystem<ResourceCache>(), scene, numbOfBoids_, copy_, limit_, updateHalf_, FLOCK_CHECK_TICKS);
+
+	// Report it - the shortcuts' errors against the exact kernel's bounds, for reference only
+	char text[240];
+	if (check.IsExact())
+		snprintf(text, sizeof(text), "Flock check %s: largest force error %.6f (bound %.6f), %u forces out of bounds, largest drift %.4f (bound %.4f), first failed tick %d",
+			passed ? "passed" : "FAILED", check.GetMaxForceError(), FLOCK_CHECK_FORCE_TOLERANCE, check.GetNumForceFailures(),
+			check.GetMaxDrift(), FLOCK_CHECK_DRIFT, check.GetFirstFailedTick());
+	else
+		snprintf(text, sizeof(text), "Flock check %s with shortcuts: largest force error %.6f, largest drift %.4f (not bounded), first tick not a number %d",
+			passed ? "passed" : "FAILED", check.GetMaxForceError(), check.GetMaxDrift(), check.GetFirstFailedTick());
+	URHO3D_LOGINFO(text);
+
+	// The instanced flocks must be drawn with the same batches whatever their size
+	char instancingText[200];
+	bool instancingPassed = check.RunInstancing(GetSubsystem<ResourceCache>(), scene);
+	snprintf(instancingText, sizeof(instancingText), "Instancing check %s: %u, %u and %u batches for %d, %d and %d boids",
+		instancingPassed ? "passed" : "FAILED", check.GetInstancingBatches(0), check.GetInstancingBatches(1), check.GetInstancingBatches(2),
+		FLOCK_CHECK_INSTANCING_SIZES[0], FLOCK_CHECK_INSTANCING_SIZES[1], FLOCK_CHECK_INSTANCING_SIZES[2]);
+	URHO3D_LOGINFO(instancingText);
+
+	// Exit - with a failure code if either is out of bounds
+	if (passed && instancingPassed)
+		engine_->Exit();
+	else
+		ErrorExit(passed ? instancingText : text);
+}
+
+
+// Check the missiles fly the same path at each frame rate and exit - fails the run if they do not
+void MainGame::RunMissileCheck()
+{
+	// Fly the missiles - no scene needed
+	MissileCheck check;
+	URHO3D_LOGINFOF("Missile check: %d ticks at %d, %d and %d frames a second",
+		MISSILE_CHECK_TICKS, MISSILE_CHECK_RATES[0], MISSILE_CHECK_RATES[1], MISSILE_CHECK_RATES[2]);
+	bool passed = check.Run(MISSILE_CHECK_TICKS);
+
+	// Report it
+	char text[200];
+	snprintf(text, sizeof(text), "Missile check %s: still target error %.6f (must be 0), moving target error %.6f (bound %.6f), first failed tick %d",
+		passed ? "passed" : "FAILED", check.GetMaxStillError(), check.GetMaxMovingError(), MISSILE_CHECK_DRIFT, check.GetFirstFailedTick());
+	URHO3D_LOGINFO(text);
+
+	// Exit - with a failure code if the paths differ
+	if (passed)
+		engine_->Exit();
+	else
+		ErrorExit(text);
+}
+
+
+// Replay: play a recorded session back headless, a tick a frame as fast as it runs
+void MainGame::StartReplay()
+{
+	// Open the session
+	if (!replay_.Open(context_, replayFile_))
+	{
+		ErrorExit("Could not replay " + replayFile_);
+		return;
+	}
+
+	// Build the flock the session was recorded with
+	const SessionHeader& header = replay_.GetHeader();
+	seed_ = header.seed_;
+	numbOfBoids_ = header.numbOfBoids_;
+	useGroups_ = header.useGroups_;
+	copy_ = header.copy_;
+	limit_ = header.limit_;
+	updateHalf_ = header.halfUpdate_;
+	useLockstep_ = header.useLockstep_;
+	useFlockChannel_ = header.useFlockChannel_;
+	wavesFile_ = header.wavesFile_;
+
+	// No frame limit
+	engine_->SetMaxFps(0);
+
+	// Create the scene
+	CreateScene();
+
+	// Subscribe to the game events
+	SubscribeToEvents();
+
+	// The game steps the scene a tick a frame, and the physics takes exactly one step a tick
+	scene_->SetUpdateEnabled(false);
+	PhysicsWorld* physicsWorld = scene_->GetComponent<PhysicsWorld>();
+	physicsWorld->SetFps(RoundToInt(1.0f / header.tickStep_));
+	physicsWorld->SetInterpolation(false);
+
+	// A server game without a menu
+	gameModeSingle = false;
+	gameModeNetwork = false;
+	menuVisible_ = false;
+
+	// Start the server without a network
+	StartServer();
+	replayTimer_.Reset();
+	URHO3D_LOGINFOF("Replaying %s: seed %u, %d boids", replayFile_.CString(), seed_, numbOfBoids_);
+}
+
+
+// Replay: play the players of the next tick back - false at the end of the session
+bool MainGame::ReplayTick()
+{
+	// End of the session
+	if (!replay_.ReadTick())
+	{
+		FinishReplay();
+		return false;
+	}
+
+	// Players who joined or left, in the order they did - the table hands out the same slots
+	for (const SessionChange& change : replay_.GetChanges())
+	{
+		if (change.join_)
+		{
+			PlayerSlot& slot = AddPlayer(nullptr);
+			if (players_.IndexOf(slot) != change.player_)
+				URHO3D_LOGWARNINGF("Replay: player %u joined in slot %u", change.player_, players_.IndexOf(slot));
+		}
+		else if (change.player_ < players_.GetNumSlots())
+			RemovePlayer(players_.GetSlot(change.player_));
+	}
+
+	// The boids killed since the last tick, as recorded - the hits found again should match
+	for (const SessionKill& kill : replay_.GetKills())
+	{
+		Node* node = scene_->GetNode(kill.boidID_);
+		if (kill.player_ < players_.GetNumSlots() && node && node->GetName() == "Boid" && node->IsEnabled())
+			KillBoid(players_.GetSlot(kill.player_), node);
+	}
+	if (replayTickKills_ != replay_.GetNumKills() && replayDriftTick_ < 0)
+	{
+		replayDriftTick_ = (int)replay_.GetTotalTicks();
+		URHO3D_LOGWARNINGF("Replay drifted at tick %d: %u boids hit, %u recorded killed",
+			replayDriftTick_, replayTickKills_, replay_.GetNumKills());
+	}
+	replayTickKills_ = 0;
+
+	// Their controls
+	for (unsigned i = 0; i < players_.GetNumSlots(); ++i)
+		players_.GetSlot(i).controls_ = replay_.GetControls(i);
+	return true;
+}
+
+
+// Replay: report the run and exit
+void MainGame::FinishReplay()
+{
+	// How long it took, and how it compares with the recording
+	float seconds = replayTimer_.GetUSec(false) / 1000000.0f;
+	char text[240];
+	snprintf(text, sizeof(text), "Replay of %u ticks took %.2f s (%.1f ticks a second): %u missiles fired (%u recorded), %u boids killed (%u recorded)",
+		replay_.GetTotalTicks(), seconds, replay_.GetTotalTicks() / Max(seconds, 0.001f),
+		replayFires_, replay_.GetTotalFires(), replayKills_, replay_.GetTotalKills());
+	URHO3D_LOGINFO(text);
+	if (replayDriftTick_ >= 0)
+		URHO3D_LOGWARNINGF("Replay drifted from the recording at tick %d", replayDriftTick_);
+
+	// Done
+	replay_.Close();
+	engine_->Exit();
+}
+
+
+// Launch the bot clients asked for on the command line, as separate processes
+void MainGame::SpawnBots()
+{
+	// The program is this one
+	FileSystem* fileSystem = GetSubsystem<FileSystem>();
+	String program = fileSystem->GetProgramDir() + BOT_PROGRAM;
+	if (GetPlatform() == "Windows")
+		program += ".exe";
+
+	// Launch each bot
+	for (int i = 1; i <= botCount_; i++)
+	{
+		// Bot arguments
+		Vector<String> arguments;
+		arguments.Push("-bot");
+		arguments.Push("-botid");
+		arguments.Push(String(i));
+		arguments.Push("-address");
+		arguments.Push(serverAddress_);
+		if (botBehaviour_ == BOT_SCRIPTED)
+			arguments.Push("-botscript");
+
+		// Start it
+		if (fileSystem->SystemSpawn(program, arguments) < 0)
+			URHO3D_LOGERRORF("Could not launch bot %d", i);
+	}
+
+	// Report the launch
+	if (botCount_)
+		URHO3D_LOGINFOF("Launched %d bots against %s", botCount_, serverAddress_.CString());
+}
+
+
+// Handle a client connected
+void MainGame::HandleConnect(StringHash eventType, VariantMap& eventData)
+{
+	// Connect to the address typed in
+	String address = pLineEdit_->GetText().Trimmed();
+	if (address.Empty()) { address = "localhost"; }
+	ConnectToServer(address);
 
 	// Set button visibility
 	pStart_->SetVisible(false);
@@ -1341,6 +2401,38 @@ void MainGame::HandleConnect(StringHash eventType, VariantMap& eventData)
 }
 
 
+// Connect to a server
+void MainGame::ConnectToServer(const String& address)
+{
+	// Clears scene, prepares it for receiving
+	Network* network = GetSubsystem<Network>();
+
+	// Reset own object ID from possible previous connection
+	clientObjectID_ = 0;
+
+	// Build the boids from the server's flock snapshots or run them in lockstep
+	flockReplication_.InitialiseClient(GetSubsystem<ResourceCache>(), scene_);
+	flockReplication_.SetInterpolation(interpolationDelay_, SNAPSHOT_MAX_EXTRAPOLATION);
+	lockstep_.InitialiseClient();
+	prediction_.Clear();
+
+	// Draw the other replicated nodes a short delay behind the server
+	remoteStates_.Clear();
+	remoteStates_.SetDelay(interpolationDelay_);
+	remoteTime_ = 0.0f;
+	remoteServerTime_ = 0.0f;
+
+	// Fade the replicated missile effects as they arrive
+	effectsBudget_.Clear();
+
+	// Specify scene to use as a client for replication
+	network->Connect(address, SERVER_PORT, scene_);
+
+	// Set the network game mode
+	gameModeNetwork = true;
+}
+
+
 // Handle a disconnects
 void MainGame::HandleDisconnect(StringHash eventType, VariantMap & eventData)
 {
@@ -1352,6 +2444,12 @@ void MainGame::HandleDisconnect(StringHash eventType, VariantMap & eventData)
 	if (serverConnection)
 	{
 		serverConnection->Disconnect();
+		flockReplication_.Clear();
+		lockstep_.Clear();
+		prediction_.Clear();
+		remoteStates_.Clear();
+		effectsBudget_.Clear();
+		ClearBoidSets();
 		scene_->Clear(true, false);
 		clientObjectID_ = 0;
 		CreateScene();
@@ -1369,7 +2467,12 @@ void MainGame::HandleDisconnect(StringHash eventType, VariantMap & eventData)
 	else if (network->IsServerRunning())
 	{
 		network->StopServer();
+		ClearBoidSets();
 		scene_->Clear(true, false);
+		effectsBudget_.Clear();
+		flockReplication_.Clear();
+		lockstep_.Clear();
+		players_.Clear();
 		gameModeServer = false;
 		CreateScene();
 
@@ -1431,73 +2534,205 @@ Controls MainGame::FromClientToServerControls()
 
 
 // Process the clients controls
-void MainGame::ProcessClientControls()
+void MainGame::ProcessClientControls(float timeStep)
 {
-	// Network connection
-	Network* network = GetSubsystem<Network>();
-	const Vector<SharedPtr<Connection>>& connections = network->GetClientConnections();
+	TRACE_SCOPE(ProcessClientControls);
 
-	//Server: go through every client connected
-	for (unsigned i = 0; i < connections.Size(); ++i)
+	// The players' controls for this step - played back, or sent by the clients
+	unsigned numSlots = players_.GetNumSlots();
+	if (replay_.IsOpen())
+	{
+		if (!ReplayTick())
+			return;
+		numSlots = players_.GetNumSlots();
+	}
+	else
 	{
-		// The connection
-		Connection* connection = connections[i];
-		UI* ui = GetSubsystem<UI>();
+		for (unsigned i = 0; i < numSlots; ++i)
+		{
+			PlayerSlot& slot = players_.GetSlot(i);
+			if (!slot.active_)
+				continue;
+			slot.controls_ = slot.connection_->GetControls();
+			recorder_.RecordControls(i, slot.controls_);
+		}
+	}
 
-		// Get the object this connection is controlling
-		Node* player = serverObjects_[connection];
-		MissileSet* missileSet = serverMissileSets_[connection];
+	// Work out every player's step - in parallel batches when there are enough players
+	if (numSlots > PLAYERS_PER_TASK)
+	{
+		// Context shared by the batches
+		PlayerTask task;
+		task.game_ = this;
+		task.timeStep_ = timeStep;
+
+		// One work item for each batch of slots
+		WorkQueue* queue = GetSubsystem<WorkQueue>();
+		PlayerSlot* slots = &players_.GetSlot(0);
+		for (unsigned start = 0; start < numSlots; start += PLAYERS_PER_TASK)
+		{
+			SharedPtr<WorkItem> item = queue->GetFreeItem();
+			item->priority_ = M_MAX_UNSIGNED;
+			item->workFunction_ = ProcessPlayersWork;
+			item->aux_ = &task;
+			item->start_ = slots + start;
+			item->end_ = slots + Min(start + PLAYERS_PER_TASK, numSlots);
+			queue->AddWorkItem(item);
+		}
 
-		// Client has no item connected
-		if (!player) continue;
-		RigidBody* rigidbody = player->GetComponent<RigidBody>();
+		// Wait for the batches (the main thread helps)
+		queue->Complete(M_MAX_UNSIGNED);
+	}
+	else
+	{
+		for (unsigned i = 0; i < numSlots; ++i)
+			ProcessPlayer(players_.GetSlot(i), timeStep);
+	}
 
-		// Get the last controls sent by the client
-		const Controls& controls = connection->GetControls();
+	// Server: apply the commands in slot order
+	unsigned numFired = 0;
+	for (unsigned i = 0; i < numSlots; ++i)
+	{
+		// The player, if the slot is in use and the ship still exists
+		PlayerSlot& slot = players_.GetSlot(i);
+		if (!slot.active_ || !slot.node_)
+			continue;
+		PlayerCommands& commands = slot.commands_;
 
-		// The force applied to the player
-		Vector3 force = Vector3::FORWARD;
+		// Apply forces
+		slot.body_->ApplyTorque(commands.torque_);
+		slot.body_->ApplyForce(commands.force_);
 
-		// Reset mouse controls
-		float roll = 0.0f;
+		// Tell the client which of its inputs this state follows, for its prediction
+		if (!commands.sequence_.IsEmpty())
+			slot.node_->SetVar(PREDICTION_SEQUENCE, commands.sequence_);
 
-		// Set the speeds
-		float speed = speed_;
-		float rotationSpeed = rotationSpeed_;
+		// Update missiles
+		for (unsigned j = 0; j < NUMBER_OF_MISSILES; j++)
+			slot.missiles_->missileList[j].ApplyNetwork(commands.missileSteps_[j]);
 
-		// Set speed and rotation speed
-		if (controls.buttons_ & CTRL_FORWARD)
+		// Count the missile fired
+		if (commands.fired_)
 		{
-			speed *= speedMultiplier_;
-			rotationSpeed *= speedMultiplier_;
+			recorder_.RecordFire(i);
+			numFired++;
 		}
+	}
 
-		// Brake speed
-		else if (controls.buttons_ & CTRL_BACK)
+	// End the recorded tick
+	recorder_.EndTick();
+
+	// Replay: the same missiles should have been fired as in the recording
+	if (replay_.IsOpen())
+	{
+		replayFires_ += numFired;
+		if (numFired != replay_.GetNumFires() && replayDriftTick_ < 0)
 		{
-			speed /= speedMultiplier_;
-			rotationSpeed /= speedMultiplier_;
+			replayDriftTick_ = (int)replay_.GetTotalTicks();
+			URHO3D_LOGWARNINGF("Replay drifted at tick %d: %u missiles fired, %u recorded",
+				replayDriftTick_, numFired, replay_.GetNumFires());
 		}
+	}
+}
 
-		// Set force and roll
-		if (controls.buttons_ & CTRL_LEFT)	roll -= 1.0f * rotationSpeed;
-		if (controls.buttons_ & CTRL_RIGHT)	roll += 1.0f * rotationSpeed;
 
-		// Apply forces
-		rigidbody->ApplyTorque(rigidbody->GetRotation() * Vector3(controls.pitch_, controls.yaw_, roll));
-		rigidbody->ApplyForce(rigidbody->GetRotation() * force * speed);
+// Work out a batch of players' steps - runs on the work queue
+void MainGame::ProcessPlayersWork(const WorkItem* item, unsigned threadIndex)
+{
+	const PlayerTask* task = static_cast<const PlayerTask*>(item->aux_);
+	PlayerSlot* end = static_cast<PlayerSlot*>(item->end_);
+	for (PlayerSlot* slot = static_cast<PlayerSlot*>(item->start_); slot < end; ++slot)
+		task->game_->ProcessPlayer(*slot, task->timeStep_);
+}
 
-		// Fire missile
-		if (controls.buttons_ & CTRL_FIRE && player->GetVar("FireTimer").GetFloat() <= 0.0f)
-		{
-			// Fire missile
-			missileSet->Shoot(rigidbody->GetRotation() * Vector3::FORWARD, nullptr);
-			player->SetVar("FireTimer", fireTimerReset_);
-		}
 
-		// Update missiles
-		missileSet->Update();
+// Work out a player's step without touching the scene - fills in the slot's commands
+void MainGame::ProcessPlayer(PlayerSlot& slot, float timeStep)
+{
+	// Slot not in use or the ship has gone
+	if (!slot.active_ || !slot.node_)
+		return;
+	PlayerCommands& commands = slot.commands_;
+
+	// The player's controls for the step
+	const Controls& controls = slot.controls_;
+
+	// Forces from the controls
+	Quaternion rotation = slot.body_->GetRotation();
+	ComputeShipControls(rotation, controls, commands.torque_, commands.force_);
+
+	// Input sequence for the client's prediction
+	VariantMap::ConstIterator sequence = controls.extraData_.Find(PREDICTION_SEQUENCE);
+	commands.sequence_ = sequence != controls.extraData_.End() ? sequence->second_ : Variant::EMPTY;
+
+	// Cool down the missiles
+	if (slot.fireCooldown_ > 0.0f)
+		slot.fireCooldown_ -= timeStep;
+
+	// Fire missile - only marks a missile, it is launched when the commands are applied
+	commands.fired_ = false;
+	if (controls.buttons_ & CTRL_FIRE && slot.fireCooldown_ <= 0.0f)
+	{
+		commands.fired_ = true;
+		slot.missiles_->Shoot(rotation * Vector3::FORWARD, nullptr);
+		slot.fireCooldown_ = fireTimerReset_;
+		slot.shots_++;
 	}
+
+	// Step the missiles
+	for (unsigned i = 0; i < NUMBER_OF_MISSILES; i++)
+		commands.missileSteps_[i] = slot.missiles_->missileList[i].StepNetwork(timeStep);
+}
+
+
+// Apply a player's controls to their ship (server, and the client's prediction)
+void MainGame::ApplyShipControls(RigidBody* rigidbody, const Controls& controls)
+{
+	// Work out the forces
+	Vector3 torque;
+	Vector3 force;
+	ComputeShipControls(rigidbody->GetRotation(), controls, torque, force);
+
+	// Apply forces
+	rigidbody->ApplyTorque(torque);
+	rigidbody->ApplyForce(force);
+}
+
+
+// Work out the torque and force a player's controls put on their ship
+void MainGame::ComputeShipControls(const Quaternion& rotation, const Controls& controls, Vector3& torque, Vector3& force) const
+{
+	// The force applied to the player
+	Vector3 forward = Vector3::FORWARD;
+
+	// Reset mouse controls
+	float roll = 0.0f;
+
+	// Set the speeds
+	float speed = speed_;
+	float rotationSpeed = rotationSpeed_;
+
+	// Set speed and rotation speed
+	if (controls.buttons_ & CTRL_FORWARD)
+	{
+		speed *= speedMultiplier_;
+		rotationSpeed *= speedMultiplier_;
+	}
+
+	// Brake speed
+	else if (controls.buttons_ & CTRL_BACK)
+	{
+		speed /= speedMultiplier_;
+		rotationSpeed /= speedMultiplier_;
+	}
+
+	// Set force and roll
+	if (controls.buttons_ & CTRL_LEFT)	roll -= 1.0f * rotationSpeed;
+	if (controls.buttons_ & CTRL_RIGHT)	roll += 1.0f * rotationSpeed;
+
+	// The forces
+	torque = rotation * Vector3(controls.pitch_, controls.yaw_, roll);
+	force = rotation * forward * speed;
 }
 
 
@@ -1516,19 +2751,34 @@ void MainGame::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
 	// Client: collect controls
 	if (serverConnection)
 	{
-		// send camera position too
+		// send camera position and rotation too - the server sends the flock around it
 		serverConnection->SetPosition(cameraNode_->GetPosition());
+		serverConnection->SetRotation(cameraNode_->GetRotation());
+
+		// Fly the own ship ahead of the server with the same controls - a bot makes up its own
+		Controls controls = botMode_ ? bot_.GetControls(timeStep) : FromClientToServerControls();
+		Node* serverPlayer = clientObjectID_ ? scene_->GetNode(clientObjectID_) : nullptr;
+		RigidBody* predicted = prediction_.Step(serverPlayer, controls);
+		if (predicted)
+			ApplyShipControls(predicted, controls);
 
 		// send controls to server
-		serverConnection->SetControls(FromClientToServerControls());
+		serverConnection->SetControls(controls);
 	}
 
-	// Server: Read Controls, Apply them if needed
-	else if (network->IsServerRunning())
+	// Server: Read Controls, Apply them if needed - or play them back
+	else if (network->IsServerRunning() || replay_.IsOpen())
 	{
 		// take data from clients, process it
-		ProcessClientControls();
+		ProcessClientControls(timeStep);
+
+		// A recorded or replayed flock is stepped with the players, a tick at a time
+		if (IsFlockTicked() && !useLockstep_)
+			BoidsUpdate(timeStep);
 	}
+
+	// Run the lockstep flock (server and clients) at the physics tick
+	lockstep_.Step();
 }
 
 // ----------------------------------------------------------------------------------------------
@@ -1542,6 +2792,202 @@ void MainGame::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
 // ---------------------------------------- NETWORK EVENTS --------------------------------------
 // ----------------------------------------------------------------------------------------------
 
+// Custom network message
+void MainGame::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
+{
+	// Using the network message namespace
+	using namespace NetworkMessage;
+
+	// The message
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	int msgID = eventData[P_MESSAGEID].GetInt();
+	MemoryBuffer message(eventData[P_DATA].GetBuffer());
+
+	// Bot: count the server's network updates, and the flock snapshots or lockstep ticks
+	if (botMode_ && msgID == MSG_SERVERTIME)
+		bot_.AddUpdate();
+	if (botMode_ && (msgID == MSG_FLOCKSNAPSHOT || msgID == MSG_LOCKSTEPTICK))
+		bot_.AddSnapshot();
+
+	// Client: the server's clock for the scene update that comes with it - paces the remote nodes' buffer
+	if (msgID == MSG_SERVERTIME)
+	{
+		float serverTime = message.ReadFloat();
+		if (gameModeNetwork && serverTime > remoteServerTime_)
+		{
+			remoteServerTime_ = serverTime;
+			remoteStates_.AddArrival(serverTime, remoteTime_);
+		}
+		return;
+	}
+
+	// Flock snapshots and acknowledgements, or the lockstep channel
+	if (!flockReplication_.HandleMessage(connection, msgID, message))
+		lockstep_.HandleMessage(connection, msgID, message);
+
+	// Client: the lockstep parameters have arrived
+	if (lockstep_.IsStartPending())
+		StartLockstepClient();
+}
+
+
+// Server: send the clock with the network update about to go out
+void MainGame::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	// Only a server with clients
+	Network* network = GetSubsystem<Network>();
+	if (!gameModeServer || network->GetClientConnections().Empty())
+		return;
+
+	// Unreliable, like the transforms it stamps
+	VectorBuffer message;
+	message.WriteFloat(scene_->GetElapsedTime());
+	network->BroadcastMessage(MSG_SERVERTIME, false, false, message);
+}
+
+
+// Client: buffer the transforms of the replicated nodes instead of applying them as they arrive
+void MainGame::HandleNodeAdded(StringHash eventType, VariantMap& eventData)
+{
+	// Using the node added namespace
+	using namespace NodeAdded;
+
+	// Only the replicated nodes of the client's scene
+	Node* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
+	if (!gameModeNetwork || eventData[P_SCENE].GetPtr() != scene_.Get() || !node->IsReplicated())
+		return;
+
+	// Send the position and rotation to HandleInterceptNetworkUpdate
+	node->SetInterceptNetworkUpdate("Network Position", true);
+	node->SetInterceptNetworkUpdate("Network Rotation", true);
+}
+
+
+// Client: hand the replicated missile effects to the effects budget
+void MainGame::HandleComponentAdded(StringHash eventType, VariantMap& eventData)
+{
+	// Using the component added namespace
+	using namespace ComponentAdded;
+
+	// Only the replicated components of the client's scene
+	Component* component = static_cast<Component*>(eventData[P_COMPONENT].GetPtr());
+	if (!gameModeNetwork || eventData[P_SCENE].GetPtr() != scene_.Get() || !component->IsReplicated())
+		return;
+
+	// The pooled emitters and the missile trails
+	if (component->GetType() == ParticleEmitter::GetTypeStatic() || component->GetType() == RibbonTrail::GetTypeStatic())
+		effectsBudget_.AddRemoteEffect(static_cast<Drawable*>(component));
+}
+
+
+// Client: a buffered transform has arrived
+void MainGame::HandleInterceptNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	// Using the intercept network update namespace
+	using namespace InterceptNetworkUpdate;
+
+	// The node and attribute
+	Node* node = static_cast<Node*>(eventData[P_SERIALIZABLE].GetPtr());
+	const String& name = eventData[P_NAME].GetString();
+	const Variant& value = eventData[P_VALUE];
+
+	// The own ship is compared with its prediction - apply at once
+	if (node->GetID() == clientObjectID_)
+	{
+		node->SetAttribute(name, value);
+		return;
+	}
+
+	// Start from the newest transform held
+	Vector3 position;
+	Quaternion rotation;
+	if (!remoteStates_.GetNewest(node->GetID(), position, rotation))
+	{
+		position = node->GetPosition();
+		rotation = node->GetRotation();
+	}
+
+	// Change the attribute that arrived
+	if (name == "Network Position")
+		position = value.GetVector3();
+	else
+	{
+		MemoryBuffer buffer(value.GetBuffer());
+		rotation = buffer.ReadPackedQuaternion();
+	}
+
+	// Stamped with the server time sent with the update
+	remoteStates_.AddState(node->GetID(), remoteServerTime_, position, rotation);
+}
+
+
+// Client: move the replicated nodes to their buffered transforms
+void MainGame::UpdateRemoteNodes(float timeStep)
+{
+	TRACE_SCOPE(UpdateRemoteNodes);
+
+	// Advance the local clock and the time drawn at
+	remoteTime_ += timeStep;
+	remoteStates_.Update(remoteTime_);
+
+	// Move each node
+	PODVector<unsigned> ids;
+	remoteStates_.GetIDs(ids);
+	Vector3 position;
+	Quaternion rotation;
+	bool visible;
+	for (unsigned i = 0; i < ids.Size(); ++i)
+	{
+		// Forget the nodes that have gone, and the own ship once it is known
+		Node* node = scene_->GetNode(ids[i]);
+		if (!node || ids[i] == clientObjectID_)
+		{
+			remoteStates_.Remove(ids[i]);
+			continue;
+		}
+
+		// Move the node
+		if (remoteStates_.Sample(ids[i], position, rotation, visible))
+			node->SetTransform(position, rotation);
+	}
+
+	// Report the buffer state - the jitter is of the server's network updates
+	remoteStatsTimer_ += timeStep;
+	if (remoteStatsTimer_ >= FLOCK_STATS_INTERVAL)
+	{
+		char text[160];
+		snprintf(text, sizeof(text), "Scene buffer jitter %.1f ms, %.1f ms buffered, %u nodes extrapolated, %u held",
+			remoteStates_.GetJitter() * 1000.0f, remoteStates_.GetBufferedTime() * 1000.0f, remoteStates_.GetNumExtrapolated(), remoteStates_.GetNumStale());
+		URHO3D_LOGINFO(text);
+		remoteStatsTimer_ = 0.0f;
+	}
+}
+
+
+// Client: connected to the server
+void MainGame::HandleServerConnected(StringHash eventType, VariantMap& eventData)
+{
+	// A bot joins the game at once
+	if (!botMode_)
+		return;
+	VariantMap remoteEventData;
+	remoteEventData[PLAYER_ID] = 0;
+	GetSubsystem<Network>()->GetServerConnection()->SendRemoteEvent(E_CLIENTISREADY, true, remoteEventData);
+}
+
+
+// Client: the connection to the server has closed or could not be made
+void MainGame::HandleServerDisconnected(StringHash eventType, VariantMap& eventData)
+{
+	// A bot has nothing left to do
+	if (botMode_)
+	{
+		URHO3D_LOGINFOF("Bot %u: disconnected from the server", botID_);
+		engine_->Exit();
+	}
+}
+
+
 // Finished loading client
 void MainGame::HandleClientFinishedLoading(StringHash eventType, VariantMap & eventData)
 {
@@ -1565,19 +3011,15 @@ void MainGame::HandleClientToServerReadyToStart(StringHash eventType, VariantMap
 
 	Connection* newConnection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
 
-	// Create a controllable object for that client
-	Node* player = CreatePlayer();
-	serverObjects_[newConnection] = player;
+	// A client that is ready again starts over
+	RemovePlayer(newConnection);
 
-	// Missiles
-	ResourceCache* cache = GetSubsystem<ResourceCache>();
-	MissileSet* missileSet = new MissileSet();
-	missileSet->Initialise(cache, scene_, player);
-	serverMissileSets_[newConnection] = missileSet;
+	// Create a controllable object for that client
+	PlayerSlot& slot = AddPlayer(newConnection);
 
 	// Finally send the object's node ID using a remote event
 	VariantMap remoteEventData;
-	remoteEventData[PLAYER_ID] = player->GetID();
+	remoteEventData[PLAYER_ID] = slot.node_->GetID();
 	newConnection->SendRemoteEvent(E_CLIENTOBJECTID, true, remoteEventData);
 }
 
@@ -3,7 +3,27 @@
 // Include directives
 #include "Sample.h"
 #include "BoidSet.h"
+#include "BoidPrefab.h"
 #include "MissileSet.h"
+#include "EffectsBudget.h"
+#include "BoidLod.h"
+#include "ShadowBudget.h"
+#include "VisibilitySync.h"
+#include "FlockReplication.h"
+#include "FlockLockstep.h"
+#include "PlayerPrediction.h"
+#include "SnapshotBuffer.h"
+#include "BotClient.h"
+#include "BandwidthRun.h"
+#include "ShipControls.h"
+#include "PlayerTable.h"
+#include "FrameTrace.h"
+#include "FlockCheck.h"
+#include "MissileCheck.h"
+#include "SessionReplay.h"
+#include "TrajectoryRecorder.h"
+#include "QualityGovernor.h"
+#include "WaveDirector.h"
 
 
 // Using the Urho3D namespace
@@ -13,8 +33,19 @@ namespace Urho3D
 	class Scene;
 	class Connection;
 	class Window;
+	class File;
+	struct WorkItem;
 }
 
+// Default ticks a second of a dedicated server
+const int SERVER_TICK_RATE = 30;
+
+// Players worked out by each work queue task in the server's physics pre-step
+const unsigned PLAYERS_PER_TASK = 8;
+
+// Server's clock, sent with each network update so the clients can stamp the scene updates with it
+const int MSG_SERVERTIME = 0x65;
+
 // Camera controls
 const float CAMERA_DISTANCE = 3.0f;
 const float CAMERA_HEIGHT = -0.5f;
@@ -36,9 +67,15 @@ public:
 	// Destructor
 	~MainGame();
 
+	// Setup before engine initialization
+	virtual void Setup();
+
 	// Setup after engine initialization and before running the main loop
 	virtual void Start();
 
+	// Cleanup after the main loop
+	virtual void Stop();
+
 	// Connect
 	void HandleConnect(StringHash eventType, VariantMap& eventData);
 
@@ -46,6 +83,9 @@ public:
 	void HandleDisconnect(StringHash eventType, VariantMap& eventData);
 
 private:
+	// Read the settings from the command line
+	void ParseArguments();
+
 	// Subscribe to necessary events
 	void SubscribeToEvents();
 
@@ -61,6 +101,15 @@ private:
 	// Initialise the boids
 	void InitBoids();
 
+	// Hand a built boid set to the game's systems
+	void AddBoidSet(BoidSet* boidSet);
+
+	// Build the pending boid sets a batch of boids a frame, handing each to the game once it is built
+	void BuildBoidSets();
+
+	// Delete the boid sets, built or not, and stop what directs and governs them
+	void ClearBoidSets();
+
 	// Initialise the environment objects
 	void InitEnvironmentObjects();
 
@@ -88,6 +137,21 @@ private:
 	// Handle start
 	void HandleStart(StringHash eventType, VariantMap& eventData);
 
+	// Handle the start of a frame
+	void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+
+	// Handle the end of a frame's rendering
+	void HandleEndRendering(StringHash eventType, VariantMap& eventData);
+
+	// Show the flock counters of the frame in the debug HUD and write them to the CSV file
+	void ReportFlockCounters();
+
+	// Handle a command typed in the console
+	void HandleConsoleCommand(StringHash eventType, VariantMap& eventData);
+
+	// Run a console command - true if it is one of the game's
+	bool RunCommand(const String& command);
+
 	// Handle application update. Set controls to player
 	void HandleUpdate(StringHash eventType, VariantMap& eventData);
 
@@ -97,9 +161,25 @@ private:
 	// Update the boids
 	void BoidsUpdate(float timeStep);
 
+	// Is the flock run at the physics tick - in lockstep it runs there already, and a recorded
+	// or replayed session needs it stepped the same way both times
+	bool IsFlockTicked();
+
 	// Set the target 
 	void SetBoidTargets(Node* node);
 
+	// Refresh the flock state and the instanced flock renderers
+	void SyncFlocks();
+
+	// Record the flock state and the players of the frame to the trajectory file
+	void RecordTrajectory();
+
+	// Run the boid sets in lockstep
+	void InitLockstepBoids();
+
+	// Client: build the server's boid sets once its lockstep parameters have arrived
+	void StartLockstepClient();
+
 	// Handle application post-update. Update camera position after player has moved
 	void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
 
@@ -110,7 +190,10 @@ private:
 	void HandleCollisionsSingle();
 
 	// Handle collisions - server
-	void HandleCollisionsServer(Connection* connection);
+	void HandleCollisionsServer(PlayerSlot& slot);
+
+	// A player's missile killed a boid
+	void KillBoid(PlayerSlot& slot, Node* node);
 
 	// A client connecting to the server.
 	void HandleClientConnected(StringHash eventType, VariantMap& eventData);
@@ -118,14 +201,72 @@ private:
 	// A client disconnecting from the server.
 	void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
 
+	// Give a player a ship and missiles - a replayed player has no connection
+	PlayerSlot& AddPlayer(Connection* connection);
+
+	// Remove a client's player and missiles, if they have them
+	void RemovePlayer(Connection* connection);
+	void RemovePlayer(PlayerSlot& slot);
+
 	// Handle start server
 	void HandleStartServer(StringHash eventType, VariantMap& eventData);
 
+	// Build the flock and start listening for clients
+	void StartServer();
+
+	// Dedicated server: run the scene, physics, boids and network without graphics, audio or UI
+	void StartDedicatedServer();
+
+	// Bot client: connect without graphics, audio or UI and fly with made up controls
+	void StartBot();
+
+	// Launch the bot clients asked for on the command line, as separate processes
+	void SpawnBots();
+
+	// Check the flock kernel against the reference flock and exit
+	void RunFlockCheck();
+
+	// Check the missiles fly the same path at each frame rate and exit
+	void RunMissileCheck();
+
+	// Replay: play a recorded session back headless, a tick a frame as fast as it runs
+	void StartReplay();
+
+	// Replay: play the players of the next tick back - false at the end of the session
+	bool ReplayTick();
+
+	// Replay: report the run and exit
+	void FinishReplay();
+
+	// Running without graphics, audio or UI
+	bool IsHeadless();
+
+	// Connect to a server
+	void ConnectToServer(const String& address);
+
+	// Client: connected to the server
+	void HandleServerConnected(StringHash eventType, VariantMap& eventData);
+
+	// Client: the connection to the server has closed or could not be made
+	void HandleServerDisconnected(StringHash eventType, VariantMap& eventData);
+
 	// Controls from client
 	Controls FromClientToServerControls();
 
 	// Process the cliens controls
-	void ProcessClientControls();
+	void ProcessClientControls(float timeStep);
+
+	// Work out a batch of players' steps - runs on the work queue
+	static void ProcessPlayersWork(const WorkItem* item, unsigned threadIndex);
+
+	// Work out a player's step without touching the scene - fills in the slot's commands
+	void ProcessPlayer(PlayerSlot& slot, float timeStep);
+
+	// Apply a player's controls to their ship (server, and the client's prediction)
+	void ApplyShipControls(RigidBody* rigidbody, const Controls& controls);
+
+	// Work out the torque and force a player's controls put on their ship
+	void ComputeShipControls(const Quaternion& rotation, const Controls& controls, Vector3& torque, Vector3& force) const;
 
 	// Physics pre-step
 	void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
@@ -142,6 +283,24 @@ private:
 	// Client started the game
 	void HandleClientStartGame(StringHash eventType, VariantMap & eventData);
 
+	// Handle a custom network message (the flock channel)
+	void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
+
+	// Server: send the clock with the network update about to go out
+	void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+
+	// Client: buffer the transforms of the replicated nodes instead of applying them as they arrive
+	void HandleNodeAdded(StringHash eventType, VariantMap& eventData);
+
+	// Client: hand the replicated missile effects to the effects budget
+	void HandleComponentAdded(StringHash eventType, VariantMap& eventData);
+
+	// Client: a buffered transform has arrived
+	void HandleInterceptNetworkUpdate(StringHash eventType, VariantMap& eventData);
+
+	// Client: move the replicated nodes to their buffered transforms
+	void UpdateRemoteNodes(float timeStep);
+
 	// Pointers
 	SharedPtr<Window> window_;
 	SharedPtr<UIElement> uiRoot_;
@@ -150,9 +309,8 @@ private:
 	// Client: ID of own object
 	unsigned clientObjectID_ = 0;
 
-	// Server Client/Object HashMap
-	HashMap<Connection*, WeakPtr<Node>> serverObjects_;
-	HashMap<Connection*, MissileSet*> serverMissileSets_;
+	// Server: state of each connected player
+	PlayerTable players_;
 
 	// Flags
 	bool firstPerson_;
@@ -164,6 +322,61 @@ private:
 	bool copy_;
 	bool limit_;
 	bool updateHalf_;
+	bool useInstancing_;
+	bool useFlockChannel_;
+	bool useLockstep_;
+
+	// Seed of the boid sets' random streams - from the clock unless given with -seed
+	unsigned seed_;
+
+	// Dedicated server and its ticks a second
+	bool dedicatedServer_;
+	int tickRate_;
+
+	// Run the flock or missile check instead of the game
+	bool flockCheck_;
+	bool missileCheck_;
+
+	// Bot clients - run as one, or launch some
+	bool botMode_;
+	int botCount_;
+	unsigned botID_;
+	BotBehaviour botBehaviour_;
+	String serverAddress_;
+	BotClient bot_;
+
+	// Dedicated server: seconds of the loopback bandwidth run against the bots (0 for none)
+	float bandwidthTime_;
+	BandwidthRun bandwidthRun_;
+
+	// Trace of the last frames and its file
+	FrameTrace frameTrace_;
+	String traceFile_;
+
+	// Frame time histograms and the frame time counted as a hitch
+	FrameTimings frameTimings_;
+	float hitchThreshold_;
+
+	// Session recorded by the server and its file
+	SessionRecorder recorder_;
+	String recordFile_;
+
+	// Session played back, its file, and how the replay compares with the recording
+	SessionReplay replay_;
+	String replayFile_;
+	HiresTimer replayTimer_;
+	unsigned replayFires_ = 0;
+	unsigned replayKills_ = 0;
+	unsigned replayTickKills_ = 0;
+	int replayDriftTick_ = -1;
+
+	// Trajectories of the flock and their file
+	TrajectoryRecorder trajectory_;
+	String trajectoryFile_;
+
+	// File the flock counters are written to each frame
+	String flockCountersCsv_;
+	SharedPtr<File> flockCountersFile_;
 
 	// Buttons and line edit
 	Button* pStart_ = nullptr;
@@ -185,14 +398,32 @@ private:
 	int health_;
 	int kills_;
 
-	// Set of boids
-	BoidSet boidSet1_;
-	BoidSet boidSet2_;
-	BoidSet boidSet3_;
-	BoidSet boidSet4_;
-	BoidSet boidSet5_;
+	// Sets of boids - the battle's sets, then any flocks pooled for the wave director
+	std::vector<BoidSet*> boidSets_;
 	int numbOfBoids_;
 
+	// Template every boid is copied from, and the sets still being built from it
+	BoidPrefab boidPrefab_;
+	std::vector<BoidSet*> pendingSets_;
+
+	// Flocks spawned and retired at runtime, and the file of their waves
+	WaveDirector waveDirector_;
+	String wavesFile_;
+
+	// Boid level of detail
+	BoidLod boidLod_;
+
+	// Boid on screen tests
+	VisibilitySync visibilitySync_;
+
+	// Boid shadow casters
+	ShadowBudget shadowBudget_;
+	int shadowCasterBudget_;
+
+	// Quality traded for frame time, and the frame time budget (seconds, 0 for none)
+	QualityGovernor governor_;
+	float frameBudget_ = 0.0f;
+
 	// The player
 	Node* player_ = nullptr;
 	MissileSet missileSet_;
@@ -200,12 +431,34 @@ private:
 	float fireTimerReset_;
 	RigidBody* target_ = nullptr;
 
+	// Missile particle and trail budget
+	EffectsBudget effectsBudget_;
+
+	// Flock snapshots sent to the clients in place of scene replication of the boids
+	FlockReplication flockReplication_;
+	float interestRadius_;
+
+	// Flock run on the server and the clients in lockstep
+	FlockLockstep lockstep_;
+
+	// Client: own ship flown ahead of the server
+	PlayerPrediction prediction_;
+
+	// Client: transforms of the other replicated nodes, drawn a short delay behind
+	SnapshotBuffer remoteStates_;
+	float remoteTime_ = 0.0f;
+
+	// Client: server time of the newest network update, and time since the buffer was last reported
+	float remoteServerTime_ = 0.0f;
+	float remoteStatsTimer_ = 0.0f;
+	float interpolationDelay_;
+
 	// Game mode
 	bool gameModeSingle;
 	bool gameModeNetwork;
 	bool gameModeServer;
 
-	// FPS counter
+	// FPS counter - frames over the last second
 	float fps = 0.0f;
 
 	// Audio
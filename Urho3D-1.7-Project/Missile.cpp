@@ -43,15 +43,9 @@ void Missile::Initialise(ResourceCache* cache, Scene* scene, Node* node)
 	pRigidBody->SetMass(1.0f);
 	pRigidBody->SetUseGravity(false);
 
-	// Particle emitter
-	pParticleEffect_ = cache->GetResource<ParticleEffect>("Particle/Fire.xml");
-	if (!pParticleEffect_)
-		return;
-
-	// Initialise particle emitter
-	pNodeParticle = pNodeMissile->CreateChild("ParticleEmitter");
-	pEmitter_ = pNodeParticle->CreateComponent<ParticleEmitter>();
-	pEmitter_->SetEffect(pParticleEffect_);
+	// The particle emitter is lent by the effects budget while in flight
+	pNodeParticle = nullptr;
+	pEmitter_ = nullptr;
 
 	// Initialise the ribbon trail
 	pTrail_ = pNodeMissile->CreateComponent<RibbonTrail>();
@@ -60,57 +54,104 @@ void Missile::Initialise(ResourceCache* cache, Scene* scene, Node* node)
 	pTrail_->SetEndColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
 	pTrail_->SetWidth(0.15f);
 	pTrail_->SetTailColumn(2);
+	pTrail_->SetEnabled(false);
 
-	// Set the nuumber of particles, scale and life (time)
-	pEmitter_->SetNumParticles(numbOfParticles_);
-	pNodeParticle->SetScale(2.5f);
-	life_ = lifeTime_;
+	// Distant missiles are sent to a client less often
+	NetworkPriority* priority = pNodeMissile->CreateComponent<NetworkPriority>();
+	priority->SetBasePriority(100.0f);
+	priority->SetDistanceFactor(0.5f);
+	priority->SetMinPriority(10.0f);
+
+	// Set the life (time)
+	lifeTicks_ = LifeTicks(lifeTime_);
 }
 
 
-// Update - called each frame by the game engine
-void Missile::Update()
+// Update network missile - called each physics step by the server
+void Missile::UpdateNetwork(float timeStep)
+{
+	ApplyNetwork(StepNetwork(timeStep));
+}
+
+
+// Advance the flight of a network missile without touching the scene (safe on a worker thread)
+MissileStep Missile::StepNetwork(float timeStep)
 {
 	// If the missile is active and not in flight
 	if (isActive_ && !inFlight_)
 	{
-		// Set the missile active
-		pObject->SetEnabled(true);
-
-		// Set emitting
-		pEmitter_->SetEnabled(true);
-		pEmitter_->SetEmitting(true);
-		pEmitter_->SetNumParticles(numbOfParticles_);
-		pTrail_->SetEnabled(true);
-		pTrail_->SetEmitting(true);
-		pTrail_->SetLifetime(0.5f);
-
 		// Missile in flight (will need resetting)
 		inFlight_ = true;
 		isReset_ = false;
 
-		// Set the rigid body enabled
-		pRigidBody->SetEnabled(true);
+		// Network missiles live for a fixed time, independent of the step rate
+		lifeTicks_ = LifeTicks(MISSILE_NETWORK_LIFETIME);
+		accumulator_ = 0.0f;
+		return MISSILE_LAUNCH;
 	}
 
 	// If the missile is active and in flight
 	else if (isActive_ && inFlight_)
 	{
-		// Reduce the life time
-		life_ -= 0.1f;
-
-		// Set the velocity
-		pRigidBody->SetLinearVelocity(direction_.Normalized() * 100.0f);
+		// Reduce the life time by the number of whole ticks elapsed
+		accumulator_ += timeStep;
+		while (accumulator_ >= MISSILE_TICK && lifeTicks_ > 0)
+		{
+			accumulator_ -= MISSILE_TICK;
+			lifeTicks_--;
+		}
 
 		// If the life time reaches zero
-		if (life_ <= 0.0f)
+		if (lifeTicks_ <= 0)
 		{
 			// Reset the missile
-			pObject->SetEnabled(false);
 			isActive_ = false;
 			inFlight_ = false;
-			life_ = lifeTime_;
+			lifeTicks_ = LifeTicks(lifeTime_);
+			return MISSILE_EXPIRE;
 		}
+		return MISSILE_FLY;
+	}
+
+	// Not flying
+	return MISSILE_IDLE;
+}
+
+
+// Apply a step of a network missile to its nodes and body (main thread)
+void Missile::ApplyNetwork(MissileStep step)
+{
+	switch (step)
+	{
+	// Just fired
+	case MISSILE_LAUNCH:
+		// Set the missile active
+		pObject->SetEnabled(true);
+
+		// Set emitting - the effects budget may turn the trail off again
+		pTrail_->SetEnabled(true);
+		pTrail_->SetEmitting(true);
+		pTrail_->SetLifetime(0.5f);
+
+		// Set the rigid body enabled
+		pRigidBody->SetEnabled(true);
+		break;
+
+	// In flight - set the velocity
+	case MISSILE_FLY:
+		pRigidBody->SetLinearVelocity(direction_.Normalized() * MISSILE_NETWORK_SPEED);
+		break;
+
+	// Life time over - last velocity, then hide it
+	case MISSILE_EXPIRE:
+		pRigidBody->SetLinearVelocity(direction_.Normalized() * MISSILE_NETWORK_SPEED);
+		pObject->SetEnabled(false);
+		break;
+
+	// Not flying - keep it with the ship
+	default:
+		Inactive();
+		break;
 	}
 }
 
@@ -124,10 +165,7 @@ void Missile::Update(float timeStep)
 		// Set the missile active
 		pObject->SetEnabled(true);
 
-		// Set emitting
-		pEmitter_->SetEnabled(true);
-		pEmitter_->SetEmitting(true);
-		pEmitter_->SetNumParticles(numbOfParticles_);
+		// Set emitting - the effects budget may turn the trail off again
 		pTrail_->SetEnabled(true);
 		pTrail_->SetEmitting(true);
 		pTrail_->SetLifetime(0.5f);
@@ -136,6 +174,13 @@ void Missile::Update(float timeStep)
 		inFlight_ = true;
 		isReset_ = false;
 
+		// Start the flight on a tick boundary
+		lifeTicks_ = LifeTicks(lifeTime_);
+		accumulator_ = 0.0f;
+
+		// The first frame's ticks start from where the target is now
+		lastTargetPosition_ = target_->GetPosition();
+
 		// Set the rigid body enabled
 		pRigidBody->SetEnabled(true);
 	}
@@ -143,32 +188,97 @@ void Missile::Update(float timeStep)
 	// If the missile is active and in flight
 	else if (isActive_ && inFlight_)
 	{
-		// Reduce the life time
-		life_ -= timeStep;
-
 		// Target destroyed
 		if (!target_->GetNode()->IsEnabled())
-			life_ = 0.0f;
+			lifeTicks_ = 0;
+
+		// Simulate the whole ticks covered by this frame, each against the target where it was
+		// at that tick, so the flight path does not depend on the frame rate
+		Vector3 targetPosition = target_->GetPosition();
 
-		// Apply the force
-		pNodeMissile->Translate(Vector3::FORWARD * MISSILE_SPEED);
-		Quaternion finalRotation = Quaternion::IDENTITY;
-		finalRotation.FromLookRotation(target_->GetPosition() - pNodeMissile->GetPosition(), Vector3::UP);
-		pNodeMissile->SetRotation(finalRotation);
+		// Work on a local copy of the transform
+		Vector3 position = pNodeMissile->GetPosition();
+		Quaternion rotation = pNodeMissile->GetRotation();
+
+		// Step the missile, and write the transform back once if it moved
+		int ticks = Advance(position, rotation, accumulator_, lifeTicks_, lastTargetPosition_, targetPosition, MISSILE_SPEED, timeStep);
+		if (ticks > 0)
+		{
+			lifeTicks_ -= ticks;
+			pNodeMissile->SetTransform(position, rotation);
+		}
+
+		// The next frame's ticks start from here
+		lastTargetPosition_ = targetPosition;
 
 		// If the life time reaches zero
-		if (life_ <= 0.0f)
+		if (lifeTicks_ <= 0)
 		{
 			// Reset the missile
 			pObject->SetEnabled(false);
 			isActive_ = false;
 			inFlight_ = false;
-			life_ = lifeTime_;
+			lifeTicks_ = LifeTicks(lifeTime_);
 		}
 	}
 }
 
 
+// Advance a homing missile by one fixed tick
+void Missile::Integrate(Vector3& position, Quaternion& rotation, const Vector3& targetPosition, float speed, float tick)
+{
+	// Distance covered this tick
+	float distance = speed * tick;
+
+	// Fast missiles are split into sub-steps so they steer (and sweep) in small increments
+	int subSteps = Max(1, CeilToInt(distance / MISSILE_MAX_SUBSTEP));
+	float stepDistance = distance / subSteps;
+
+	// Move forward then turn towards the target
+	for (int i = 0; i < subSteps; i++)
+	{
+		position += rotation * (Vector3::FORWARD * stepDistance);
+		rotation.FromLookRotation(targetPosition - position, Vector3::UP);
+	}
+}
+
+
+// Advance a homing missile by the whole ticks a frame covers, sampling the target at each tick
+int Missile::Advance(Vector3& position, Quaternion& rotation, float& accumulator, int maxTicks, const Vector3& lastTargetPosition,
+	const Vector3& targetPosition, float speed, float timeStep, PODVector<Vector3>* tickPositions)
+{
+	// Time left over from the last frame, plus this frame
+	accumulator += timeStep;
+
+	int ticks = 0;
+	while (accumulator >= MISSILE_TICK && ticks < maxTicks)
+	{
+		// How far through the frame the tick falls
+		float fraction = timeStep > 0.0f ? Clamp(1.0f - (accumulator - MISSILE_TICK) / timeStep, 0.0f, 1.0f) : 1.0f;
+
+		// The target there - written so a target that has not moved is sampled exactly
+		Vector3 tickTarget = lastTargetPosition + (targetPosition - lastTargetPosition) * fraction;
+
+		// Step the missile
+		Integrate(position, rotation, tickTarget, speed, MISSILE_TICK);
+		accumulator -= MISSILE_TICK;
+		ticks++;
+
+		// Record the tick
+		if (tickPositions)
+			tickPositions->Push(position);
+	}
+	return ticks;
+}
+
+
+// Number of fixed ticks a missile lives for
+int Missile::LifeTicks(float lifeTime)
+{
+	return Max(1, RoundToInt(lifeTime / MISSILE_TICK));
+}
+
+
 // Activate the missile
 void Missile::SetActive(bool isActive, Vector3 direction, RigidBody* target)
 {
@@ -193,9 +303,7 @@ void Missile::Inactive()
 	if (!isActive_ && !inFlight_ && !isReset_)
 	{
 		// Stop emitting
-		pEmitter_->RemoveAllParticles();
-		pEmitter_->SetEmitting(false);
-		pEmitter_->SetEnabled(false); 
+		StopEmitter();
 		pTrail_->SetEmitting(false);
 		isReset_ = true;
 
@@ -219,9 +327,7 @@ void Missile::Inactive()
 void Missile::DisableMissile()
 {
 	// Stop emitting
-	pEmitter_->RemoveAllParticles();
-	pEmitter_->SetEmitting(false);
-	pEmitter_->SetEnabled(false);
+	StopEmitter();
 	pTrail_->SetEmitting(false);
 	isReset_ = true;
 
@@ -229,8 +335,8 @@ void Missile::DisableMissile()
 	pObject->SetEnabled(false);
 	isActive_ = false;
 	inFlight_ = false;
-	life_ = lifeTime_;
-	pEmitter_->SetNumParticles(0);
+	lifeTicks_ = LifeTicks(lifeTime_);
+	accumulator_ = 0.0f;
 
 	// Set the rigid body disabled
 	pRigidBody->SetEnabled(false);
@@ -252,3 +358,77 @@ bool Missile::IsActive()
 {
 	return isActive_;
 }
+
+
+// Is the missile in flight
+bool Missile::IsInFlight()
+{
+	return isActive_ && inFlight_;
+}
+
+
+// Attach a pooled particle emitter to the missile
+void Missile::AttachEmitter(Node* node, ParticleEmitter* emitter)
+{
+	// Parent the emitter node to the missile
+	pNodeParticle = node;
+	pNodeParticle->SetParent(pNodeMissile);
+	pNodeParticle->SetPosition(Vector3::ZERO);
+	pNodeParticle->SetRotation(Quaternion::IDENTITY);
+	pNodeParticle->SetScale(2.5f);
+
+	// Start emitting
+	pEmitter_ = emitter;
+	pEmitter_->SetEnabled(true);
+	pEmitter_->SetEmitting(true);
+}
+
+
+// Detach the pooled particle emitter and give it back to the pool node
+void Missile::DetachEmitter(Node* poolNode)
+{
+	// No emitter attached
+	if (!pEmitter_)
+		return;
+
+	// Stop emitting and move the node back to the pool
+	StopEmitter();
+	pNodeParticle->SetParent(poolNode);
+	pNodeParticle = nullptr;
+	pEmitter_ = nullptr;
+}
+
+
+// Does the missile hold a pooled emitter
+bool Missile::HasEmitter()
+{
+	return pEmitter_ != nullptr;
+}
+
+
+// Get the particle emitter
+ParticleEmitter* Missile::GetEmitter()
+{
+	return pEmitter_;
+}
+
+
+// Get the ribbon trail
+RibbonTrail* Missile::GetTrail()
+{
+	return pTrail_;
+}
+
+
+// Stop the attached emitter (if any)
+void Missile::StopEmitter()
+{
+	// No emitter attached
+	if (!pEmitter_)
+		return;
+
+	// Stop emitting
+	pEmitter_->RemoveAllParticles();
+	pEmitter_->SetEmitting(false);
+	pEmitter_->SetEnabled(false);
+}
@@ -18,6 +18,7 @@
 #include <Urho3D/Input/Input.h>
 #include <Urho3D/IO/FileSystem.h>
 #include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/NetworkPriority.h>
 #include <Urho3D/Physics/CollisionShape.h>
 #include <Urho3D/Physics/PhysicsWorld.h>
 #include <Urho3D/Physics/RigidBody.h>
@@ -42,8 +43,29 @@ namespace Urho3D
 // All Urho3D classes reside in namespace Urho3D
 using namespace Urho3D;
 
-// Movement speed of missile
-const float MISSILE_SPEED = 0.75f;
+// Movement speed of missile (units per second)
+const float MISSILE_SPEED = 45.0f;
+
+// Movement speed of a network missile (units per second)
+const float MISSILE_NETWORK_SPEED = 100.0f;
+
+// Life time of a network missile (seconds)
+const float MISSILE_NETWORK_LIFETIME = 50.0f / 60.0f;
+
+// Fixed simulation tick of the missiles (seconds)
+const float MISSILE_TICK = 1.0f / 120.0f;
+
+// Maximum distance a missile may travel in one sub-step
+const float MISSILE_MAX_SUBSTEP = 0.25f;
+
+// What a network missile needs done to its nodes and body after a physics step
+enum MissileStep
+{
+	MISSILE_IDLE = 0,
+	MISSILE_LAUNCH,
+	MISSILE_FLY,
+	MISSILE_EXPIRE
+};
 
 // Missile class
 class Missile
@@ -56,10 +78,14 @@ public:
 		pCollisionShape	(nullptr),
 		pObject			(nullptr),
 		lifeTime_		(5.0f),
+		lifeTicks_		(0),
+		accumulator_	(0.0f),
 		isActive_		(false),
 		inFlight_		(false),
 		isReset_		(false),
-		numbOfParticles_(100),
+		pNodeParticle	(nullptr),
+		pEmitter_		(nullptr),
+		pTrail_			(nullptr),
 		offset_			(Vector3(0.0f, 0.0f, 2.5f)),
 		direction_		(Vector3::ZERO)
 	{}
@@ -70,12 +96,30 @@ public:
 	// Initialisation function
 	void Initialise(ResourceCache* cache, Scene* scene, Node* node);
 
-	// Update - called each frame by the game engine
-	void Update();
+	// Update network missile - called each physics step by the server
+	void UpdateNetwork(float timeStep);
+
+	// Advance the flight of a network missile without touching the scene (safe on a worker thread)
+	MissileStep StepNetwork(float timeStep);
+
+	// Apply a step of a network missile to its nodes and body (main thread)
+	void ApplyNetwork(MissileStep step);
 
 	// Update - called each frame by the game engine
 	void Update(float timeStep);
 
+	// Advance a homing missile by one fixed tick, split into sub-steps
+	static void Integrate(Vector3& position, Quaternion& rotation, const Vector3& targetPosition, float speed, float tick);
+
+	// Advance a homing missile by the whole ticks a frame covers, at most maxTicks - the target is
+	// sampled at each tick, between where it was at the start of the frame and where it is now
+	// - Returns the ticks stepped, and appends the position after each to tickPositions if given
+	static int Advance(Vector3& position, Quaternion& rotation, float& accumulator, int maxTicks, const Vector3& lastTargetPosition,
+		const Vector3& targetPosition, float speed, float timeStep, PODVector<Vector3>* tickPositions = nullptr);
+
+	// Number of fixed ticks a missile lives for
+	static int LifeTicks(float lifeTime);
+
 	// Activate/deactivate the missile
 	void SetActive(bool isActive, Vector3 direction, RigidBody* target);
 
@@ -91,6 +135,24 @@ public:
 	// Is the missile active
 	bool IsActive();
 
+	// Is the missile in flight
+	bool IsInFlight();
+
+	// Attach a pooled particle emitter to the missile
+	void AttachEmitter(Node* node, ParticleEmitter* emitter);
+
+	// Detach the pooled particle emitter and give it back to the pool node
+	void DetachEmitter(Node* poolNode);
+
+	// Does the missile hold a pooled emitter
+	bool HasEmitter();
+
+	// Get the particle emitter
+	ParticleEmitter* GetEmitter();
+
+	// Get the ribbon trail
+	RibbonTrail* GetTrail();
+
 	// Node, particle node and parent object pointer
 	Node* pNodeMissile;
 	Node* pNodeParticle;
@@ -111,11 +173,11 @@ public:
 private:
 	// Missile life time
 	float lifeTime_;
-	float life_;
-	
-	// Number of particles
-	int numbOfParticles_;
 
+	// Remaining life in fixed ticks and the unsimulated frame time
+	int lifeTicks_;
+	float accumulator_;
+	
 	// Bool from in flight missile
 	bool isActive_;
 	bool inFlight_;
@@ -126,8 +188,13 @@ private:
 	Vector3 direction_;
 	RigidBody* target_;
 
-	// Pointer to particle emitter, effect and trail
+	// Target position at the end of the last frame
+	Vector3 lastTargetPosition_;
+
+	// Stop the attached emitter (if any)
+	void StopEmitter();
+
+	// Pointer to particle emitter and trail
 	ParticleEmitter* pEmitter_;
-	ParticleEffect* pParticleEffect_;
 	RibbonTrail* pTrail_;
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+// Include directives
+#include "MissileCheck.h"
+
+
+// Run the check - true if the flights match
+bool MissileCheck::Run(int ticks)
+{
+	// Forget earlier results
+	maxStillError_ = 0.0f;
+	maxMovingError_ = 0.0f;
+	firstFailedTick_ = -1;
+
+	// The first rate's flights are what the others are compared with
+	PODVector<Vector3> stillReference;
+	PODVector<Vector3> movingReference;
+	Fly(MISSILE_CHECK_RATES[0], Vector3::ZERO, ticks, stillReference);
+	Fly(MISSILE_CHECK_RATES[0], MISSILE_CHECK_TARGET_VELOCITY, ticks, movingReference);
+
+	for (int rate = 1; rate < NUM_MISSILE_CHECK_RATES; rate++)
+	{
+		// The same flights at this rate
+		PODVector<Vector3> still;
+		PODVector<Vector3> moving;
+		Fly(MISSILE_CHECK_RATES[rate], Vector3::ZERO, ticks, still);
+		Fly(MISSILE_CHECK_RATES[rate], MISSILE_CHECK_TARGET_VELOCITY, ticks, moving);
+
+		for (int tick = 0; tick < ticks; tick++)
+		{
+			// Still target - exactly the same position
+			bool failed = still[tick] != stillReference[tick];
+			maxStillError_ = Max(maxStillError_, (still[tick] - stillReference[tick]).Length());
+
+			// Moving target - within the bound
+			float error = (moving[tick] - movingReference[tick]).Length();
+			maxMovingError_ = Max(maxMovingError_, error);
+			if (error > MISSILE_CHECK_DRIFT)
+				failed = true;
+
+			// First tick out of bounds
+			if (failed && (firstFailedTick_ < 0 || tick < firstFailedTick_))
+				firstFailedTick_ = tick;
+		}
+	}
+
+	return firstFailedTick_ < 0;
+}
+
+
+// Largest error against the still target - zero when the flights match
+float MissileCheck::GetMaxStillError()
+{
+	return maxStillError_;
+}
+
+
+// Largest error against the moving target
+float MissileCheck::GetMaxMovingError()
+{
+	return maxMovingError_;
+}
+
+
+// First tick out of bounds, -1 if none
+int MissileCheck::GetFirstFailedTick()
+{
+	return firstFailedTick_;
+}
+
+
+// Fly a missile at a frame rate and record its position after each tick
+void MissileCheck::Fly(int frameRate, const Vector3& targetVelocity, int ticks, PODVector<Vector3>& tickPositions)
+{
+	float timeStep = 1.0f / frameRate;
+
+	// Launched from the origin, facing forward
+	Vector3 position = Vector3::ZERO;
+	Quaternion rotation = Quaternion::IDENTITY;
+	float accumulator = 0.0f;
+	Vector3 lastTargetPosition = MISSILE_CHECK_TARGET;
+
+	// A frame at a time until every tick is in
+	tickPositions.Clear();
+	for (int frame = 1; (int)tickPositions.Size() < ticks; frame++)
+	{
+		// The target at the end of the frame - from the frame count, so it does not gather rounding
+		Vector3 targetPosition = MISSILE_CHECK_TARGET + targetVelocity * (frame * timeStep);
+
+		Missile::Advance(position, rotation, accumulator, ticks - (int)tickPositions.Size(), lastTargetPosition,
+			targetPosition, MISSILE_SPEED, timeStep, &tickPositions);
+		lastTargetPosition = targetPosition;
+	}
+}
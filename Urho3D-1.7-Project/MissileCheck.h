@@ -0,0 +1,52 @@
+#pragma once
+
+// Include directives
+#include "Missile.h"
+
+// Ticks of flight checked - short of the target, where the homing turns sharply
+const int MISSILE_CHECK_TICKS = 360;
+
+// Frame rates the flight is checked at (frames a second)
+const int MISSILE_CHECK_RATES[] = { 30, 60, 144 };
+const int NUM_MISSILE_CHECK_RATES = 3;
+
+// Where the target starts, and how fast it moves in the moving run (units per second)
+const Vector3 MISSILE_CHECK_TARGET(0.0f, 20.0f, 200.0f);
+const Vector3 MISSILE_CHECK_TARGET_VELOCITY(20.0f, 5.0f, 0.0f);
+
+// Furthest a tick position of the moving run may be from the first frame rate's (units)
+// - The target is sampled at the same instants at each rate, but interpolated from different frames
+const float MISSILE_CHECK_DRIFT = 1.0e-3f;
+
+// Missile check class
+// - Flies a homing missile with Missile::Advance, as Missile::Update does, at each frame rate
+//   and compares the positions after each tick with the first rate's
+// - Against a still target each tick sees the same inputs, so the positions must match exactly
+// - Against a moving target they must stay within the drift bound
+class MissileCheck
+{
+public:
+	// Constructor
+	MissileCheck() :
+		maxStillError_(0.0f),
+		maxMovingError_(0.0f),
+		firstFailedTick_(-1)
+	{}
+
+	// Run the check - true if the flights match
+	bool Run(int ticks);
+
+	// Results
+	float GetMaxStillError();
+	float GetMaxMovingError();
+	int GetFirstFailedTick();
+
+private:
+	// Fly a missile at a frame rate and record its position after each tick
+	static void Fly(int frameRate, const Vector3& targetVelocity, int ticks, PODVector<Vector3>& tickPositions);
+
+	// Results
+	float maxStillError_;
+	float maxMovingError_;
+	int firstFailedTick_;
+};
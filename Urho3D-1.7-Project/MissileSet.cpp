@@ -11,15 +11,15 @@ void MissileSet::Initialise(ResourceCache* cache, Scene* scene, Node* node)
 }
 
 
-// Update - called each frame by the game engine
-void MissileSet::Update()
+// Update network missiles - called each physics step by the server
+void MissileSet::UpdateNetwork(float timeStep)
 {
 	// Loop through the missiles
 	for (auto& missile : missileList)
 	{
 		// If it is active update it
 		if (missile.IsActive())
-			missile.Update();
+			missile.UpdateNetwork(timeStep);
 
 		// Else set as inactive
 		else
@@ -22,8 +22,8 @@ public:
 	// Shoot the missile(s)
 	void Shoot(Vector3 direction, RigidBody* target);
 
-	// Update - called each frame by the game engine
-	void Update();
+	// Update network missiles - called each physics step by the server
+	void UpdateNetwork(float timeStep);
 
 	// Update - called each frame by the game engine
 	void Update(float timeStep);
@@ -0,0 +1,162 @@
+// Include directives
+#include "PlayerPrediction.h"
+
+
+// Remove the predicted ship and forget the history
+void PlayerPrediction::Clear()
+{
+	// Remove the ship if it is still in the scene
+	if (node_)
+		node_->Remove();
+	node_ = nullptr;
+	body_ = nullptr;
+
+	// Forget the inputs
+	for (unsigned i = 0; i < PREDICTION_HISTORY; i++)
+		history_[i] = InputRecord();
+	sequence_ = 0;
+	lastAcked_ = 0;
+	serverNodeID_ = 0;
+
+	// No correction pending
+	positionError_ = Vector3::ZERO;
+	rotationError_ = Quaternion::IDENTITY;
+	lastError_ = 0.0f;
+}
+
+
+// Tag the controls with the next sequence number and get the ship to apply them to
+RigidBody* PlayerPrediction::Step(Node* serverNode, Controls& controls)
+{
+	// Tag the controls - the server sends the number back with its state
+	sequence_++;
+	controls.extraData_[PREDICTION_SEQUENCE] = sequence_;
+
+	// The replicated ship has gone (or changed) - so has the prediction
+	if (node_ && (!serverNode || serverNode->GetID() != serverNodeID_))
+	{
+		node_->Remove();
+		node_ = nullptr;
+		body_ = nullptr;
+	}
+
+	// No ship to predict
+	if (!serverNode)
+		return nullptr;
+
+	// Build the local ship
+	if (!node_)
+		CreateShip(serverNode);
+
+	// Remember the state the previous input led to
+	InputRecord& previous = history_[(sequence_ - 1) % PREDICTION_HISTORY];
+	if (previous.sequence_ == sequence_ - 1)
+	{
+		previous.stepped_ = true;
+		previous.position_ = body_->GetPosition();
+		previous.rotation_ = body_->GetRotation();
+		previous.linearVelocity_ = body_->GetLinearVelocity();
+		previous.angularVelocity_ = body_->GetAngularVelocity();
+	}
+
+	// The server has applied a newer input - check the prediction for it
+	unsigned acked = serverNode->GetVar(PREDICTION_SEQUENCE).GetUInt();
+	if (acked > lastAcked_)
+	{
+		lastAcked_ = acked;
+		const InputRecord& record = history_[acked % PREDICTION_HISTORY];
+		if (record.sequence_ == acked && record.stepped_)
+			Reconcile(serverNode, record);
+	}
+
+	// Blend in the correction
+	ApplyCorrection();
+
+	// Record the input
+	InputRecord& record = history_[sequence_ % PREDICTION_HISTORY];
+	record = InputRecord();
+	record.sequence_ = sequence_;
+
+	// Return the ship to apply the controls to
+	return body_;
+}
+
+
+// The predicted ship
+Node* PlayerPrediction::GetNode()
+{
+	return node_;
+}
+
+
+// Size of the last error found between the prediction and the server
+float PlayerPrediction::GetLastError()
+{
+	return lastError_;
+}
+
+
+// Build the local ship from the replicated one
+void PlayerPrediction::CreateShip(Node* serverNode)
+{
+	// Same model, body and shape as the server's ship
+	node_ = serverNode->Clone(LOCAL);
+	node_->SetName("PredictedPlayer");
+	body_ = node_->GetComponent<RigidBody>();
+	serverNodeID_ = serverNode->GetID();
+
+	// Only the predicted ship is drawn and simulated
+	serverNode->SetEnabledRecursive(false);
+
+	// Start from the server's state
+	body_->SetLinearVelocity(serverNode->GetComponent<RigidBody>()->GetLinearVelocity());
+	body_->SetAngularVelocity(serverNode->GetComponent<RigidBody>()->GetAngularVelocity());
+	positionError_ = Vector3::ZERO;
+	rotationError_ = Quaternion::IDENTITY;
+}
+
+
+// Compare the server's state with the prediction for the same input
+void PlayerPrediction::Reconcile(Node* serverNode, const InputRecord& record)
+{
+	// Difference between the server's state and the prediction
+	RigidBody* serverBody = serverNode->GetComponent<RigidBody>();
+	Vector3 positionError = serverNode->GetWorldPosition() - record.position_;
+	Quaternion rotationError = serverNode->GetWorldRotation() * record.rotation_.Inverse();
+	lastError_ = positionError.Length();
+
+	// The inputs since then moved the ship on from the wrong state - the velocities are corrected at once
+	body_->SetLinearVelocity(body_->GetLinearVelocity() + serverBody->GetLinearVelocity() - record.linearVelocity_);
+	body_->SetAngularVelocity(body_->GetAngularVelocity() + serverBody->GetAngularVelocity() - record.angularVelocity_);
+
+	// Too far out to blend - snap to the corrected state
+	if (lastError_ > PREDICTION_SNAP_DISTANCE)
+	{
+		body_->SetPosition(body_->GetPosition() + positionError);
+		body_->SetRotation(rotationError * body_->GetRotation());
+		positionError_ = Vector3::ZERO;
+		rotationError_ = Quaternion::IDENTITY;
+		return;
+	}
+
+	// The new error replaces what is left of the old one - the recorded states already include its applied part
+	positionError_ = positionError;
+	rotationError_ = rotationError;
+}
+
+
+// Blend part of the remaining correction into the ship
+void PlayerPrediction::ApplyCorrection()
+{
+	// Part of the position error
+	Vector3 positionStep = positionError_ * PREDICTION_SMOOTHING;
+	positionError_ -= positionStep;
+
+	// Part of the rotation error
+	Quaternion rotationStep = Quaternion::IDENTITY.Slerp(rotationError_, PREDICTION_SMOOTHING);
+	rotationError_ = rotationError_ * rotationStep.Inverse();
+
+	// Move the ship
+	body_->SetPosition(body_->GetPosition() + positionStep);
+	body_->SetRotation(rotationStep * body_->GetRotation());
+}
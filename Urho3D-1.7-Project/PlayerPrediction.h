@@ -0,0 +1,93 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Scene.h>
+
+// Name of the input sequence number, in the client's controls and the server's player node vars
+static const StringHash PREDICTION_SEQUENCE("InputSequence");
+
+// Number of inputs kept to reconcile against (two seconds at 60 physics steps a second)
+const unsigned PREDICTION_HISTORY = 128;
+
+// Fraction of the remaining correction applied each physics step
+const float PREDICTION_SMOOTHING = 0.15f;
+
+// Errors larger than this are corrected at once
+const float PREDICTION_SNAP_DISTANCE = 8.0f;
+
+// Player prediction class
+// - The client flies a local copy of its own ship with the same control to force mapping as the
+//   server, so its inputs are seen at once instead of after a round trip
+// - Each input is tagged with a sequence number and the predicted state it led to is kept
+// - The server puts the sequence number of the last input it applied in the player node vars;
+//   when that changes the replicated state is compared with the predicted state for the same
+//   input, and the difference is blended into the local ship over the following steps
+// - The replicated ship is disabled on the client while it is predicted
+class PlayerPrediction
+{
+public:
+	// Constructor
+	PlayerPrediction() :
+		sequence_(0),
+		lastAcked_(0),
+		serverNodeID_(0),
+		positionError_(Vector3::ZERO),
+		rotationError_(Quaternion::IDENTITY),
+		lastError_(0.0f)
+	{}
+
+	// Remove the predicted ship and forget the history
+	void Clear();
+
+	// Tag the controls with the next sequence number and get the ship to apply them to - called
+	// each physics pre-step on the client, returns null while the client has no ship
+	RigidBody* Step(Node* serverNode, Controls& controls);
+
+	// The predicted ship (null while the client has no ship)
+	Node* GetNode();
+
+	// Size of the last error found between the prediction and the server
+	float GetLastError();
+
+private:
+	// The predicted state after an input
+	struct InputRecord
+	{
+		unsigned sequence_ = 0;
+		bool stepped_ = false;
+		Vector3 position_;
+		Quaternion rotation_;
+		Vector3 linearVelocity_;
+		Vector3 angularVelocity_;
+	};
+
+	// Build the local ship from the replicated one
+	void CreateShip(Node* serverNode);
+
+	// Compare the server's state with the prediction for the same input
+	void Reconcile(Node* serverNode, const InputRecord& record);
+
+	// Blend part of the remaining correction into the ship
+	void ApplyCorrection();
+
+	// The predicted ship
+	WeakPtr<Node> node_;
+	RigidBody* body_ = nullptr;
+
+	// Recent inputs and the states they led to
+	InputRecord history_[PREDICTION_HISTORY];
+
+	// Sequence number of the last input sent and the last one applied by the server
+	unsigned sequence_;
+	unsigned lastAcked_;
+
+	// ID of the replicated ship
+	unsigned serverNodeID_;
+
+	// Correction still to be applied
+	Vector3 positionError_;
+	Quaternion rotationError_;
+	float lastError_;
+};
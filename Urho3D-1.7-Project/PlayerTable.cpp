@@ -0,0 +1,106 @@
+// Include directives
+#include "PlayerTable.h"
+
+
+// Destructor
+PlayerTable::~PlayerTable()
+{
+	Clear();
+}
+
+
+// Add a player for a connection - returns the slot
+PlayerSlot& PlayerTable::Add(Connection* connection, Node* node, MissileSet* missiles)
+{
+	// Reuse a free slot, or add one
+	unsigned index;
+	if (!free_.empty())
+	{
+		index = free_.back();
+		free_.pop_back();
+	}
+	else
+	{
+		index = (unsigned)slots_.size();
+		slots_.push_back(PlayerSlot());
+	}
+
+	// Fill it in
+	PlayerSlot& slot = slots_[index];
+	slot = PlayerSlot();
+	slot.connection_ = connection;
+	slot.node_ = node;
+	slot.body_ = node->GetComponent<RigidBody>();
+	slot.missiles_ = missiles;
+	slot.active_ = true;
+	numPlayers_++;
+	return slot;
+}
+
+
+// The slot of a connection, null if it has none
+PlayerSlot* PlayerTable::Find(Connection* connection)
+{
+	for (auto& slot : slots_)
+	{
+		if (slot.active_ && slot.connection_ == connection)
+			return &slot;
+	}
+	return nullptr;
+}
+
+
+// Free a slot and delete its missiles
+void PlayerTable::Remove(PlayerSlot& slot)
+{
+	// Already free
+	if (!slot.active_)
+		return;
+
+	// Delete the missiles and empty the slot
+	delete slot.missiles_;
+	slot = PlayerSlot();
+
+	// Hand the slot to the next player
+	free_.push_back(IndexOf(slot));
+	numPlayers_--;
+}
+
+
+// Free every slot
+void PlayerTable::Clear()
+{
+	for (auto& slot : slots_)
+		delete slot.missiles_;
+	slots_.clear();
+	free_.clear();
+	numPlayers_ = 0;
+}
+
+
+// Number of slots (including free ones)
+unsigned PlayerTable::GetNumSlots()
+{
+	return (unsigned)slots_.size();
+}
+
+
+// A slot by index
+PlayerSlot& PlayerTable::GetSlot(unsigned index)
+{
+	return slots_[index];
+}
+
+
+// Index of a slot
+unsigned PlayerTable::IndexOf(const PlayerSlot& slot)
+{
+	return (unsigned)(&slot - slots_.data());
+}
+
+
+// Number of slots in use
+unsigned PlayerTable::GetNumPlayers()
+{
+	return numPlayers_;
+}
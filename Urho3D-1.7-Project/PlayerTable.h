@@ -0,0 +1,113 @@
+#pragma once
+
+// Include directives
+#include <vector>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include "MissileSet.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Number of player slots reserved up front
+const unsigned MAX_PLAYERS = 64;
+
+// Changes to the physics worked out for a player on a worker thread, applied on the main thread
+struct PlayerCommands
+{
+	// Ship torque and force
+	Vector3 torque_;
+	Vector3 force_;
+
+	// Input sequence to send back for the client's prediction
+	Variant sequence_;
+
+	// What each missile needs done
+	MissileStep missileSteps_[NUMBER_OF_MISSILES];
+
+	// A missile was fired
+	bool fired_ = false;
+};
+
+// Server state of one connected player
+struct PlayerSlot
+{
+	// Connection controlling the player
+	Connection* connection_ = nullptr;
+
+	// Ship node and body
+	WeakPtr<Node> node_;
+	RigidBody* body_ = nullptr;
+
+	// Missiles (owned by the table)
+	MissileSet* missiles_ = nullptr;
+
+	// Controls of the current physics step - from the connection, or a replayed session
+	Controls controls_;
+
+	// Time left before the player can fire again
+	float fireCooldown_ = 0.0f;
+
+	// Commands of the current physics step
+	PlayerCommands commands_;
+
+	// Statistics
+	unsigned shots_ = 0;
+	unsigned kills_ = 0;
+
+	// Slot in use
+	bool active_ = false;
+};
+
+// Player table class
+// - Holds the server state of every player in one dense array of slots, so the per-frame
+//   loops walk memory in order instead of looking each connection up in several hash maps
+// - A connection is looked up only when it joins or leaves; a freed slot is reused by the
+//   next player to join
+// - Owns the missile set of each player
+class PlayerTable
+{
+public:
+	// Constructor
+	PlayerTable() :
+		numPlayers_(0)
+	{
+		slots_.reserve(MAX_PLAYERS);
+		free_.reserve(MAX_PLAYERS);
+	}
+
+	// Destructor
+	~PlayerTable();
+
+	// Add a player for a connection - returns the slot
+	PlayerSlot& Add(Connection* connection, Node* node, MissileSet* missiles);
+
+	// The slot of a connection, null if it has none
+	PlayerSlot* Find(Connection* connection);
+
+	// Free a slot and delete its missiles
+	void Remove(PlayerSlot& slot);
+
+	// Free every slot
+	void Clear();
+
+	// Number of slots (including free ones) and a slot by index
+	unsigned GetNumSlots();
+	PlayerSlot& GetSlot(unsigned index);
+
+	// Index of a slot
+	unsigned IndexOf(const PlayerSlot& slot);
+
+	// Number of slots in use
+	unsigned GetNumPlayers();
+
+private:
+	// Player slots
+	std::vector<PlayerSlot> slots_;
+
+	// Indices of the free slots
+	std::vector<unsigned> free_;
+
+	// Number of slots in use
+	unsigned numPlayers_;
+};
@@ -0,0 +1,172 @@
+// Include directives
+#include <cstdio>
+#include <Urho3D/IO/Log.h>
+#include "QualityGovernor.h"
+
+
+// Start governing to the frame time budget (seconds) - sets the default level
+void QualityGovernor::Initialise(float budget, const QualityLevel& defaults, BoidLod* boidLod, ShadowBudget* shadowBudget, EffectsBudget* effectsBudget, bool adjustPhases)
+{
+	// What the levels set
+	boidLod_ = boidLod;
+	shadowBudget_ = shadowBudget;
+	effectsBudget_ = effectsBudget;
+	adjustPhases_ = adjustPhases;
+	boidSets_.clear();
+
+	// Each level scaled from the defaults
+	for (int i = 0; i < NUM_QUALITY_LEVELS; i++)
+	{
+		const QualityScale& scale = QUALITY_SCALES[i];
+		QualityLevel& level = levels_[i];
+		level.simpleDistance_ = defaults.simpleDistance_ * scale.distance_;
+		level.impostorDistance_ = defaults.impostorDistance_ * scale.distance_;
+		level.updatePhases_ = Max(defaults.updatePhases_ + scale.extraPhases_, 1);
+		level.shadowCasters_ = RoundToInt(defaults.shadowCasters_ * scale.shadowCasters_);
+		level.maxParticles_ = RoundToInt(defaults.maxParticles_ * scale.effects_);
+		level.maxTrailSegments_ = RoundToInt(defaults.maxTrailSegments_ * scale.effects_);
+	}
+
+	// Start a fresh window at the default level
+	budget_ = (long long)(budget * 1000000.0f);
+	windowTime_ = 0;
+	windowFrames_ = 0;
+	quietWindows_ = 0;
+	settleWindows_ = QUALITY_SETTLE_WINDOWS;
+	enabled_ = true;
+	SetLevel(QUALITY_DEFAULT_LEVEL, 0.0f);
+}
+
+
+// Stop governing - puts the default level back and forgets the boid sets
+void QualityGovernor::Reset()
+{
+	if (enabled_)
+		ApplyLevel(levels_[QUALITY_DEFAULT_LEVEL]);
+	enabled_ = false;
+	level_ = QUALITY_DEFAULT_LEVEL;
+	boidSets_.clear();
+}
+
+
+// Add a set of boids whose update phases are governed
+void QualityGovernor::AddBoidSet(BoidSet* boidSet)
+{
+	boidSets_.push_back(boidSet);
+	if (adjustPhases_)
+		boidSet->SetUpdatePhases(levels_[level_].updatePhases_);
+}
+
+
+// Is the governor running
+bool QualityGovernor::IsEnabled()
+{
+	return enabled_;
+}
+
+
+// Start timing a frame's work
+void QualityGovernor::BeginFrame()
+{
+	frameStart_ = timer_.GetUSec(false);
+}
+
+
+// End timing a frame's work - decides once a window of frames is timed
+void QualityGovernor::EndFrame()
+{
+	if (!enabled_)
+		return;
+
+	// Add the frame to the window
+	windowTime_ += timer_.GetUSec(false) - frameStart_;
+	if (++windowFrames_ < QUALITY_WINDOW)
+		return;
+
+	// Average work of the window
+	long long average = windowTime_ / windowFrames_;
+	windowTime_ = 0;
+	windowFrames_ = 0;
+
+	// Still settling after a change
+	if (settleWindows_)
+	{
+		settleWindows_--;
+		return;
+	}
+
+	// Over the budget - lower the quality at once
+	if (average > budget_)
+	{
+		quietWindows_ = 0;
+		if (level_ > 0)
+			SetLevel(level_ - 1, average / 1000.0f);
+		return;
+	}
+
+	// Well under it for long enough - raise the quality
+	if (average < budget_ * QUALITY_RAISE_FRACTION)
+	{
+		if (++quietWindows_ >= QUALITY_RAISE_WINDOWS && level_ < NUM_QUALITY_LEVELS - 1)
+		{
+			quietWindows_ = 0;
+			SetLevel(level_ + 1, average / 1000.0f);
+		}
+	}
+	else
+		quietWindows_ = 0;
+}
+
+
+// Current quality level
+int QualityGovernor::GetLevel()
+{
+	return level_;
+}
+
+
+// Apply a level, logging why
+void QualityGovernor::SetLevel(int level, float frameTime)
+{
+	const QualityLevel& settings = levels_[level];
+	ApplyLevel(settings);
+
+	// Log the decision
+	char text[240];
+	if (frameTime > 0.0f)
+		snprintf(text, sizeof(text), "Quality %d -> %d: frame work %.2f ms against a budget of %.2f ms", level_, level, frameTime, budget_ / 1000.0f);
+	else
+		snprintf(text, sizeof(text), "Quality %d: budget of %.2f ms", level, budget_ / 1000.0f);
+	URHO3D_LOGINFO(text);
+	snprintf(text, sizeof(text), "  LOD at %.0f / %.0f, %d update phases%s, %d shadow casters, %d particles, %d trail segments",
+		settings.simpleDistance_, settings.impostorDistance_, settings.updatePhases_, adjustPhases_ ? "" : " (not applied at the tick)",
+		settings.shadowCasters_, settings.maxParticles_, settings.maxTrailSegments_);
+	URHO3D_LOGINFO(text);
+
+	// Measure the new level before deciding again
+	level_ = level;
+	settleWindows_ = QUALITY_SETTLE_WINDOWS;
+}
+
+
+// Apply a level's settings
+void QualityGovernor::ApplyLevel(const QualityLevel& settings)
+{
+	// Level of detail, shadows and effects
+	if (boidLod_)
+		boidLod_->SetDistances(settings.simpleDistance_, settings.impostorDistance_);
+	if (shadowBudget_)
+		shadowBudget_->SetMaxCasters(settings.shadowCasters_);
+	if (effectsBudget_)
+	{
+		effectsBudget_->SetMaxParticles(settings.maxParticles_);
+		effectsBudget_->SetMaxTrailSegments(settings.maxTrailSegments_);
+	}
+
+	// Update phases - not for a flock run at the tick, which must update the same boids each run
+	if (adjustPhases_)
+	{
+		for (auto boidSet : boidSets_)
+			boidSet->SetUpdatePhases(settings.updatePhases_);
+	}
+}
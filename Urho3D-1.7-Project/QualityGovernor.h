@@ -0,0 +1,148 @@
+#pragma once
+
+// Include directives
+#include <vector>
+#include <Urho3D/Core/Timer.h>
+#include "BoidLod.h"
+#include "EffectsBudget.h"
+#include "ShadowBudget.h"
+
+// Settings of a quality level
+struct QualityLevel
+{
+	// Boid level of detail switch distances
+	float simpleDistance_;
+	float impostorDistance_;
+
+	// Update phases of each boid set
+	int updatePhases_;
+
+	// Boids casting shadows
+	int shadowCasters_;
+
+	// Particle and trail budgets of the missile effects
+	int maxParticles_;
+	int maxTrailSegments_;
+};
+
+// How a quality level scales the default one
+struct QualityScale
+{
+	// Boid level of detail switch distances
+	float distance_;
+
+	// Update phases added (at least one is kept)
+	int extraPhases_;
+
+	// Boids casting shadows
+	float shadowCasters_;
+
+	// Particle and trail budgets of the missile effects
+	float effects_;
+};
+
+// Quality levels, lowest first - the middle one is the settings the game runs with
+const int NUM_QUALITY_LEVELS = 5;
+const int QUALITY_DEFAULT_LEVEL = 2;
+static const QualityScale QUALITY_SCALES[NUM_QUALITY_LEVELS] =
+{
+	{ 0.4f, 2, 0.0f, 0.25f },
+	{ 0.7f, 1, 0.33f, 0.5f },
+	{ 1.0f, 0, 1.0f, 1.0f },
+	{ 1.3f, -1, 2.0f, 1.5f },
+	{ 1.75f, -1, 4.0f, 2.0f }
+};
+
+// Frames averaged for each decision
+const unsigned QUALITY_WINDOW = 30;
+
+// Fraction of the budget under which a window counts towards raising the quality
+const float QUALITY_RAISE_FRACTION = 0.75f;
+
+// Windows in a row under that fraction before the quality is raised
+const unsigned QUALITY_RAISE_WINDOWS = 4;
+
+// Windows after a change before the next decision, so its effect is measured first
+const unsigned QUALITY_SETTLE_WINDOWS = 2;
+
+// Quality governor class
+// - Times the work of each frame (from its start to the end of rendering, so neither the frame
+//   limiter nor vertical sync counts) against a frame time budget
+// - Lowers the quality level as soon as a window of frames averages over the budget, and
+//   raises it only after several windows in a row well under it, waiting for each change to
+//   settle - so it neither stutters nor flips back and forth
+// - A level sets the boid LOD distances, the update phases of the boid sets, the shadow
+//   caster budget and the missile particle and trail budgets; each change is logged
+// - The default level is the settings the game was started with (-halfupdate, -shadowcasters
+//   and the effects budgets), and the others are scaled from it
+class QualityGovernor
+{
+public:
+	// Constructor
+	QualityGovernor() :
+		enabled_(false),
+		budget_(0),
+		level_(QUALITY_DEFAULT_LEVEL),
+		boidLod_(nullptr),
+		shadowBudget_(nullptr),
+		effectsBudget_(nullptr),
+		adjustPhases_(true),
+		frameStart_(0),
+		windowTime_(0),
+		windowFrames_(0),
+		quietWindows_(0),
+		settleWindows_(0)
+	{}
+
+	// Start governing to the frame time budget (seconds) - sets the default level
+	// - The update phases are left alone when adjustPhases is false (a flock run at the tick)
+	void Initialise(float budget, const QualityLevel& defaults, BoidLod* boidLod, ShadowBudget* shadowBudget, EffectsBudget* effectsBudget, bool adjustPhases);
+
+	// Stop governing - puts the default level back and forgets the boid sets
+	void Reset();
+
+	// Add a set of boids whose update phases are governed
+	void AddBoidSet(BoidSet* boidSet);
+
+	// Is the governor running
+	bool IsEnabled();
+
+	// Time a frame's work - called at its start and at the end of its rendering
+	void BeginFrame();
+	void EndFrame();
+
+	// Current quality level
+	int GetLevel();
+
+private:
+	// Apply a level, logging why
+	void SetLevel(int level, float frameTime);
+
+	// Apply a level's settings
+	void ApplyLevel(const QualityLevel& settings);
+
+	// Running, and the budget (microseconds)
+	bool enabled_;
+	long long budget_;
+
+	// Current level, and the settings of each
+	int level_;
+	QualityLevel levels_[NUM_QUALITY_LEVELS];
+
+	// What the levels set
+	BoidLod* boidLod_;
+	ShadowBudget* shadowBudget_;
+	EffectsBudget* effectsBudget_;
+	std::vector<BoidSet*> boidSets_;
+	bool adjustPhases_;
+
+	// Work time of the frame and the window
+	HiresTimer timer_;
+	long long frameStart_;
+	long long windowTime_;
+	unsigned windowFrames_;
+
+	// Windows in a row well under the budget, and windows left to settle
+	unsigned quietWindows_;
+	unsigned settleWindows_;
+};
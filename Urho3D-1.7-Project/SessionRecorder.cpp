@@ -0,0 +1,144 @@
+// Include directives
+#include <Urho3D/IO/Log.h>
+#include "SessionRecorder.h"
+
+
+// Start recording to the file
+bool SessionRecorder::Start(Context* context, const String& fileName, const SessionHeader& header)
+{
+	// Open the file
+	file_ = new File(context, fileName, FILE_WRITE);
+	if (!file_->IsOpen())
+	{
+		URHO3D_LOGERRORF("Could not record the session to %s", fileName.CString());
+		file_.Reset();
+		return false;
+	}
+
+	// Header
+	file_->WriteFileID("FSES");
+	file_->WriteUInt(SESSION_VERSION);
+	file_->WriteUInt(header.seed_);
+	file_->WriteInt(header.numbOfBoids_);
+	file_->WriteBool(header.useGroups_);
+	file_->WriteBool(header.copy_);
+	file_->WriteBool(header.limit_);
+	file_->WriteBool(header.halfUpdate_);
+	file_->WriteBool(header.useLockstep_);
+	file_->WriteBool(header.useFlockChannel_);
+	file_->WriteString(header.wavesFile_);
+	file_->WriteFloat(header.tickStep_);
+
+	// Nothing recorded yet
+	controls_.clear();
+	numTicks_ = 0;
+	recording_ = true;
+	URHO3D_LOGINFOF("Recording the session to %s", fileName.CString());
+	return true;
+}
+
+
+// Is a session being recorded
+bool SessionRecorder::IsRecording()
+{
+	return recording_;
+}
+
+
+// Record a player getting a ship
+void SessionRecorder::RecordJoin(unsigned player)
+{
+	if (!recording_)
+		return;
+
+	// A new ship starts without controls
+	if (player >= controls_.size())
+		controls_.resize(player + 1);
+	controls_[player] = Controls();
+
+	file_->WriteUByte(SESSION_JOIN);
+	file_->WriteVLE(player);
+}
+
+
+// Record a player losing their ship
+void SessionRecorder::RecordLeave(unsigned player)
+{
+	if (!recording_)
+		return;
+
+	file_->WriteUByte(SESSION_LEAVE);
+	file_->WriteVLE(player);
+}
+
+
+// Record a player's controls for the tick - written only if they changed
+void SessionRecorder::RecordControls(unsigned player, const Controls& controls)
+{
+	if (!recording_)
+		return;
+
+	// Same as last tick
+	if (player >= controls_.size())
+		controls_.resize(player + 1);
+	Controls& last = controls_[player];
+	if (controls.buttons_ == last.buttons_ && controls.yaw_ == last.yaw_ && controls.pitch_ == last.pitch_)
+		return;
+	last.buttons_ = controls.buttons_;
+	last.yaw_ = controls.yaw_;
+	last.pitch_ = controls.pitch_;
+
+	file_->WriteUByte(SESSION_CONTROLS);
+	file_->WriteVLE(player);
+	file_->WriteVLE(controls.buttons_);
+	file_->WriteFloat(controls.yaw_);
+	file_->WriteFloat(controls.pitch_);
+}
+
+
+// Record a missile fired
+void SessionRecorder::RecordFire(unsigned player)
+{
+	if (!recording_)
+		return;
+
+	file_->WriteUByte(SESSION_FIRE);
+	file_->WriteVLE(player);
+}
+
+
+// Record a boid killed
+void SessionRecorder::RecordKill(unsigned player, unsigned boidID)
+{
+	if (!recording_)
+		return;
+
+	file_->WriteUByte(SESSION_KILL);
+	file_->WriteVLE(player);
+	file_->WriteUInt(boidID);
+}
+
+
+// End the tick
+void SessionRecorder::EndTick()
+{
+	if (!recording_)
+		return;
+
+	file_->WriteUByte(SESSION_TICK);
+	numTicks_++;
+}
+
+
+// End the session and close the file
+void SessionRecorder::Stop()
+{
+	if (!recording_)
+		return;
+
+	file_->WriteUByte(SESSION_END);
+	URHO3D_LOGINFOF("Recorded %u ticks to %s", numTicks_, file_->GetName().CString());
+	file_->Close();
+	file_.Reset();
+	recording_ = false;
+}
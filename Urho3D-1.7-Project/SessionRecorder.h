@@ -0,0 +1,94 @@
+#pragma once
+
+// Include directives
+#include <vector>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/File.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Version of the session file
+const unsigned SESSION_VERSION = 2;
+
+// Records of a session file - each a byte, then its fields
+enum SessionRecord
+{
+	SESSION_END = 0,		// end of the session
+	SESSION_TICK,			// end of a physics tick
+	SESSION_JOIN,			// player (VLE) got a ship
+	SESSION_LEAVE,			// player (VLE) lost it
+	SESSION_CONTROLS,		// player (VLE), buttons (VLE), yaw and pitch (floats) - only when changed
+	SESSION_FIRE,			// player (VLE) fired a missile
+	SESSION_KILL			// player (VLE) killed a boid (node ID)
+};
+
+// What the session was started with - a replay builds the same flock from it
+// - The replication mode decides whether the boids get replicated or local node IDs, which the
+//   recorded kills are keyed by, and the waves file (empty without waves) what the wave director
+//   spawns - its spawn points come from the seed
+struct SessionHeader
+{
+	unsigned seed_ = 0;
+	int numbOfBoids_ = 0;
+	bool useGroups_ = false;
+	bool copy_ = false;
+	bool limit_ = false;
+	bool halfUpdate_ = false;
+	bool useLockstep_ = false;
+	bool useFlockChannel_ = true;
+	String wavesFile_;
+	float tickStep_ = 1.0f / 60.0f;
+};
+
+// Session recorder class
+// - Writes what the players of a server did to a compact binary file: each physics tick's
+//   controls of each player (only when they change), missile fire and kill events, and the
+//   players joining and leaving, keyed by their slot in the player table
+// - Together with the header's seed and flock settings this is enough for SessionReplay to
+//   drive the same game again without a network
+// - Everything is recorded on the main thread
+class SessionRecorder
+{
+public:
+	// Constructor
+	SessionRecorder() :
+		recording_(false),
+		numTicks_(0)
+	{}
+
+	// Start recording to the file
+	bool Start(Context* context, const String& fileName, const SessionHeader& header);
+
+	// Is a session being recorded
+	bool IsRecording();
+
+	// Record a player getting a ship and losing it
+	void RecordJoin(unsigned player);
+	void RecordLeave(unsigned player);
+
+	// Record a player's controls for the tick - written only if they changed
+	void RecordControls(unsigned player, const Controls& controls);
+
+	// Record a missile fired and a boid killed
+	void RecordFire(unsigned player);
+	void RecordKill(unsigned player, unsigned boidID);
+
+	// End the tick
+	void EndTick();
+
+	// End the session and close the file
+	void Stop();
+
+private:
+	// Output file
+	SharedPtr<File> file_;
+	bool recording_;
+
+	// Last controls written for each player
+	std::vector<Controls> controls_;
+
+	// Ticks recorded
+	unsigned numTicks_;
+};
@@ -0,0 +1,210 @@
+// Include directives
+#include <Urho3D/IO/Log.h>
+#include "SessionReplay.h"
+
+
+// Open a session file - reads its header
+bool SessionReplay::Open(Context* context, const String& fileName)
+{
+	// Open the file
+	file_ = new File(context, fileName, FILE_READ);
+	if (!file_->IsOpen() || file_->ReadFileID() != "FSES")
+	{
+		URHO3D_LOGERRORF("%s is not a session file", fileName.CString());
+		file_.Reset();
+		return false;
+	}
+
+	// A session of another version
+	unsigned version = file_->ReadUInt();
+	if (version != SESSION_VERSION)
+	{
+		URHO3D_LOGERRORF("%s is a session of version %u, not %u", fileName.CString(), version, SESSION_VERSION);
+		file_.Reset();
+		return false;
+	}
+
+	// Header
+	header_.seed_ = file_->ReadUInt();
+	header_.numbOfBoids_ = file_->ReadInt();
+	header_.useGroups_ = file_->ReadBool();
+	header_.copy_ = file_->ReadBool();
+	header_.limit_ = file_->ReadBool();
+	header_.halfUpdate_ = file_->ReadBool();
+	header_.useLockstep_ = file_->ReadBool();
+	header_.useFlockChannel_ = file_->ReadBool();
+	header_.wavesFile_ = file_->ReadString();
+	header_.tickStep_ = file_->ReadFloat();
+
+	// Nothing played yet
+	changes_.clear();
+	controls_.clear();
+	kills_.clear();
+	numFires_ = 0;
+	numKills_ = 0;
+	totalTicks_ = 0;
+	totalFires_ = 0;
+	totalKills_ = 0;
+	open_ = true;
+	return true;
+}
+
+
+// Is a session being played back
+bool SessionReplay::IsOpen()
+{
+	return open_;
+}
+
+
+// What the session was started with
+const SessionHeader& SessionReplay::GetHeader()
+{
+	return header_;
+}
+
+
+// Read the next tick - false at the end of the session
+bool SessionReplay::ReadTick()
+{
+	if (!open_)
+		return false;
+
+	// Forget the last tick's events - the controls hold until they change
+	changes_.clear();
+	kills_.clear();
+	numFires_ = 0;
+	numKills_ = 0;
+
+	// Read up to the end of the tick
+	while (!file_->IsEof())
+	{
+		unsigned char record = file_->ReadUByte();
+		switch (record)
+		{
+		case SESSION_TICK:
+			totalTicks_++;
+			return true;
+
+		case SESSION_JOIN:
+		case SESSION_LEAVE:
+		{
+			SessionChange change;
+			change.join_ = record == SESSION_JOIN;
+			change.player_ = file_->ReadVLE();
+
+			// A new ship starts without controls
+			if (change.player_ >= controls_.size())
+				controls_.resize(change.player_ + 1);
+			controls_[change.player_] = Controls();
+			changes_.push_back(change);
+			break;
+		}
+
+		case SESSION_CONTROLS:
+		{
+			unsigned player = file_->ReadVLE();
+			if (player >= controls_.size())
+				controls_.resize(player + 1);
+			Controls& controls = controls_[player];
+			controls.buttons_ = file_->ReadVLE();
+			controls.yaw_ = file_->ReadFloat();
+			controls.pitch_ = file_->ReadFloat();
+			break;
+		}
+
+		case SESSION_FIRE:
+			file_->ReadVLE();
+			numFires_++;
+			totalFires_++;
+			break;
+
+		case SESSION_KILL:
+		{
+			SessionKill kill;
+			kill.player_ = file_->ReadVLE();
+			kill.boidID_ = file_->ReadUInt();
+			kills_.push_back(kill);
+			numKills_++;
+			totalKills_++;
+			break;
+		}
+
+		case SESSION_END:
+			return false;
+
+		// Not a record - the file is damaged
+		default:
+			URHO3D_LOGERRORF("Bad record %u in the session after tick %u", record, totalTicks_);
+			return false;
+		}
+	}
+
+	// Ended without an end record (the recording server was killed)
+	return false;
+}
+
+
+// Players who joined or left before the tick
+const std::vector<SessionChange>& SessionReplay::GetChanges()
+{
+	return changes_;
+}
+
+
+// A player's controls for the tick
+const Controls& SessionReplay::GetControls(unsigned player)
+{
+	static const Controls none;
+	return player < controls_.size() ? controls_[player] : none;
+}
+
+
+// Missiles fired in the tick
+unsigned SessionReplay::GetNumFires()
+{
+	return numFires_;
+}
+
+
+// Boids killed since the last tick
+unsigned SessionReplay::GetNumKills()
+{
+	return numKills_;
+}
+
+
+// Boids killed since the last tick - who killed them and their node IDs
+const std::vector<SessionKill>& SessionReplay::GetKills()
+{
+	return kills_;
+}
+
+
+// Ticks read so far
+unsigned SessionReplay::GetTotalTicks()
+{
+	return totalTicks_;
+}
+
+
+// Missiles fired so far
+unsigned SessionReplay::GetTotalFires()
+{
+	return totalFires_;
+}
+
+
+// Boids killed so far
+unsigned SessionReplay::GetTotalKills()
+{
+	return totalKills_;
+}
+
+
+// Stop playing back
+void SessionReplay::Close()
+{
+	file_.Reset();
+	open_ = false;
+}
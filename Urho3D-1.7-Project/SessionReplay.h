@@ -0,0 +1,89 @@
+#pragma once
+
+// Include directives
+#include "SessionRecorder.h"
+
+// A player joining or leaving, in the order recorded
+struct SessionChange
+{
+	bool join_;
+	unsigned player_;
+};
+
+// A boid killed, as recorded
+struct SessionKill
+{
+	unsigned player_;
+	unsigned boidID_;
+};
+
+// Session replay class
+// - Reads a file written by SessionRecorder back one physics tick at a time: the players who
+//   joined or left before the tick, every player's controls for it, the boids killed since the
+//   last tick, which the game applies, and the missiles fired, which it compares with its own
+//   to spot a replay that has drifted
+// - The game plays the ticks back headless at a fixed step, as fast as it can
+class SessionReplay
+{
+public:
+	// Constructor
+	SessionReplay() :
+		open_(false),
+		numFires_(0),
+		numKills_(0),
+		totalTicks_(0),
+		totalFires_(0),
+		totalKills_(0)
+	{}
+
+	// Open a session file - reads its header
+	bool Open(Context* context, const String& fileName);
+
+	// Is a session being played back
+	bool IsOpen();
+
+	// What the session was started with
+	const SessionHeader& GetHeader();
+
+	// Read the next tick - false at the end of the session
+	bool ReadTick();
+
+	// Players who joined or left before the tick
+	const std::vector<SessionChange>& GetChanges();
+
+	// A player's controls for the tick
+	const Controls& GetControls(unsigned player);
+
+	// Missiles fired in the tick, and boids killed since the last one
+	unsigned GetNumFires();
+	unsigned GetNumKills();
+	const std::vector<SessionKill>& GetKills();
+
+	// Totals read so far
+	unsigned GetTotalTicks();
+	unsigned GetTotalFires();
+	unsigned GetTotalKills();
+
+	// Stop playing back
+	void Close();
+
+private:
+	// Input file
+	SharedPtr<File> file_;
+	bool open_;
+
+	// Header
+	SessionHeader header_;
+
+	// The tick read
+	std::vector<SessionChange> changes_;
+	std::vector<Controls> controls_;
+	unsigned numFires_;
+	unsigned numKills_;
+	std::vector<SessionKill> kills_;
+
+	// Totals
+	unsigned totalTicks_;
+	unsigned totalFires_;
+	unsigned totalKills_;
+};
@@ -0,0 +1,177 @@
+// Include directives
+#include "ShadowBudget.h"
+
+// Radius of a boid used for the projected size and the on screen test
+static const float BOID_SHADOW_RADIUS = 1.0f;
+
+
+// Add a set of boids to be managed
+void ShadowBudget::AddBoidSet(BoidSet* boidSet)
+{
+	// Boids are created casting shadows - they start out of the casters, and join as they are scored
+	for (int i = 0; i < boidSet->numberOfBoids_; i++)
+	{
+		Entry entry;
+		entry.boidSet_ = boidSet;
+		entry.index_ = i;
+		entry.score_ = 0.0f;
+		entry.caster_ = false;
+		entries_.push_back(entry);
+		boidSet->boidList[i].pObject->SetCastShadows(false);
+	}
+}
+
+
+// Forget the boid sets (the scene has been cleared)
+void ShadowBudget::Clear()
+{
+	entries_.clear();
+	casters_.clear();
+	nextEntry_ = 0;
+	numCasters_ = 0;
+}
+
+
+// Update - called each frame after the physics step
+void ShadowBudget::Update(Node* cameraNode)
+{
+	// Nothing to manage
+	Camera* camera = cameraNode ? cameraNode->GetComponent<Camera>() : nullptr;
+	if (entries_.empty() || !camera)
+		return;
+
+	// Camera position and frustum
+	Vector3 cameraPosition = cameraNode->GetWorldPosition();
+	const Frustum& frustum = camera->GetFrustum();
+
+	// Re-score the casters - the ones gone off screen, dead or turned impostor leave
+	for (unsigned i = 0; i < casters_.size();)
+	{
+		Entry& entry = entries_[casters_[i]];
+		entry.score_ = Score(entry, cameraPosition, frustum);
+		if (entry.score_ > 0.0f)
+		{
+			i++;
+			continue;
+		}
+		SetCaster(casters_[i], false);
+		casters_[i] = casters_.back();
+		casters_.pop_back();
+	}
+
+	// A smaller budget - the weakest casters leave
+	unsigned budget = (unsigned)maxCasters_;
+	while (casters_.size() > budget)
+	{
+		unsigned weakest = WeakestCaster();
+		SetCaster(casters_[weakest], false);
+		casters_[weakest] = casters_.back();
+		casters_.pop_back();
+	}
+
+	// Re-score the next slice of boids - each joins if there is room or it beats the weakest caster
+	unsigned sliceSize = Min((unsigned)sliceSize_, (unsigned)entries_.size());
+	for (unsigned i = 0; i < sliceSize; i++)
+	{
+		unsigned index = nextEntry_;
+		nextEntry_ = (nextEntry_ + 1) % entries_.size();
+
+		// Already a caster - scored above
+		Entry& entry = entries_[index];
+		if (entry.caster_ || budget == 0)
+			continue;
+
+		// Not worth a shadow
+		entry.score_ = Score(entry, cameraPosition, frustum);
+		if (entry.score_ <= 0.0f)
+			continue;
+
+		// Room in the budget
+		if (casters_.size() < budget)
+		{
+			SetCaster(index, true);
+			casters_.push_back(index);
+			continue;
+		}
+
+		// Take the place of the weakest caster
+		unsigned weakest = WeakestCaster();
+		if (entry.score_ > entries_[casters_[weakest]].score_)
+		{
+			SetCaster(casters_[weakest], false);
+			SetCaster(index, true);
+			casters_[weakest] = index;
+		}
+	}
+
+	numCasters_ = (int)casters_.size();
+}
+
+
+// Turn a boid's shadow on or off, joining or leaving the casters
+void ShadowBudget::SetCaster(unsigned entry, bool caster)
+{
+	Entry& managed = entries_[entry];
+	managed.boidSet_->boidList[managed.index_].pObject->SetCastShadows(caster);
+	managed.caster_ = caster;
+}
+
+
+// Position in the casters of the lowest scoring caster
+unsigned ShadowBudget::WeakestCaster()
+{
+	unsigned weakest = 0;
+	for (unsigned i = 1; i < casters_.size(); i++)
+	{
+		if (entries_[casters_[i]].score_ < entries_[casters_[weakest]].score_)
+			weakest = i;
+	}
+	return weakest;
+}
+
+
+// Score a boid - its projected size, or zero when off screen, dead or an impostor
+float ShadowBudget::Score(const Entry& entry, const Vector3& cameraPosition, const Frustum& frustum)
+{
+	// Dead or not drawn as a model (an impostor)
+	Boid& boid = entry.boidSet_->boidList[entry.index_];
+	if (!boid.pNode->IsEnabled() || !boid.pObject->IsEnabled())
+		return 0.0f;
+
+	// Off screen
+	Vector3 position = boid.pNode->GetWorldPosition();
+	if (frustum.IsInside(Sphere(position, BOID_SHADOW_RADIUS)) == OUTSIDE)
+		return 0.0f;
+
+	// Projected size
+	float distance = Max((position - cameraPosition).Length(), 0.01f);
+	return BOID_SHADOW_RADIUS / distance;
+}
+
+
+// Set the number of boids allowed to cast shadows
+void ShadowBudget::SetMaxCasters(int maxCasters)
+{
+	maxCasters_ = Max(0, maxCasters);
+}
+
+
+// Get the number of boids allowed to cast shadows
+int ShadowBudget::GetMaxCasters()
+{
+	return maxCasters_;
+}
+
+
+// Set the number of boids re-scored each frame
+void ShadowBudget::SetSliceSize(int sliceSize)
+{
+	sliceSize_ = Max(1, sliceSize);
+}
+
+
+// Number of boids casting shadows after the last update
+int ShadowBudget::GetNumCasters()
+{
+	return numCasters_;
+}
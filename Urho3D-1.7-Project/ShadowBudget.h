@@ -0,0 +1,84 @@
+#pragma once
+
+// Include directives
+#include "BoidSet.h"
+
+// Default number of boids allowed to cast shadows
+const int BOID_SHADOW_CASTERS = 24;
+
+// Default number of boids re-scored each frame (the casters are always re-scored)
+const int BOID_SHADOW_SLICE = 64;
+
+// Shadow budget class
+// - Only the boids that appear largest on screen (nearest for a given model size) cast shadows
+// - The casters and a slice of the other boids are re-scored each frame, and a sliced boid only
+//   takes the place of the weakest caster if it beats it on this frame's scores - so an update
+//   costs the same whatever the flock size, and no boid gets in on a stale score
+// - Shadow flags are only touched for the boids that join or leave the casters
+class ShadowBudget
+{
+public:
+	// Constructor
+	ShadowBudget() :
+		maxCasters_(BOID_SHADOW_CASTERS),
+		sliceSize_(BOID_SHADOW_SLICE),
+		nextEntry_(0),
+		numCasters_(0)
+	{}
+
+	// Add a set of boids to be managed
+	void AddBoidSet(BoidSet* boidSet);
+
+	// Forget the boid sets (the scene has been cleared)
+	void Clear();
+
+	// Update - called each frame after the physics step
+	void Update(Node* cameraNode);
+
+	// Set the number of boids allowed to cast shadows
+	void SetMaxCasters(int maxCasters);
+
+	// Get the number of boids allowed to cast shadows
+	int GetMaxCasters();
+
+	// Set the number of boids re-scored each frame
+	void SetSliceSize(int sliceSize);
+
+	// Number of boids casting shadows after the last update
+	int GetNumCasters();
+
+private:
+	// A managed boid
+	struct Entry
+	{
+		BoidSet* boidSet_;
+		int index_;
+		float score_;
+		bool caster_;
+	};
+
+	// Score a boid - its projected size, or zero when off screen, dead or an impostor
+	float Score(const Entry& entry, const Vector3& cameraPosition, const Frustum& frustum);
+
+	// Turn a boid's shadow on or off, joining or leaving the casters
+	void SetCaster(unsigned entry, bool caster);
+
+	// Position in the casters of the lowest scoring caster
+	unsigned WeakestCaster();
+
+	// Every managed boid
+	std::vector<Entry> entries_;
+
+	// The entries casting shadows - never more than the budget
+	std::vector<unsigned> casters_;
+
+	// Settings
+	int maxCasters_;
+	int sliceSize_;
+
+	// Next entry to re-score
+	unsigned nextEntry_;
+
+	// Number of casters after the last update
+	int numCasters_;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+// Movement controls - the buttons of the Controls a client sends to the server
+static const unsigned CTRL_FORWARD	= 1;
+static const unsigned CTRL_BACK		= 2;
+static const unsigned CTRL_LEFT		= 4;
+static const unsigned CTRL_RIGHT	= 8;
+static const unsigned CTRL_FIRE		= 16;
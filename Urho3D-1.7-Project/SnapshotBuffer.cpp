@@ -0,0 +1,261 @@
+// Include directives
+#include "SnapshotBuffer.h"
+
+
+// Forget every entity and the clock
+void SnapshotBuffer::Clear()
+{
+	// Entities
+	tracks_.Clear();
+
+	// Clock
+	clockOffset_ = 0.0f;
+	lastTransit_ = 0.0f;
+	jitter_ = 0.0f;
+	newestTime_ = 0.0f;
+	renderTime_ = 0.0f;
+
+	// Statistics
+	numArrivals_ = 0;
+	numInterpolated_ = 0;
+	numExtrapolated_ = 0;
+	numStale_ = 0;
+}
+
+
+// Set the time entities are drawn behind the newest state
+void SnapshotBuffer::SetDelay(float delay)
+{
+	delay_ = Max(delay, 0.0f);
+}
+
+
+// Set the longest extrapolation
+void SnapshotBuffer::SetMaxExtrapolation(float maxExtrapolation)
+{
+	maxExtrapolation_ = Max(maxExtrapolation, 0.0f);
+}
+
+
+// Record the send time of a snapshot against the local time it arrived at
+void SnapshotBuffer::AddArrival(float sendTime, float localTime)
+{
+	// Time the snapshot took to arrive, plus the difference between the clocks
+	float transit = localTime - sendTime;
+
+	// First snapshot sets the clock
+	if (!numArrivals_)
+	{
+		clockOffset_ = transit;
+		lastTransit_ = transit;
+	}
+
+	// Jitter is the smoothed change in transit time (as in RTP)
+	jitter_ += (Abs(transit - lastTransit_) - jitter_) / 16.0f;
+	lastTransit_ = transit;
+
+	// Follow the fastest snapshots at once and a slower link gradually
+	if (transit < clockOffset_)
+		clockOffset_ = transit;
+	else
+		clockOffset_ += (transit - clockOffset_) * SNAPSHOT_OFFSET_DRIFT;
+
+	// Newest snapshot
+	newestTime_ = Max(newestTime_, sendTime);
+	numArrivals_++;
+}
+
+
+// Add a state of an entity at the sender's time - replaces a state at the same time
+void SnapshotBuffer::AddState(unsigned id, float sendTime, const Vector3& position, const Quaternion& rotation, bool visible)
+{
+	// The new state
+	State state;
+	state.time_ = sendTime;
+	state.position_ = position;
+	state.rotation_ = rotation;
+	state.visible_ = visible;
+
+	// Find where it goes - states can arrive out of order
+	Track& track = tracks_[id];
+	unsigned slot = track.count_;
+	while (slot > 0 && track.states_[slot - 1].time_ > sendTime)
+		slot--;
+
+	// Same time as a held state - replace it
+	if (slot > 0 && track.states_[slot - 1].time_ == sendTime)
+	{
+		track.states_[slot - 1] = state;
+		return;
+	}
+
+	// Full - drop the oldest state, or the new one if it is older still
+	if (track.count_ == SNAPSHOT_STATES)
+	{
+		if (slot == 0)
+			return;
+		for (unsigned i = 1; i < track.count_; i++)
+			track.states_[i - 1] = track.states_[i];
+		track.count_--;
+		slot--;
+	}
+
+	// Insert it
+	for (unsigned i = track.count_; i > slot; i--)
+		track.states_[i] = track.states_[i - 1];
+	track.states_[slot] = state;
+	track.count_++;
+}
+
+
+// The newest state held for an entity, false if there is none
+bool SnapshotBuffer::GetNewest(unsigned id, Vector3& position, Quaternion& rotation)
+{
+	// No states for the entity
+	HashMap<unsigned, Track>::Iterator track = tracks_.Find(id);
+	if (track == tracks_.End() || !track->second_.count_)
+		return false;
+
+	// The last state
+	const State& state = track->second_.states_[track->second_.count_ - 1];
+	position = state.position_;
+	rotation = state.rotation_;
+	return true;
+}
+
+
+// Forget an entity
+void SnapshotBuffer::Remove(unsigned id)
+{
+	tracks_.Erase(id);
+}
+
+
+// IDs of the entities held
+void SnapshotBuffer::GetIDs(PODVector<unsigned>& ids)
+{
+	ids.Clear();
+	for (HashMap<unsigned, Track>::Iterator i = tracks_.Begin(); i != tracks_.End(); ++i)
+		ids.Push(i->first_);
+}
+
+
+// Work out the time to draw at - called once each frame before sampling
+void SnapshotBuffer::Update(float localTime)
+{
+	// The sender's time now, less the delay
+	renderTime_ = localTime - clockOffset_ - delay_;
+
+	// Reset the frame statistics
+	numInterpolated_ = 0;
+	numExtrapolated_ = 0;
+	numStale_ = 0;
+}
+
+
+// Get the state to draw an entity at, false if nothing has been received for it
+bool SnapshotBuffer::Sample(unsigned id, Vector3& position, Quaternion& rotation, bool& visible)
+{
+	// No states for the entity
+	HashMap<unsigned, Track>::Iterator found = tracks_.Find(id);
+	if (found == tracks_.End() || !found->second_.count_)
+		return false;
+	const Track& track = found->second_;
+
+	// Find the first state after the drawn time
+	unsigned next = 0;
+	while (next < track.count_ && track.states_[next].time_ <= renderTime_)
+		next++;
+
+	// Before the oldest state - hold it
+	if (next == 0)
+	{
+		const State& first = track.states_[0];
+		position = first.position_;
+		rotation = first.rotation_;
+		visible = first.visible_;
+		return true;
+	}
+
+	// Between two states - interpolate, unless the entity appears or disappears between them
+	const State& from = track.states_[next - 1];
+	if (next < track.count_)
+	{
+		const State& to = track.states_[next];
+		float t = (renderTime_ - from.time_) / Max(to.time_ - from.time_, M_EPSILON);
+		if (from.visible_ && to.visible_)
+		{
+			position = from.position_.Lerp(to.position_, t);
+			rotation = from.rotation_.Slerp(to.rotation_, t);
+		}
+		else
+		{
+			position = from.position_;
+			rotation = from.rotation_;
+		}
+		visible = from.visible_;
+		numInterpolated_++;
+		return true;
+	}
+
+	// Past the newest state
+	position = from.position_;
+	rotation = from.rotation_;
+	visible = from.visible_;
+
+	// Nothing for too long - hold the newest state
+	float ahead = renderTime_ - from.time_;
+	if (ahead > maxExtrapolation_)
+	{
+		numStale_++;
+		return true;
+	}
+
+	// Move on at the last velocity
+	numExtrapolated_++;
+
+	// Needs two visible states for a velocity
+	if (track.count_ > 1 && from.visible_)
+	{
+		const State& previous = track.states_[track.count_ - 2];
+		float interval = from.time_ - previous.time_;
+		if (previous.visible_ && interval > M_EPSILON)
+			position += (from.position_ - previous.position_) * (ahead / interval);
+	}
+	return true;
+}
+
+
+// Jitter of the snapshot arrival times (seconds)
+float SnapshotBuffer::GetJitter()
+{
+	return jitter_;
+}
+
+
+// Time held ahead of the drawn time (seconds) - below zero when extrapolating
+float SnapshotBuffer::GetBufferedTime()
+{
+	return newestTime_ - renderTime_;
+}
+
+
+// Entities interpolated on this frame
+unsigned SnapshotBuffer::GetNumInterpolated()
+{
+	return numInterpolated_;
+}
+
+
+// Entities extrapolated on this frame
+unsigned SnapshotBuffer::GetNumExtrapolated()
+{
+	return numExtrapolated_;
+}
+
+
+// Entities held past the extrapolation limit on this frame
+unsigned SnapshotBuffer::GetNumStale()
+{
+	return numStale_;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Quaternion.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Default time remote entities are drawn behind the newest state received (seconds)
+const float SNAPSHOT_DELAY = 0.1f;
+
+// Default longest time an entity is moved on past its newest state when states stop arriving
+const float SNAPSHOT_MAX_EXTRAPOLATION = 0.25f;
+
+// Number of states kept for each entity
+const unsigned SNAPSHOT_STATES = 8;
+
+// Rate at which the clock offset follows a slower link (per snapshot)
+const float SNAPSHOT_OFFSET_DRIFT = 0.02f;
+
+// Snapshot buffer class
+// - Holds the last few timestamped states of each remote entity, by ID
+// - Entities are drawn a fixed delay behind the sender's clock, interpolating between the two
+//   states around that time, so uneven arrival no longer shows as stutter
+// - Past the newest state an entity is moved on at its last velocity, for a bounded time, then
+//   held at the newest state (an entity that has stopped changing is no longer sent)
+// - The sender's clock is followed from the arrival times of its snapshots, which also gives
+//   the jitter of the link
+class SnapshotBuffer
+{
+public:
+	// Constructor
+	SnapshotBuffer() :
+		delay_(SNAPSHOT_DELAY),
+		maxExtrapolation_(SNAPSHOT_MAX_EXTRAPOLATION),
+		clockOffset_(0.0f),
+		lastTransit_(0.0f),
+		jitter_(0.0f),
+		newestTime_(0.0f),
+		renderTime_(0.0f),
+		numArrivals_(0),
+		numInterpolated_(0),
+		numExtrapolated_(0),
+		numStale_(0)
+	{}
+
+	// Forget every entity and the clock
+	void Clear();
+
+	// Set the time entities are drawn behind the newest state, and the longest extrapolation
+	void SetDelay(float delay);
+	void SetMaxExtrapolation(float maxExtrapolation);
+
+	// Record the send time of a snapshot against the local time it arrived at
+	void AddArrival(float sendTime, float localTime);
+
+	// Add a state of an entity at the sender's time - replaces a state at the same time
+	void AddState(unsigned id, float sendTime, const Vector3& position, const Quaternion& rotation, bool visible = true);
+
+	// The newest state held for an entity, false if there is none
+	bool GetNewest(unsigned id, Vector3& position, Quaternion& rotation);
+
+	// Forget an entity
+	void Remove(unsigned id);
+
+	// IDs of the entities held
+	void GetIDs(PODVector<unsigned>& ids);
+
+	// Work out the time to draw at - called once each frame before sampling
+	void Update(float localTime);
+
+	// Get the state to draw an entity at, false if nothing has been received for it
+	bool Sample(unsigned id, Vector3& position, Quaternion& rotation, bool& visible);
+
+	// Jitter of the snapshot arrival times (seconds)
+	float GetJitter();
+
+	// Time held ahead of the drawn time (seconds) - below zero when extrapolating
+	float GetBufferedTime();
+
+	// Entities interpolated, extrapolated and held past the extrapolation limit on this frame
+	unsigned GetNumInterpolated();
+	unsigned GetNumExtrapolated();
+	unsigned GetNumStale();
+
+private:
+	// A received state
+	struct State
+	{
+		float time_;
+		Vector3 position_;
+		Quaternion rotation_;
+		bool visible_;
+	};
+
+	// The states of an entity, oldest first
+	struct Track
+	{
+		State states_[SNAPSHOT_STATES];
+		unsigned count_ = 0;
+	};
+
+	// States of each entity
+	HashMap<unsigned, Track> tracks_;
+
+	// Settings
+	float delay_;
+	float maxExtrapolation_;
+
+	// Local time less the sender's time, over the fastest recent snapshots
+	float clockOffset_;
+
+	// Transit time of the last snapshot and the smoothed jitter
+	float lastTransit_;
+	float jitter_;
+
+	// Newest send time received and the time drawn at
+	float newestTime_;
+	float renderTime_;
+
+	// Statistics
+	unsigned numArrivals_;
+	unsigned numInterpolated_;
+	unsigned numExtrapolated_;
+	unsigned numStale_;
+};
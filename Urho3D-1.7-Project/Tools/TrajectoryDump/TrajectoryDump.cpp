@@ -0,0 +1,76 @@
+// Include directives
+#include <cstdio>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include "TrajectoryReader.h"
+
+// Print a summary of a trajectory file, or its ticks as CSV
+// - TrajectoryDump <file>                       summary
+// - TrajectoryDump <file> <tick> [<last tick>]  the ticks, one line per boid and per player
+int main(int argc, char** argv)
+{
+	// Arguments
+	const Vector<String>& arguments = ParseArguments(argc, argv);
+	if (arguments.Empty())
+		ErrorExit("Usage: TrajectoryDump <file> [<tick> [<last tick>]]");
+
+	// Open the file
+	SharedPtr<Context> context(new Context());
+	TrajectoryReader reader;
+	if (!reader.Open(context, arguments[0]))
+		ErrorExit("Could not read " + arguments[0]);
+
+	// Summary - the first and last ticks
+	TrajectoryTick tick;
+	char line[256];
+	if (arguments.Size() < 2)
+	{
+		snprintf(line, sizeof(line), "%u ticks in %u chunks", reader.GetNumTicks(), reader.GetNumChunks());
+		PrintLine(line);
+		if (reader.ReadTick(0, tick))
+		{
+			snprintf(line, sizeof(line), "First tick: frame %u at %.3f s, %u boids, %u players",
+				tick.frame_, tick.time_, (unsigned)tick.positions_.size(), (unsigned)tick.players_.size());
+			PrintLine(line);
+		}
+		if (reader.ReadTick(reader.GetNumTicks() - 1, tick))
+		{
+			snprintf(line, sizeof(line), "Last tick: frame %u at %.3f s, %u boids, %u players",
+				tick.frame_, tick.time_, (unsigned)tick.positions_.size(), (unsigned)tick.players_.size());
+			PrintLine(line);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// Ticks asked for
+	unsigned first = ToUInt(arguments[1]);
+	unsigned last = arguments.Size() > 2 ? ToUInt(arguments[2]) : first;
+	if (first >= reader.GetNumTicks())
+		ErrorExit("No tick " + arguments[1]);
+	last = Min(last, reader.GetNumTicks() - 1);
+
+	// One line per boid and per player
+	PrintLine("tick,frame,time,kind,index,alive,x,y,z,vx,vy,vz");
+	for (unsigned t = first; t <= last; t++)
+	{
+		if (!reader.ReadTick(t, tick))
+			ErrorExit("Could not read tick " + String(t));
+
+		for (unsigned i = 0; i < tick.positions_.size(); i++)
+		{
+			const Vector3& position = tick.positions_[i];
+			const Vector3& velocity = tick.velocities_[i];
+			snprintf(line, sizeof(line), "%u,%u,%.4f,boid,%u,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f", t, tick.frame_, tick.time_, i,
+				tick.alive_[i], position.x_, position.y_, position.z_, velocity.x_, velocity.y_, velocity.z_);
+			PrintLine(line);
+		}
+		for (unsigned i = 0; i < tick.players_.size(); i++)
+		{
+			const Vector3& position = tick.players_[i];
+			snprintf(line, sizeof(line), "%u,%u,%.4f,player,%u,1,%.3f,%.3f,%.3f,,,", t, tick.frame_, tick.time_, i,
+				position.x_, position.y_, position.z_);
+			PrintLine(line);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// Include directives
+#include <Urho3D/Math/MathDefs.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Trajectory file layout
+// - Header: file ID "FTRJ", version, ticks a chunk, position and velocity ranges
+// - Chunks: raw size, compressed size, then the LZ4 compressed ticks of the chunk
+// - Index: for each chunk its file offset, first tick and number of ticks
+// - Footer: number of chunks, offset of the index, file ID "FTRX" - so a reader finds the
+//   index from the end of the file and any tick with one seek and one chunk decompressed
+// A tick: frame number, time (seconds), number of boids and of players, then the boids as
+// arrays of quantised x, y, z positions and velocities (16 bit) and an alive byte each, then
+// the players' positions (floats). Within a chunk a tick's quantised arrays are stored as the
+// difference from the tick before (when it has as many boids), which the boids' small moves
+// turn into mostly zero bytes
+const unsigned TRAJECTORY_VERSION = 1;
+
+// Ticks a chunk
+const unsigned TRAJECTORY_CHUNK_TICKS = 32;
+
+// Quantisation ranges - positions and velocities beyond them are clamped
+const float TRAJECTORY_POSITION_RANGE = 256.0f;
+const float TRAJECTORY_VELOCITY_RANGE = 32.0f;
+
+// Size of a tick's fixed header (frame, time, boids, players)
+const unsigned TRAJECTORY_TICK_HEADER = 16;
+
+// Number of 16 bit arrays of a tick (x, y, z of position and velocity)
+const unsigned TRAJECTORY_ARRAYS = 6;
+
+// Bytes of the boid arrays of a tick
+inline unsigned TrajectoryBoidBytes(unsigned numBoids)
+{
+	return numBoids * (TRAJECTORY_ARRAYS * sizeof(short) + 1);
+}
+
+// Quantise a value to 16 bits over +/- range, and back
+inline short TrajectoryQuantise(float value, float range)
+{
+	return (short)Clamp(RoundToInt(value * (32767.0f / range)), -32767, 32767);
+}
+
+inline float TrajectoryDequantise(short value, float range)
+{
+	return value * (range / 32767.0f);
+}
@@ -0,0 +1,180 @@
+// Include directives
+#include <cstring>
+#include <Urho3D/IO/Compression.h>
+#include <Urho3D/IO/Log.h>
+#include "TrajectoryReader.h"
+
+
+// Open a trajectory file - reads its header and index
+bool TrajectoryReader::Open(Context* context, const String& fileName)
+{
+	// Open the file
+	file_ = new File(context, fileName, FILE_READ);
+	if (!file_->IsOpen() || file_->ReadFileID() != "FTRJ")
+	{
+		URHO3D_LOGERRORF("%s is not a trajectory file", fileName.CString());
+		file_.Reset();
+		return false;
+	}
+
+	// Header
+	unsigned version = file_->ReadUInt();
+	if (version != TRAJECTORY_VERSION)
+	{
+		URHO3D_LOGERRORF("%s is a trajectory of version %u, not %u", fileName.CString(), version, TRAJECTORY_VERSION);
+		file_.Reset();
+		return false;
+	}
+	chunkTicks_ = file_->ReadUInt();
+	positionRange_ = file_->ReadFloat();
+	velocityRange_ = file_->ReadFloat();
+
+	// Footer - missing if the recording was not stopped
+	file_->Seek(file_->GetSize() - 12);
+	unsigned numChunks = file_->ReadUInt();
+	unsigned indexOffset = file_->ReadUInt();
+	if (file_->ReadFileID() != "FTRX")
+	{
+		URHO3D_LOGERRORF("%s has no index - the recording did not finish", fileName.CString());
+		file_.Reset();
+		return false;
+	}
+
+	// Index
+	file_->Seek(indexOffset);
+	index_.resize(numChunks);
+	for (IndexEntry& entry : index_)
+	{
+		entry.offset_ = file_->ReadUInt();
+		entry.firstTick_ = file_->ReadUInt();
+		entry.numTicks_ = file_->ReadUInt();
+	}
+	numTicks_ = numChunks ? index_.back().firstTick_ + index_.back().numTicks_ : 0;
+	loaded_ = M_MAX_UNSIGNED;
+	return true;
+}
+
+
+// Number of ticks
+unsigned TrajectoryReader::GetNumTicks()
+{
+	return numTicks_;
+}
+
+
+// Number of chunks
+unsigned TrajectoryReader::GetNumChunks()
+{
+	return (unsigned)index_.size();
+}
+
+
+// Read a tick (0 is the first recorded)
+bool TrajectoryReader::ReadTick(unsigned tick, TrajectoryTick& out)
+{
+	if (!file_ || tick >= numTicks_)
+		return false;
+
+	// The chunk holding the tick - the last one starting at or before it
+	unsigned low = 0;
+	unsigned high = (unsigned)index_.size();
+	while (high - low > 1)
+	{
+		unsigned middle = (low + high) / 2;
+		if (index_[middle].firstTick_ <= tick)
+			low = middle;
+		else
+			high = middle;
+	}
+	if (!LoadChunk(low))
+		return false;
+
+	// Header
+	const unsigned char* start = &data_[tickStarts_[tick - index_[low].firstTick_]];
+	unsigned numBoids;
+	unsigned numPlayers;
+	memcpy(&out.frame_, start, 4);
+	memcpy(&out.time_, start + 4, 4);
+	memcpy(&numBoids, start + 8, 4);
+	memcpy(&numPlayers, start + 12, 4);
+
+	// Boids
+	const short* x = reinterpret_cast<const short*>(start + TRAJECTORY_TICK_HEADER);
+	const short* y = x + numBoids;
+	const short* z = y + numBoids;
+	const short* vx = z + numBoids;
+	const short* vy = vx + numBoids;
+	const short* vz = vy + numBoids;
+	const unsigned char* alive = reinterpret_cast<const unsigned char*>(x + TRAJECTORY_ARRAYS * numBoids);
+	out.positions_.resize(numBoids);
+	out.velocities_.resize(numBoids);
+	out.alive_.assign(alive, alive + numBoids);
+	for (unsigned i = 0; i < numBoids; i++)
+	{
+		out.positions_[i] = Vector3(TrajectoryDequantise(x[i], positionRange_), TrajectoryDequantise(y[i], positionRange_),
+			TrajectoryDequantise(z[i], positionRange_));
+		out.velocities_[i] = Vector3(TrajectoryDequantise(vx[i], velocityRange_), TrajectoryDequantise(vy[i], velocityRange_),
+			TrajectoryDequantise(vz[i], velocityRange_));
+	}
+
+	// Players
+	out.players_.resize(numPlayers);
+	if (numPlayers)
+		memcpy(&out.players_[0], alive + numBoids, numPlayers * sizeof(Vector3));
+	return true;
+}
+
+
+// Decompress a chunk and undo its delta encoding
+bool TrajectoryReader::LoadChunk(unsigned chunk)
+{
+	// Already loaded
+	if (chunk == loaded_)
+		return true;
+	loaded_ = M_MAX_UNSIGNED;
+
+	// Read and decompress it
+	const IndexEntry& entry = index_[chunk];
+	file_->Seek(entry.offset_);
+	unsigned size = file_->ReadUInt();
+	unsigned packed = file_->ReadUInt();
+	compressed_.resize(packed);
+	data_.resize(size);
+	if (file_->Read(&compressed_[0], packed) != packed || DecompressData(&data_[0], &compressed_[0], size) != size)
+	{
+		URHO3D_LOGERRORF("Trajectory chunk %u is damaged", chunk);
+		return false;
+	}
+
+	// Find the ticks
+	tickStarts_.resize(entry.numTicks_);
+	unsigned start = 0;
+	for (unsigned t = 0; t < entry.numTicks_; t++)
+	{
+		unsigned numBoids;
+		unsigned numPlayers;
+		memcpy(&numBoids, &data_[start + 8], 4);
+		memcpy(&numPlayers, &data_[start + 12], 4);
+		tickStarts_[t] = start;
+		start += (TRAJECTORY_TICK_HEADER + TrajectoryBoidBytes(numBoids) + numPlayers * sizeof(Vector3) + 3) & ~3u;
+	}
+
+	// Add each tick's differences to the tick before - first tick first
+	for (unsigned t = 1; t < entry.numTicks_; t++)
+	{
+		unsigned numBoids;
+		unsigned numBoidsBefore;
+		memcpy(&numBoids, &data_[tickStarts_[t] + 8], 4);
+		memcpy(&numBoidsBefore, &data_[tickStarts_[t - 1] + 8], 4);
+		if (numBoids != numBoidsBefore)
+			continue;
+
+		short* arrays = reinterpret_cast<short*>(&data_[tickStarts_[t] + TRAJECTORY_TICK_HEADER]);
+		const short* before = reinterpret_cast<const short*>(&data_[tickStarts_[t - 1] + TRAJECTORY_TICK_HEADER]);
+		for (unsigned i = 0; i < TRAJECTORY_ARRAYS * numBoids; i++)
+			arrays[i] = (short)(arrays[i] + before[i]);
+	}
+
+	loaded_ = chunk;
+	return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// Include directives
+#include <vector>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/Math/Vector3.h>
+#include "TrajectoryFormat.h"
+
+// A tick read back from a trajectory file
+struct TrajectoryTick
+{
+	unsigned frame_ = 0;
+	float time_ = 0.0f;
+	std::vector<Vector3> positions_;
+	std::vector<Vector3> velocities_;
+	std::vector<unsigned char> alive_;
+	std::vector<Vector3> players_;
+};
+
+// Trajectory reader class
+// - Reads any tick of a file written by TrajectoryRecorder: finds its chunk in the index at
+//   the end of the file, decompresses that chunk only and undoes its delta encoding
+// - The last chunk read is kept, so reading the ticks in order decompresses each chunk once
+class TrajectoryReader
+{
+public:
+	// Constructor
+	TrajectoryReader() :
+		numTicks_(0),
+		chunkTicks_(0),
+		positionRange_(TRAJECTORY_POSITION_RANGE),
+		velocityRange_(TRAJECTORY_VELOCITY_RANGE),
+		loaded_(M_MAX_UNSIGNED)
+	{}
+
+	// Open a trajectory file - reads its header and index
+	bool Open(Context* context, const String& fileName);
+
+	// Number of ticks and chunks
+	unsigned GetNumTicks();
+	unsigned GetNumChunks();
+
+	// Read a tick (0 is the first recorded)
+	bool ReadTick(unsigned tick, TrajectoryTick& out);
+
+private:
+	// Where a chunk was written
+	struct IndexEntry
+	{
+		unsigned offset_;
+		unsigned firstTick_;
+		unsigned numTicks_;
+	};
+
+	// Decompress a chunk and undo its delta encoding
+	bool LoadChunk(unsigned chunk);
+
+	// Input file
+	SharedPtr<File> file_;
+
+	// Header and index
+	unsigned numTicks_;
+	unsigned chunkTicks_;
+	float positionRange_;
+	float velocityRange_;
+	std::vector<IndexEntry> index_;
+
+	// The chunk loaded and the start of each of its ticks
+	unsigned loaded_;
+	std::vector<unsigned char> data_;
+	std::vector<unsigned char> compressed_;
+	std::vector<unsigned> tickStarts_;
+};
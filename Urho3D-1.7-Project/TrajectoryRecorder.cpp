@@ -0,0 +1,326 @@
+// Include directives
+#include <cstdio>
+#include <cstring>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/Compression.h>
+#include <Urho3D/IO/Log.h>
+#include "TrajectoryRecorder.h"
+
+
+// Destructor
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+	Stop();
+	for (Chunk* chunk : chunks_)
+		delete chunk;
+}
+
+
+// Start recording to the file
+bool TrajectoryRecorder::Start(Context* context, const String& fileName)
+{
+	// Already recording
+	if (recording_)
+		return true;
+
+	// Open the file
+	file_ = new File(context, fileName, FILE_WRITE);
+	if (!file_->IsOpen())
+	{
+		URHO3D_LOGERRORF("Could not record the trajectories to %s", fileName.CString());
+		file_.Reset();
+		return false;
+	}
+
+	// Header
+	file_->WriteFileID("FTRJ");
+	file_->WriteUInt(TRAJECTORY_VERSION);
+	file_->WriteUInt(TRAJECTORY_CHUNK_TICKS);
+	file_->WriteFloat(TRAJECTORY_POSITION_RANGE);
+	file_->WriteFloat(TRAJECTORY_VELOCITY_RANGE);
+
+	// A chunk to fill, and the rest (at least one) free for when it is full
+	while (chunks_.size() < 2)
+		chunks_.push_back(new Chunk());
+	current_ = chunks_[0];
+	free_.assign(chunks_.begin() + 1, chunks_.end());
+
+	// Start the writer
+	index_.clear();
+	numTicks_ = 0;
+	numDropped_ = 0;
+	recording_ = true;
+	Run();
+	URHO3D_LOGINFOF("Recording the trajectories to %s", fileName.CString());
+	return true;
+}
+
+
+// Is a trajectory being recorded
+bool TrajectoryRecorder::IsRecording()
+{
+	return recording_;
+}
+
+
+// Start a tick of the number of boids
+void TrajectoryRecorder::BeginTick(unsigned frame, float time, unsigned numBoids)
+{
+	if (!recording_)
+		return;
+
+	// No chunk to put the tick in - take one the writer has freed, or drop the tick
+	if (!current_)
+	{
+		MutexLock lock(mutex_);
+		if (!free_.empty())
+		{
+			current_ = free_.back();
+			free_.pop_back();
+		}
+	}
+	dropping_ = current_ == nullptr;
+	if (dropping_)
+	{
+		numDropped_++;
+		return;
+	}
+
+	// Room for the header and the boids - zeroed, for boids not added
+	std::vector<unsigned char>& data = current_->data_;
+	if (!current_->numTicks_)
+		current_->firstTick_ = numTicks_;
+	tickStart_ = (unsigned)data.size();
+	tickBoids_ = 0;
+	data.resize(tickStart_ + TRAJECTORY_TICK_HEADER + TrajectoryBoidBytes(numBoids));
+
+	// Header - no players yet
+	unsigned numPlayers = 0;
+	memcpy(&data[tickStart_], &frame, 4);
+	memcpy(&data[tickStart_ + 4], &time, 4);
+	memcpy(&data[tickStart_ + 8], &numBoids, 4);
+	memcpy(&data[tickStart_ + 12], &numPlayers, 4);
+}
+
+
+// Add a boid set's state to the tick
+void TrajectoryRecorder::AddBoids(const BoidSet& set)
+{
+	if (!recording_ || dropping_)
+		return;
+
+	// Boids of the tick and those of the set that fit
+	std::vector<unsigned char>& data = current_->data_;
+	unsigned numBoids;
+	memcpy(&numBoids, &data[tickStart_ + 8], 4);
+	unsigned count = Min((unsigned)set.positions_.size(), numBoids - tickBoids_);
+
+	// Quantise into the arrays - the tick is 4 byte aligned
+	short* arrays = reinterpret_cast<short*>(&data[tickStart_ + TRAJECTORY_TICK_HEADER]);
+	short* x = arrays + tickBoids_;
+	short* y = x + numBoids;
+	short* z = y + numBoids;
+	short* vx = z + numBoids;
+	short* vy = vx + numBoids;
+	short* vz = vy + numBoids;
+	unsigned char* alive = reinterpret_cast<unsigned char*>(arrays + TRAJECTORY_ARRAYS * numBoids) + tickBoids_;
+	for (unsigned i = 0; i < count; i++)
+	{
+		const Vector3& position = set.positions_[i];
+		const Vector3& velocity = set.velocities_[i];
+		x[i] = TrajectoryQuantise(position.x_, TRAJECTORY_POSITION_RANGE);
+		y[i] = TrajectoryQuantise(position.y_, TRAJECTORY_POSITION_RANGE);
+		z[i] = TrajectoryQuantise(position.z_, TRAJECTORY_POSITION_RANGE);
+		vx[i] = TrajectoryQuantise(velocity.x_, TRAJECTORY_VELOCITY_RANGE);
+		vy[i] = TrajectoryQuantise(velocity.y_, TRAJECTORY_VELOCITY_RANGE);
+		vz[i] = TrajectoryQuantise(velocity.z_, TRAJECTORY_VELOCITY_RANGE);
+		alive[i] = set.alive_[i];
+	}
+	tickBoids_ += count;
+}
+
+
+// Add a player's position to the tick
+void TrajectoryRecorder::AddPlayer(const Vector3& position)
+{
+	if (!recording_ || dropping_)
+		return;
+
+	// Append the position and count it
+	std::vector<unsigned char>& data = current_->data_;
+	unsigned end = (unsigned)data.size();
+	data.resize(end + sizeof(Vector3));
+	memcpy(&data[end], position.Data(), sizeof(Vector3));
+	unsigned numPlayers;
+	memcpy(&numPlayers, &data[tickStart_ + 12], 4);
+	numPlayers++;
+	memcpy(&data[tickStart_ + 12], &numPlayers, 4);
+}
+
+
+// End the tick
+void TrajectoryRecorder::EndTick()
+{
+	if (!recording_ || dropping_)
+		return;
+
+	// Keep the next tick 4 byte aligned
+	std::vector<unsigned char>& data = current_->data_;
+	data.resize((data.size() + 3) & ~3u);
+
+	// Count it, and hand a full chunk to the writer
+	numTicks_++;
+	if (++current_->numTicks_ == TRAJECTORY_CHUNK_TICKS)
+		QueueChunk();
+}
+
+
+// Write the last ticks and the index, and close the file
+void TrajectoryRecorder::Stop()
+{
+	if (!recording_)
+		return;
+
+	// Hand over the last ticks and let the writer finish
+	if (current_ && current_->numTicks_)
+		QueueChunk();
+	Thread::Stop();
+
+	// Index and footer
+	unsigned indexOffset = file_->GetPosition();
+	for (const IndexEntry& entry : index_)
+	{
+		file_->WriteUInt(entry.offset_);
+		file_->WriteUInt(entry.firstTick_);
+		file_->WriteUInt(entry.numTicks_);
+	}
+	file_->WriteUInt((unsigned)index_.size());
+	file_->WriteUInt(indexOffset);
+	file_->WriteFileID("FTRX");
+
+	// Report it
+	char text[200];
+	snprintf(text, sizeof(text), "Recorded %u ticks (%u dropped) in %u chunks, %.1f MB, to %s",
+		numTicks_, numDropped_, (unsigned)index_.size(), file_->GetSize() / 1048576.0f, file_->GetName().CString());
+	URHO3D_LOGINFO(text);
+
+	// Close it, and keep the chunks for another recording
+	file_->Close();
+	file_.Reset();
+	free_.clear();
+	full_.clear();
+	for (Chunk* chunk : chunks_)
+	{
+		chunk->data_.clear();
+		chunk->numTicks_ = 0;
+	}
+	current_ = nullptr;
+	recording_ = false;
+}
+
+
+// Write the full chunks - runs on the recorder's thread
+void TrajectoryRecorder::ThreadFunction()
+{
+	for (;;)
+	{
+		// Next full chunk
+		Chunk* chunk = nullptr;
+		{
+			MutexLock lock(mutex_);
+			if (!full_.empty())
+			{
+				chunk = full_.front();
+				full_.pop_front();
+			}
+		}
+
+		// Write it and hand it back
+		if (chunk)
+		{
+			WriteChunk(*chunk);
+			chunk->data_.clear();
+			chunk->numTicks_ = 0;
+			MutexLock lock(mutex_);
+			free_.push_back(chunk);
+			continue;
+		}
+
+		// Nothing left and told to stop
+		if (!shouldRun_)
+			break;
+		Time::Sleep(1);
+	}
+}
+
+
+// Hand the chunk being filled to the writer and take a free one
+void TrajectoryRecorder::QueueChunk()
+{
+	MutexLock lock(mutex_);
+	full_.push_back(current_);
+	current_ = nullptr;
+
+	// A free chunk, or a new one while under the limit - otherwise ticks are dropped until one is freed
+	if (!free_.empty())
+	{
+		current_ = free_.back();
+		free_.pop_back();
+	}
+	else if (chunks_.size() < TRAJECTORY_MAX_CHUNKS)
+	{
+		current_ = new Chunk();
+		chunks_.push_back(current_);
+	}
+}
+
+
+// Delta encode, compress and write a chunk - on the recorder's thread
+void TrajectoryRecorder::WriteChunk(Chunk& chunk)
+{
+	std::vector<unsigned char>& data = chunk.data_;
+
+	// Find the ticks
+	tickStarts_.resize(chunk.numTicks_);
+	unsigned start = 0;
+	for (unsigned t = 0; t < chunk.numTicks_; t++)
+	{
+		unsigned numBoids;
+		unsigned numPlayers;
+		memcpy(&numBoids, &data[start + 8], 4);
+		memcpy(&numPlayers, &data[start + 12], 4);
+		tickStarts_[t] = start;
+		start += (TRAJECTORY_TICK_HEADER + TrajectoryBoidBytes(numBoids) + numPlayers * sizeof(Vector3) + 3) & ~3u;
+	}
+
+	// Each tick's arrays as the difference from the tick before - last tick first
+	for (unsigned t = chunk.numTicks_ - 1; t > 0; t--)
+	{
+		unsigned numBoids;
+		unsigned numBoidsBefore;
+		memcpy(&numBoids, &data[tickStarts_[t] + 8], 4);
+		memcpy(&numBoidsBefore, &data[tickStarts_[t - 1] + 8], 4);
+		if (numBoids != numBoidsBefore)
+			continue;
+
+		short* arrays = reinterpret_cast<short*>(&data[tickStarts_[t] + TRAJECTORY_TICK_HEADER]);
+		const short* before = reinterpret_cast<const short*>(&data[tickStarts_[t - 1] + TRAJECTORY_TICK_HEADER]);
+		for (unsigned i = 0; i < TRAJECTORY_ARRAYS * numBoids; i++)
+			arrays[i] = (short)(arrays[i] - before[i]);
+	}
+
+	// Compress
+	unsigned size = (unsigned)data.size();
+	compressed_.resize(EstimateCompressBound(size));
+	unsigned packed = CompressData(&compressed_[0], &data[0], size);
+
+	// Write it and index it
+	IndexEntry entry;
+	entry.offset_ = file_->GetPosition();
+	entry.firstTick_ = chunk.firstTick_;
+	entry.numTicks_ = chunk.numTicks_;
+	index_.push_back(entry);
+	file_->WriteUInt(size);
+	file_->WriteUInt(packed);
+	file_->Write(&compressed_[0], packed);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+// Include directives
+#include <deque>
+#include <vector>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Core/Thread.h>
+#include <Urho3D/IO/File.h>
+#include "BoidSet.h"
+#include "TrajectoryFormat.h"
+
+// Most chunks waiting for the writer - ticks are dropped while they are all taken
+const unsigned TRAJECTORY_MAX_CHUNKS = 8;
+
+// Trajectory recorder class
+// - Appends the flock state of each tick, quantised to 16 bits, to a chunked binary file for
+//   offline analysis (see TrajectoryFormat.h, and Tools/TrajectoryDump for a reader)
+// - The frame only quantises the positions and velocities into a chunk buffer; full chunks
+//   are handed to the recorder's own thread, which delta encodes, compresses and writes them
+// - Chunk buffers are reused, so recording allocates nothing once it is running
+class TrajectoryRecorder : public Thread
+{
+public:
+	// Constructor
+	TrajectoryRecorder() :
+		recording_(false),
+		current_(nullptr),
+		tickStart_(0),
+		tickBoids_(0),
+		dropping_(false),
+		numTicks_(0),
+		numDropped_(0)
+	{}
+
+	// Destructor
+	~TrajectoryRecorder();
+
+	// Start recording to the file
+	bool Start(Context* context, const String& fileName);
+
+	// Is a trajectory being recorded
+	bool IsRecording();
+
+	// Start a tick of the number of boids - then add the boid sets and players, and end it
+	void BeginTick(unsigned frame, float time, unsigned numBoids);
+	void AddBoids(const BoidSet& set);
+	void AddPlayer(const Vector3& position);
+	void EndTick();
+
+	// Write the last ticks and the index, and close the file
+	void Stop();
+
+	// Write the full chunks - runs on the recorder's thread
+	virtual void ThreadFunction() override;
+
+private:
+	// Ticks waiting to be written
+	struct Chunk
+	{
+		std::vector<unsigned char> data_;
+		unsigned firstTick_ = 0;
+		unsigned numTicks_ = 0;
+	};
+
+	// Where a chunk was written
+	struct IndexEntry
+	{
+		unsigned offset_;
+		unsigned firstTick_;
+		unsigned numTicks_;
+	};
+
+	// Hand the chunk being filled to the writer and take a free one
+	void QueueChunk();
+
+	// Delta encode, compress and write a chunk - on the recorder's thread
+	void WriteChunk(Chunk& chunk);
+
+	// Output file
+	SharedPtr<File> file_;
+	bool recording_;
+
+	// Chunk being filled, the start of its current tick, and the boids added to the tick
+	Chunk* current_;
+	unsigned tickStart_;
+	unsigned tickBoids_;
+
+	// The tick is being dropped - no free chunk to put it in
+	bool dropping_;
+
+	// Every chunk buffer, and those free and full
+	std::vector<Chunk*> chunks_;
+	std::vector<Chunk*> free_;
+	std::deque<Chunk*> full_;
+	Mutex mutex_;
+
+	// Ticks recorded and dropped
+	unsigned numTicks_;
+	unsigned numDropped_;
+
+	// Writer's state - the index, the start of each tick of a chunk, and the compression buffer
+	std::vector<IndexEntry> index_;
+	std::vector<unsigned> tickStarts_;
+	std::vector<unsigned char> compressed_;
+};
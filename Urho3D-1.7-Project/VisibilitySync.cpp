@@ -0,0 +1,73 @@
+// Include directives
+#include "VisibilitySync.h"
+
+// Radius of a boid used for the on screen test
+static const float BOID_VISIBILITY_RADIUS = 1.0f;
+
+
+// Add a set of boids to be managed
+void VisibilitySync::AddBoidSet(BoidSet* boidSet)
+{
+	sets_.push_back(boidSet);
+}
+
+
+// Forget the boid sets (the scene has been cleared)
+void VisibilitySync::Clear()
+{
+	sets_.clear();
+	numOnScreen_ = 0;
+}
+
+
+// Update - called each frame after the flock state has been refreshed
+void VisibilitySync::Update(Node* cameraNode)
+{
+	// Nothing to test against
+	Camera* camera = cameraNode ? cameraNode->GetComponent<Camera>() : nullptr;
+	if (!camera)
+		return;
+	const Frustum& frustum = camera->GetFrustum();
+
+	// Next frame of the staggered tests
+	frame_++;
+	numOnScreen_ = 0;
+
+	// Loop through the boid sets
+	for (auto boidSet : sets_)
+	{
+		// Loop through the boids
+		for (int i = 0; i < boidSet->numberOfBoids_; i++)
+		{
+			Boid& boid = boidSet->boidList[i];
+
+			// Off screen boids are only tested every few frames
+			bool onScreen = boid.IsOnScreen();
+			if (!onScreen && (i + frame_) % interval_ != 0)
+				continue;
+
+			// Test the boid against the camera from the flock state
+			Sphere bounds(boidSet->positions_[i], BOID_VISIBILITY_RADIUS + margin_);
+			onScreen = boidSet->alive_[i] && frustum.IsInside(bounds) != OUTSIDE;
+			boid.SetOnScreen(onScreen);
+
+			// Count the boids on screen
+			if (onScreen)
+				numOnScreen_++;
+		}
+	}
+}
+
+
+// Set the number of frames between tests of an off screen boid
+void VisibilitySync::SetInterval(int interval)
+{
+	interval_ = Max(1, interval);
+}
+
+
+// Number of boids on screen after the last update
+int VisibilitySync::GetNumOnScreen()
+{
+	return numOnScreen_;
+}
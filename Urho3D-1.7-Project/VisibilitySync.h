@@ -0,0 +1,57 @@
+#pragma once
+
+// Include directives
+#include "BoidSet.h"
+
+// Default number of frames between on screen tests of an off screen boid
+const int BOID_VISIBILITY_INTERVAL = 4;
+
+// Default margin added to a boid's radius for the on screen test
+const float BOID_VISIBILITY_MARGIN = 3.0f;
+
+// Visibility sync class
+// - Boids on screen are tested every frame, boids off screen every few frames (staggered)
+// - Off screen boids have their model taken out of the octree and are not turned, so the
+//   physics moving their nodes costs no octree reinsertion
+// - Their simulation state carries on in the rigid bodies and the flock state arrays
+// - The margin lets a boid come back into the octree before it reaches the screen edge
+class VisibilitySync
+{
+public:
+	// Constructor
+	VisibilitySync() :
+		interval_(BOID_VISIBILITY_INTERVAL),
+		margin_(BOID_VISIBILITY_MARGIN),
+		frame_(0),
+		numOnScreen_(0)
+	{}
+
+	// Add a set of boids to be managed
+	void AddBoidSet(BoidSet* boidSet);
+
+	// Forget the boid sets (the scene has been cleared)
+	void Clear();
+
+	// Update - called each frame after the flock state has been refreshed
+	void Update(Node* cameraNode);
+
+	// Set the number of frames between tests of an off screen boid
+	void SetInterval(int interval);
+
+	// Number of boids on screen after the last update
+	int GetNumOnScreen();
+
+private:
+	// The managed boid sets
+	std::vector<BoidSet*> sets_;
+
+	// Settings
+	int interval_;
+	float margin_;
+
+	// Frame counter for the staggered tests
+	unsigned frame_;
+
+	// Number of boids on screen
+	int numOnScreen_;
+};
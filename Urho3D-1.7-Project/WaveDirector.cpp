@@ -0,0 +1,357 @@
+// Include directives
+#include <Urho3D/Core/Profiler.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/XMLFile.h>
+#include "WaveDirector.h"
+
+
+// Read the waves from the XML file - false if it could not be read
+bool WaveDirector::Load(ResourceCache* cache, const String& fileName)
+{
+	// The file and its root
+	XMLFile* file = cache->GetResource<XMLFile>(fileName);
+	XMLElement root = file ? file->GetRoot("waves") : XMLElement();
+	if (!root)
+	{
+		URHO3D_LOGERRORF("Could not read the waves from %s", fileName.CString());
+		return false;
+	}
+
+	// Pool and spawn settings - the defaults when left out
+	if (root.HasAttribute("loop"))
+		loop_ = root.GetBool("loop");
+	if (root.HasAttribute("poolFlocks"))
+		poolFlocks_ = Max(root.GetInt("poolFlocks"), 0);
+	if (root.HasAttribute("flockSize"))
+		flockSize_ = Max(root.GetInt("flockSize"), 1);
+	if (root.HasAttribute("spawnRadius"))
+		spawnRadius_ = root.GetFloat("spawnRadius");
+	if (root.HasAttribute("spawnSpread"))
+		spawnSpread_ = root.GetFloat("spawnSpread");
+	if (root.HasAttribute("maxSpawnsPerFrame"))
+		maxSpawnsPerFrame_ = Max(root.GetInt("maxSpawnsPerFrame"), 1);
+	if (root.HasAttribute("maxRetiresPerFrame"))
+		maxRetiresPerFrame_ = Max(root.GetInt("maxRetiresPerFrame"), 1);
+
+	// The waves in order
+	waves_.clear();
+	for (XMLElement element = root.GetChild("wave"); element; element = element.GetNext("wave"))
+	{
+		Wave wave;
+		wave.duration_ = Max(element.GetFloat("duration"), 1.0f);
+		wave.flocks_ = Max(element.GetInt("flocks"), 0);
+		wave.boids_ = Max(element.GetInt("boids"), 0);
+		wave.spawnRate_ = Max(element.GetFloat("spawnRate"), 0.0f);
+		wave.retireRate_ = Max(element.GetFloat("retireRate"), 0.0f);
+		waves_.push_back(wave);
+	}
+
+	// Nothing to direct
+	if (waves_.empty())
+	{
+		URHO3D_LOGERRORF("No waves in %s", fileName.CString());
+		return false;
+	}
+
+	URHO3D_LOGINFOF("Read %u waves from %s: %d pooled flocks of %d boids", (unsigned)waves_.size(), fileName.CString(), poolFlocks_, flockSize_);
+	return true;
+}
+
+
+// Flocks to build for the pool
+int WaveDirector::GetPoolFlocks()
+{
+	return poolFlocks_;
+}
+
+
+// Boids in each pooled flock
+int WaveDirector::GetFlockSize()
+{
+	return flockSize_;
+}
+
+
+// Start directing - the sets are added after
+void WaveDirector::Start(const FlockRandom& random)
+{
+	// Nothing read
+	if (waves_.empty())
+		return;
+
+	// Start from the first wave with nothing owed
+	random_ = random;
+	flocks_.clear();
+	spawnCredit_ = 0.0f;
+	retireCredit_ = 0.0f;
+	enabled_ = true;
+	StartWave(0);
+}
+
+
+// Add a set - in play, or pooled with its boids retired
+void WaveDirector::AddBoidSet(BoidSet* boidSet, bool pooled)
+{
+	// Not running
+	if (!enabled_)
+		return;
+
+	Flock flock;
+	flock.boidSet_ = boidSet;
+	flock.alive_ = 0;
+	flock.spawned_ = true;
+
+	// In play - its boids come back in where they started
+	if (!pooled)
+	{
+		flock.state_ = WAVE_FLOCK_ACTIVE;
+		flock.spawnPoint_ = Vector3::ZERO;
+		boidSet->active_ = true;
+	}
+
+	// Pooled - every boid retired and the set not updated
+	else
+	{
+		flock.state_ = WAVE_FLOCK_POOLED;
+		for (auto& boid : boidSet->boidList)
+			boid.Retire();
+		boidSet->active_ = false;
+	}
+	flocks_.push_back(flock);
+}
+
+
+// Stop directing and forget the sets - before they are deleted
+void WaveDirector::Stop()
+{
+	enabled_ = false;
+	flocks_.clear();
+	spawnCredit_ = 0.0f;
+	retireCredit_ = 0.0f;
+}
+
+
+// Is the director running
+bool WaveDirector::IsEnabled()
+{
+	return enabled_;
+}
+
+
+// Current wave
+unsigned WaveDirector::GetWave()
+{
+	return wave_;
+}
+
+
+// Update - called each frame before the boids are updated
+void WaveDirector::Update(float timeStep)
+{
+	// Not running
+	if (!enabled_)
+		return;
+
+	URHO3D_PROFILE(WaveDirector);
+
+	// Next wave - the last one holds unless the waves loop
+	waveTime_ += timeStep;
+	if (waveTime_ >= waves_[wave_].duration_)
+	{
+		if (wave_ + 1 < waves_.size())
+			StartWave(wave_ + 1);
+		else if (loop_)
+			StartWave(0);
+		else
+			waveTime_ = waves_[wave_].duration_;
+	}
+	const Wave& wave = waves_[wave_];
+
+	// Count the boids alive and the flocks in play
+	int inPlay = 0;
+	int alive = 0;
+	for (auto& flock : flocks_)
+	{
+		// Pooled
+		flock.alive_ = 0;
+		if (flock.state_ == WAVE_FLOCK_POOLED)
+			continue;
+
+		// Boids alive
+		for (auto& boid : flock.boidSet_->boidList)
+		{
+			if (boid.IsAlive())
+				flock.alive_++;
+		}
+
+		// Wiped out or fully retired - back to the pool
+		if (flock.alive_ == 0 && (flock.spawned_ || flock.state_ == WAVE_FLOCK_RETIRING))
+		{
+			flock.state_ = WAVE_FLOCK_POOLED;
+			flock.boidSet_->active_ = false;
+			continue;
+		}
+
+		// In play
+		if (flock.state_ == WAVE_FLOCK_ACTIVE)
+		{
+			inPlay++;
+			alive += flock.alive_;
+		}
+	}
+
+	// Bring pooled flocks into play up to the wave's flocks
+	for (auto& flock : flocks_)
+	{
+		if (inPlay >= wave.flocks_)
+			break;
+		if (flock.state_ == WAVE_FLOCK_POOLED)
+		{
+			ActivateFlock(flock);
+			inPlay++;
+		}
+	}
+
+	// Start retiring the weakest flocks over the wave's flocks
+	while (inPlay > wave.flocks_)
+	{
+		Flock* weakest = nullptr;
+		for (auto& flock : flocks_)
+		{
+			if (flock.state_ == WAVE_FLOCK_ACTIVE && (!weakest || flock.alive_ < weakest->alive_))
+				weakest = &flock;
+		}
+		RetireFlock(*weakest);
+		alive -= weakest->alive_;
+		inPlay--;
+	}
+
+	// Spawns owed - capped so a burst of kills is made up over several frames
+	spawnCredit_ = Min(spawnCredit_ + wave.spawnRate_ * timeStep, (float)maxSpawnsPerFrame_);
+	while (spawnCredit_ >= 1.0f && alive < wave.boids_)
+	{
+		// The flock in play with the fewest alive, so new flocks fill first
+		Flock* target = nullptr;
+		for (auto& flock : flocks_)
+		{
+			if (flock.state_ == WAVE_FLOCK_ACTIVE && flock.alive_ < flock.boidSet_->numberOfBoids_ && (!target || flock.alive_ < target->alive_))
+				target = &flock;
+		}
+
+		// Every flock in play is full
+		if (!target || !SpawnBoid(*target))
+			break;
+		spawnCredit_ -= 1.0f;
+		alive++;
+	}
+
+	// Retirements owed - likewise capped
+	retireCredit_ = Min(retireCredit_ + wave.retireRate_ * timeStep, (float)maxRetiresPerFrame_);
+	while (retireCredit_ >= 1.0f)
+	{
+		// The retiring flocks first
+		Flock* target = nullptr;
+		for (auto& flock : flocks_)
+		{
+			if (flock.state_ == WAVE_FLOCK_RETIRING && flock.alive_ > 0)
+			{
+				target = &flock;
+				break;
+			}
+		}
+
+		// Then the boids over the wave's boids, from the flock in play with the most alive
+		if (!target && alive > wave.boids_)
+		{
+			for (auto& flock : flocks_)
+			{
+				if (flock.state_ == WAVE_FLOCK_ACTIVE && (!target || flock.alive_ > target->alive_))
+					target = &flock;
+			}
+			if (target)
+				alive--;
+		}
+
+		// Nothing to retire
+		if (!target || !RetireBoid(*target))
+			break;
+		retireCredit_ -= 1.0f;
+	}
+}
+
+
+// Move on to a wave, logging it
+void WaveDirector::StartWave(unsigned wave)
+{
+	wave_ = wave;
+	waveTime_ = 0.0f;
+	URHO3D_LOGINFOF("Wave %u: %d flocks, %d boids for %d seconds", wave_ + 1, waves_[wave_].flocks_, waves_[wave_].boids_, (int)waves_[wave_].duration_);
+}
+
+
+// Bring a pooled flock into play - its boids come in around a new spawn point
+void WaveDirector::ActivateFlock(Flock& flock)
+{
+	// A point on the sphere around the battle
+	Vector3 direction(random_.Next(2.0f) - 1.0f, random_.Next(2.0f) - 1.0f, random_.Next(2.0f) - 1.0f);
+	if (direction == Vector3::ZERO)
+		direction = Vector3::FORWARD;
+	flock.spawnPoint_ = direction.Normalized() * spawnRadius_;
+
+	// In play and updated again - spawned a boid at a time
+	flock.state_ = WAVE_FLOCK_ACTIVE;
+	flock.spawned_ = false;
+	flock.boidSet_->active_ = true;
+}
+
+
+// Start retiring a flock in play - it flies on while its boids are retired
+void WaveDirector::RetireFlock(Flock& flock)
+{
+	flock.state_ = WAVE_FLOCK_RETIRING;
+}
+
+
+// Spawn a boid into the flock - false if it has none left to spawn
+bool WaveDirector::SpawnBoid(Flock& flock)
+{
+	// The first boid not in play
+	for (auto& boid : flock.boidSet_->boidList)
+	{
+		if (boid.IsAlive())
+			continue;
+
+		// Around the spawn point, heading into the battle
+		Vector3 offset(random_.Next(2.0f) - 1.0f, random_.Next(2.0f) - 1.0f, random_.Next(2.0f) - 1.0f);
+		Vector3 heading = flock.spawnPoint_ == Vector3::ZERO ? Vector3::FORWARD : -flock.spawnPoint_.Normalized();
+		boid.Spawn(flock.spawnPoint_ + offset * spawnSpread_, heading * WAVE_SPAWN_SPEED);
+		flock.alive_++;
+		flock.spawned_ = true;
+		return true;
+	}
+	return false;
+}
+
+
+// Retire a boid of the flock, off screen first - false if it has none alive
+bool WaveDirector::RetireBoid(Flock& flock)
+{
+	// Off screen first, so boids don't vanish in view
+	Boid* retired = nullptr;
+	for (auto& boid : flock.boidSet_->boidList)
+	{
+		if (boid.IsAlive())
+		{
+			retired = &boid;
+			if (!boid.IsOnScreen())
+				break;
+		}
+	}
+
+	// None alive
+	if (!retired)
+		return false;
+	retired->Retire();
+	flock.alive_--;
+	return true;
+}
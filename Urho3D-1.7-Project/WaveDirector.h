@@ -0,0 +1,154 @@
+#pragma once
+
+// Include directives
+#include <vector>
+#include "BoidSet.h"
+
+// Using the Urho3D namespace
+namespace Urho3D
+{
+	class ResourceCache;
+}
+
+// Defaults of the wave file's settings
+const int WAVE_POOL_FLOCKS = 4;
+const int WAVE_FLOCK_SIZE = 20;
+const float WAVE_SPAWN_RADIUS = 150.0f;
+const float WAVE_SPAWN_SPREAD = 10.0f;
+const float WAVE_SPAWN_SPEED = 5.0f;
+
+// Most boids spawned and retired in a frame, whatever the rates - so a wave never spikes a frame
+const int WAVE_MAX_SPAWNS_PER_FRAME = 8;
+const int WAVE_MAX_RETIRES_PER_FRAME = 16;
+
+// A wave - what the director holds the battle to until it ends
+struct Wave
+{
+	// Length (seconds)
+	float duration_;
+
+	// Flocks in play
+	int flocks_;
+
+	// Boids kept alive in them
+	int boids_;
+
+	// Boids spawned and retired a second
+	float spawnRate_;
+	float retireRate_;
+};
+
+// State of a flock under the director
+enum WaveFlockState
+{
+	WAVE_FLOCK_POOLED = 0,
+	WAVE_FLOCK_ACTIVE,
+	WAVE_FLOCK_RETIRING
+};
+
+// Wave director class
+// - Keeps the battle going by spawning and retiring boids and whole flocks at runtime,
+//   following waves read from an XML file (see bin/Data/Waves.xml)
+// - Killed and retired boids keep their nodes and components and are spawned again, and the
+//   extra flocks are a pool of sets whose boids start retired - built from the boid prefab a
+//   batch a frame and added as each is finished
+// - Spawns and retirements come out of per second rates, capped each frame, and retiring
+//   takes boids off screen first
+// - Not used in lockstep, where the clients run the same flock and would need every spawn
+class WaveDirector
+{
+public:
+	// Constructor
+	WaveDirector() :
+		enabled_(false),
+		loop_(true),
+		poolFlocks_(WAVE_POOL_FLOCKS),
+		flockSize_(WAVE_FLOCK_SIZE),
+		spawnRadius_(WAVE_SPAWN_RADIUS),
+		spawnSpread_(WAVE_SPAWN_SPREAD),
+		maxSpawnsPerFrame_(WAVE_MAX_SPAWNS_PER_FRAME),
+		maxRetiresPerFrame_(WAVE_MAX_RETIRES_PER_FRAME),
+		wave_(0),
+		waveTime_(0.0f),
+		spawnCredit_(0.0f),
+		retireCredit_(0.0f)
+	{}
+
+	// Read the waves from the XML file - false if it could not be read
+	bool Load(ResourceCache* cache, const String& fileName);
+
+	// Flocks to build for the pool, and the boids in each
+	int GetPoolFlocks();
+	int GetFlockSize();
+
+	// Start directing, then add the sets - in play, or pooled with their boids retired
+	void Start(const FlockRandom& random);
+	void AddBoidSet(BoidSet* boidSet, bool pooled);
+
+	// Stop directing and forget the sets - before they are deleted
+	void Stop();
+
+	// Is the director running
+	bool IsEnabled();
+
+	// Update - called each frame before the boids are updated
+	void Update(float timeStep);
+
+	// Current wave
+	unsigned GetWave();
+
+private:
+	// A flock under the director
+	struct Flock
+	{
+		BoidSet* boidSet_;
+		WaveFlockState state_;
+
+		// Boids alive, counted each frame, and whether any were spawned since it came into play
+		int alive_;
+		bool spawned_;
+
+		// Where its boids come in
+		Vector3 spawnPoint_;
+	};
+
+	// Move on to a wave, logging it
+	void StartWave(unsigned wave);
+
+	// Bring a pooled flock into play, or start retiring a flock in play
+	void ActivateFlock(Flock& flock);
+	void RetireFlock(Flock& flock);
+
+	// Spawn a boid into the flock - false if it has none left to spawn
+	bool SpawnBoid(Flock& flock);
+
+	// Retire a boid of the flock, off screen first - false if it has none alive
+	bool RetireBoid(Flock& flock);
+
+	// Running, and go back to the first wave after the last
+	bool enabled_;
+	bool loop_;
+
+	// Pool and spawn settings
+	int poolFlocks_;
+	int flockSize_;
+	float spawnRadius_;
+	float spawnSpread_;
+	int maxSpawnsPerFrame_;
+	int maxRetiresPerFrame_;
+
+	// The waves, the current one and how long it has run
+	std::vector<Wave> waves_;
+	unsigned wave_;
+	float waveTime_;
+
+	// The flocks
+	std::vector<Flock> flocks_;
+
+	// Spawns and retirements owed by the rates
+	float spawnCredit_;
+	float retireCredit_;
+
+	// Random stream of the spawn points
+	FlockRandom random_;
+};